@@ -8,6 +8,7 @@
 **/
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "util/geometry.h"
 #include "ecs.h"
 #include "particle_effects.h"
@@ -26,6 +27,12 @@ typedef enum ecs_component_type {
   NUM_COMPONENT_TYPES
 } ecs_component_type;
 
+/** set of \ref ecs_component_type flags, one bit per type */
+typedef uint32_t ecs_signature;
+/** bit representing a single \ref ecs_component_type in an
+ *  \ref ecs_signature. combine with | to describe several types */
+#define ECS_SIGNATURE(type) ((ecs_signature)1 << (type))
+
 typedef enum BehaviorType {
   BEHAVIOR_IDLE,   ///< hover around a bit
   BEHAVIOR_FOLLOW, ///< move towards another entity
@@ -34,10 +41,24 @@ typedef enum BehaviorType {
 
 /** forward declaration of \ref ecs_entity, defined in \ref ecs.h */
 struct ecs_entity;
+/** generational reference to an \ref ecs_entity that can be held across
+ *  frames. The low 32 bits index the entity table and the high 32 bits hold
+ *  the generation of that slot. Resolve with \ref ecs_entity_get, which
+ *  returns NULL once the entity has been freed */
+typedef uint64_t ecs_handle;
+/** handle that never refers to an entity */
+#define ECS_NULL_HANDLE ((ecs_handle)0)
 /** function pointer attached to a \ref ecs_component.
  *  when called, it is passed the owner entity*/
 typedef void (*ecs_entity_trigger)(struct ecs_entity *ent);
 
+/** action taken when the collider of an entity touches another's, see
+ *  \ref Collider
+ *  \param ent pointer to the entity that holds the collision handler
+ *  \param other pointer to the entity it touched */
+typedef void (*ecs_collision_handler)(struct ecs_entity *ent,
+    struct ecs_entity *other);
+
 typedef void (*ecs_mouse_handler)(struct ecs_entity *ent, bool lmb, bool rmb);
 /** action to be taken on keypress
  *  \param ent pointer to the entity that holds the keyboard handler
@@ -61,19 +82,58 @@ typedef struct Body {
   Direction destroy_on_exit;
 } Body;
 
+/** kinds of \ref Collider, one bit each. combine with | to form a
+ *  \ref collision_mask */
+typedef enum collision_category {
+  COLLIDE_PLAYER  = 0x01,
+  COLLIDE_ENEMY   = 0x02,
+  COLLIDE_MISSILE = 0x04,
+  COLLIDE_HAZARD  = 0x08, ///< mines and other things that harm on contact
+  /** every category */
+  COLLIDE_ALL     = 0x0f
+} collision_category;
+
+/** number of \ref collision_category bits */
+#define NUM_COLLISION_CATEGORIES 4
+
+/** set of \ref collision_category flags */
+typedef uint32_t collision_mask;
+
 /** component allowing an \ref ecs_entity to collide */
 typedef struct Collider {
-  /** hit detection rectangle */
+  /** size of the hit detection box centered on the owner. x and y are
+   *  unused - the placed box is in \ref ecs_bounds::hit */
   rectangle rect;
   /** if true, owner will bounce when colliding with level bounds */
   bool keep_inside_level;
   /** if true, perform elastic collisions with other entities*/
   bool elastic_collision;
-  /** action to take when a collision is detected. both entities involved in
-   * the collision are passed as arguments */
-  void (*on_collision)(struct ecs_entity *ent1, struct ecs_entity *ent2);
-  /** particle effect to play on collision */
+  /** action to take when the owner starts touching another entity, in the
+   *  first update they touch after not touching */
+  ecs_collision_handler on_collision;
+  /** action to take in each later update the owner still touches an entity
+   *  it collided with */
+  ecs_collision_handler on_collision_stay;
+  /** action to take in the first update the owner no longer touches an
+   *  entity it collided with. not taken if either has been destroyed */
+  ecs_collision_handler on_collision_exit;
+  /** particle effect to play when an elastic collision starts */
   particle_generator collide_particle_effect;
+  /** what kind of collider this is - a single \ref collision_category.
+   *  colliders with no category are kept inside the level but never collide
+   *  with other entities */
+  collision_category category;
+  /** categories this collider reacts to, through its collision handlers or an
+   *  elastic collision. two colliders are only tested for overlap when one
+   *  reacts to the other's category and they are not on the same team (see
+   *  \ref ecs_same_team) */
+  collision_mask mask;
+  /** if true, the owner never moves, so it is never tested against other
+   *  stationary or sleeping colliders */
+  bool stationary;
+  /** seconds the owner's body has been still, see
+   *  \ref collision_system_set_sleep_delay - DO NOT MODIFY */
+  float _idle_time;
 } Collider;
 
 /** component allowing an \ref ecs_entity to move */
@@ -117,7 +177,7 @@ typedef struct Timer {
 /** comonent that causes an entity to act autonomously */
 typedef struct Behavior {
   BehaviorType type;
-  struct ecs_entity *target;  ///< target of interest
+  ecs_handle target;  ///< target of interest
   vector location; ///< location of interest
 } Behavior;
 
@@ -125,16 +185,16 @@ typedef struct KeyboardListener {
   ecs_keyboard_handler handler;
 } KeyboardListener;
 
+/** component reacting to the mouse inside the owner's hit box
+ *  (\ref ecs_bounds::hit) */
 typedef struct MouseListener {
-  /** area in which to register clicks */
-  rectangle click_rect;
-  /** action to take on mouse entering \ref click_rect */
+  /** action to take on mouse entering the hit box */
   ecs_entity_trigger on_enter;
-  /** action to take on mouse leaving \ref click_rect */
+  /** action to take on mouse leaving the hit box */
   ecs_entity_trigger on_leave;
-  /** action to take when mouse button pressed inside \ref click_rect */
+  /** action to take when mouse button pressed inside the hit box */
   ecs_mouse_handler on_press;
-  /** action to take when mouse button released inside \ref click_rect */
+  /** action to take when mouse button released inside the hit box */
   ecs_mouse_handler on_release;
 } MouseListener;
 
@@ -3,12 +3,22 @@
 
 /** \file ecs.h
   * \brief \b Entity-Component-System framework for \b Allegro5
+  * Entities, components and systems live in an \ref ecs_world. Worlds share
+  * only read-only data (bitmaps, prefabs, particle generators), so several
+  * may be created and stepped at once on separate threads, see
+  * \ref ecs_update_worlds.
 **/
 
+/** forward declaration of \ref ecs_world, used by the system headers */
+struct ecs_world;
+
 #include "components.h"
 #include "render.h"
 #include "util/list.h"
+#include "util/array.h"
+#include "util/pool.h"
 #include "util/geometry.h"
+#include "util/job.h"
 #include "system/scenery_sys.h"
 #include "system/propulsion_sys.h"
 #include "system/body_sys.h"
@@ -19,14 +29,24 @@
 #include "system/behavior_sys.h"
 #include "system/timer_sys.h"
 #include "system/health_sys.h"
+#include "system/spatial_sys.h"
 
 /* struct declarations ********************************************************/
+/** forward declaration of \ref snapshot, defined in \ref snapshot.h */
+struct snapshot;
+/** state of the weapon system, defined in weapon_sys.c */
+struct weapon_system_state;
+/** state of the scenery system, defined in scenery_sys.c */
+struct scenery_system_state;
 
 /** component which can be attached to an \ref entity - Plain Old Data.
  *  components should contain no data that needs to be freed - Any such
  *  data (e.g. a bitmap) should be allocated and freed independently of
  *  component creation/destruction. Components should simply reference such
- *  data from another data store
+ *  data from another data store.
+ *  Components are stored packed by type, so only the header and the union
+ *  member matching \ref type are allocated - never copy a whole stored
+ *  \ref ecs_component by value.
  */
 typedef struct ecs_component {
   /** component type identifier */
@@ -34,9 +54,11 @@ typedef struct ecs_component {
   /** reference to entity that owns this component.
    *  can be used to locate sibling components */
   struct ecs_entity *owner_entity;
-  /** if true, update component. otherwise remove it */
-  bool active;
-  /** data for a given component type */
+  void (*on_destroy)(struct ecs_component *self);
+  /** change tick of the last write, see \ref ecs_write_component -
+   *  DO NOT MODIFY */
+  uint32_t _changed;
+  /** data for a given component type - must be the last member */
   union {
     Body body;
     Collider collider;
@@ -47,13 +69,14 @@ typedef struct ecs_component {
     KeyboardListener keyboard_listener;
     MouseListener mouse_listener;
   };
-  void (*on_destroy)(struct ecs_component *self);
 } ecs_component;
 
 typedef enum ecs_entity_team {
   TEAM_NEUTRAL  = 0x0,
   TEAM_FRIENDLY = 0x1,
-  TEAM_ENEMY    = 0x2
+  TEAM_ENEMY    = 0x2,
+  /** one more than the largest team value */
+  NUM_ENTITY_TEAMS
 } ecs_entity_team;
 
 /** descriptive tag to identify the "class" of a \ref ecs_entity  */
@@ -63,9 +86,13 @@ typedef enum ecs_entity_tag {
   ENTITY_FLARE,
   ENTITY_MISSILE,
   ENTITY_HAZARD,
-  ENTITY_SCENIC
+  ENTITY_SCENIC,
+  NUM_ENTITY_TAGS
 } ecs_entity_tag;
 
+/** maximum number of \ref ecs_query objects that may exist at once */
+#define ECS_MAX_QUERIES 16
+
 /** a game object composed of \ref ecs_components */
 typedef struct ecs_entity {
   /** identifies the nature of the entity */
@@ -79,61 +106,475 @@ typedef struct ecs_entity {
   /** sprite determining how entity is rendered.
    *  may be NULL to if entity has no visual representation. */
   sprite *sprite;
-  /** which team the entity is on */
+  /** which team the entity is on - change with \ref ecs_set_team */
   ecs_entity_team team;
+  /** world the entity belongs to */
+  struct ecs_world *world;
+  /** handle identifying this entity - DO NOT MODIFY */
+  ecs_handle handle;
+  /** true once \ref ecs_entity_free has been called on a deferred entity.
+   *  the entity remains valid until the next sync point. destruction queued
+   *  from a job does not set it */
+  bool destroyed;
+  /** types of the attached components - DO NOT MODIFY */
+  ecs_signature signature;
+  /** row of this entity in each \ref ecs_query, indexed by query id.
+   *  -1 if the entity does not match - DO NOT MODIFY */
+  int _query_rows[ECS_MAX_QUERIES];
+  /** position in the per-tag and per-team entity sets - DO NOT MODIFY */
+  int _tag_index, _team_index;
   /** pointer to node in entity list - DO NOT MODIFY */
   list_node *_node;
 } ecs_entity;
+
+/** world-space boxes of an entity, recomputed from its position once per
+ *  update after the bodies move, see \ref ecs_update_bounds */
+typedef struct ecs_bounds {
+  /** box of the \ref Collider, or \ref extent if there is none. used for
+   *  collisions and mouse hit testing */
+  aabb hit;
+  /** box covering the sprite, or just the center if there is none */
+  aabb extent;
+} ecs_bounds;
 /******************************************************************************/
 
 /* Typedefs *******************************************************************/
 /** a system is just a function called every frame which updates the state of
- *  some components based on elapsed time */
-typedef void (*ecs_system)(double time);
-/******************************************************************************/
+ *  some components of a world based on elapsed time */
+typedef void (*ecs_system)(struct ecs_world *world, double time);
+
+/** set of data a system reads or writes, used to decide which systems may
+ *  run at the same time. component types are given by \ref ECS_SIGNATURE,
+ *  other world data by the ECS_ACCESS_ flags */
+typedef uint32_t ecs_access;
+
+/** \ref ecs_entity::position and \ref ecs_entity::angle */
+#define ECS_ACCESS_POSITION   ((ecs_access)1 << NUM_COMPONENT_TYPES)
+/** \ref ecs_bounds of the entities */
+#define ECS_ACCESS_BOUNDS     ((ecs_access)1 << (NUM_COMPONENT_TYPES + 1))
+/** the particles of the world */
+#define ECS_ACCESS_PARTICLES  ((ecs_access)1 << (NUM_COMPONENT_TYPES + 2))
+/** the random generator. a system writing it always runs on the thread
+ *  calling \ref ecs_update_systems, which holds the state of the world's
+ *  generator */
+#define ECS_ACCESS_RANDOM     ((ecs_access)1 << (NUM_COMPONENT_TYPES + 3))
+/** sounds played through \ref al_game_play_sound */
+#define ECS_ACCESS_SOUND      ((ecs_access)1 << (NUM_COMPONENT_TYPES + 4))
+/** creating or freeing entities, adding or removing components or sprites,
+ *  or the state of the weapon and scenery systems. systems running
+ *  arbitrary handlers (e.g. timer actions) write it. a system writing it
+ *  runs on the thread calling \ref ecs_update_systems and never alongside
+ *  a system accessing any component, position, bounds or the spatial
+ *  index. changes queued through \ref ecs_must_queue are not covered */
+#define ECS_ACCESS_STRUCTURE  ((ecs_access)1 << (NUM_COMPONENT_TYPES + 5))
+/** the spatial index of the world, see \ref ecs_query_radius */
+#define ECS_ACCESS_SPATIAL    ((ecs_access)1 << (NUM_COMPONENT_TYPES + 6))
+
+/** function run at a sync point by \ref ecs_call_synced
+ *  \param args copy of the arguments given to \ref ecs_call_synced */
+typedef void (*ecs_synced_fn)(struct ecs_world *world, const void *args);
+
+/** most bytes of arguments \ref ecs_call_synced can hold */
+#define ECS_MAX_CALL_ARGS 64
+
+/** an \ref ecs_system registered with \ref ecs_add_system */
+typedef struct ecs_system_entry {
+  /** update function */
+  ecs_system fn;
+  /** data the system reads but does not write */
+  ecs_access reads;
+  /** data the system writes */
+  ecs_access writes;
+  /** change tick taken as the system last started, 0 before it first runs
+   *  - DO NOT MODIFY */
+  uint32_t _last_tick;
+  /** change tick taken as the run before the current one started, see
+   *  \ref ecs_system_since - DO NOT MODIFY */
+  uint32_t _since;
+} ecs_system_entry;
+
+/** records structural changes (entity destruction, component addition and
+ *  removal) so they can be applied together at a sync point by
+ *  \ref ecs_commands_playback */
+typedef struct ecs_commands {
+  /** world whose entities the commands apply to - DO NOT MODIFY */
+  struct ecs_world *_world;
+  /** recorded commands in order - DO NOT MODIFY */
+  array *_commands;
+} ecs_commands;
 
-/* global entity-component data stores ****************************************/
-/** active component lists indexed by \ref ecs_component_type */
-extern list *ecs_component_store[NUM_COMPONENT_TYPES];
-/** list of every \ref ecs_system update function.
- *  the handlers are called every frame in order from the list head to tail */
-extern list *ecs_systems;
-/** list of every active \ref ecs_entity. */
-extern list *ecs_entities;
+/** an entity matched by an \ref ecs_query */
+typedef struct ecs_query_row {
+  /** the matching entity */
+  ecs_entity *entity;
+  /** the requested components of \ref entity, ordered by
+   *  \ref ecs_component_type. index with \ref ecs_query_column */
+  ecs_component *components[];
+} ecs_query_row;
+
+/** every entity having at least the components in a signature.
+ *  the set of rows is updated as components are added and removed, so
+ *  iterating it never visits non-matching entities. Rows are packed - a
+ *  removal moves the last row into the hole, so only iterate by index inside
+ *  a deferred section (see \ref ecs_defer_begin) */
+typedef struct ecs_query {
+  /** component types an entity must have to match */
+  ecs_signature signature;
+  /** index of this query in \ref ecs_entity::_query_rows - DO NOT MODIFY */
+  int _id;
+  /** world whose entities the query matches - DO NOT MODIFY */
+  struct ecs_world *_world;
+  /** column of each component type in a row, -1 if not requested */
+  int _columns[NUM_COMPONENT_TYPES];
+  /** packed \ref ecs_query_row elements - DO NOT MODIFY */
+  array *_rows;
+} ecs_query;
+
+/** loop over every stored component of a type, assigning each to \c var, an
+ *  \ref ecs_component pointer declared by the caller. Components added by
+ *  the loop body are left for the next pass. Removal only happens at sync
+ *  points, so this is safe inside a system (see \ref ARRAY_FOREACH) */
+#define ECS_FOREACH(var, world, type) \
+  ARRAY_FOREACH(var, (world)->component_store[(int)(type)])
+
+/** loop over the stored components of a type written since the running
+ *  system last started (see \ref ecs_system_since), assigning each to
+ *  \c var as \ref ECS_FOREACH does. the same rules apply */
+#define ECS_FOREACH_CHANGED(var, world, type)                           \
+  for (uint32_t var##_since = ecs_system_since(world), var##_idx = 0,   \
+      var##_end = (world)->component_store[(int)(type)]->length;        \
+      var##_idx < var##_end &&                                           \
+      ((var) = array_get((world)->component_store[(int)(type)],          \
+                         var##_idx), 1);                                 \
+      var##_idx++)                                                       \
+    if (!ecs_changed_since((var), var##_since)) {} else
+
+/** loop over the rows of a query, assigning each to \c var, an
+ *  \ref ecs_query_row pointer declared by the caller. the same rules apply
+ *  as for \ref ECS_FOREACH */
+#define ECS_QUERY_FOREACH(var, query) ARRAY_FOREACH(var, (query)->_rows)
+
+/** storage reserved up front by \ref ecs_world_new_with_capacity */
+typedef struct ecs_capacity {
+  /** number of entities allocated per slab of the entity pool. also sizes
+   *  the entity list, the tag, team and query sets and the deferred command
+   *  buffer */
+  int entities;
+  /** number of components to reserve in each store, indexed by
+   *  \ref ecs_component_type */
+  int components[NUM_COMPONENT_TYPES];
+  /** number of sprites to reserve storage for */
+  int sprites;
+  /** number of particles to reserve storage for */
+  int particles;
+} ecs_capacity;
+
+/** an independent set of entities, components and systems.
+ *  nothing in one world refers to another, so different worlds may be
+ *  updated concurrently on different threads. a single world must only be
+ *  used by one thread at a time */
+typedef struct ecs_world {
+  /** packed component arrays indexed by \ref ecs_component_type.
+   *  elements are \ref ecs_component headers followed by type-specific data.
+   *  removal swaps the last component into the hole and only happens outside
+   *  of deferred sections (see \ref ecs_defer_begin), so systems may iterate
+   *  a store by index without checking for removed components */
+  array *component_store[NUM_COMPONENT_TYPES];
+  /** every registered \ref ecs_system_entry in registration order, see
+   *  \ref ecs_add_system */
+  array *systems;
+  /** if true, \ref ecs_update_systems runs the systems one at a time in
+   *  registration order on the calling thread. with correct access
+   *  declarations the result is the same, except that changes systems
+   *  queue (see \ref ecs_must_queue) may be applied in a different order.
+   *  this is for debugging */
+  bool serial_systems;
+  /** list of every active \ref ecs_entity. */
+  list *entities;
+  /** sprites of the entities, drawn by \ref render_all_sprites */
+  sprite_layers *sprites;
+  /** particles spawned by the systems of this world */
+  particle_system *particles;
+  /** entity table indexed by the low bits of an ecs_handle - DO NOT MODIFY */
+  array *_slots;
+  /** \ref ecs_bounds of the entity in each slot, packed so consumers can
+   *  read them without touching the entities - DO NOT MODIFY */
+  array *_bounds;
+  /** head of the list of free slots in \ref _slots, -1 if none are free -
+   *  DO NOT MODIFY */
+  int _free_slot;
+  /** slab allocator backing every entity - DO NOT MODIFY */
+  pool *_entity_pool;
+  /** nodes of the \ref entities list - DO NOT MODIFY */
+  pool *_entity_node_pool;
+  /** number of entities storage is reserved for - DO NOT MODIFY */
+  int _entity_capacity;
+  /** allocation counters for each component store - DO NOT MODIFY */
+  pool_stats _store_stats[NUM_COMPONENT_TYPES];
+  /** changes recorded while deferred - DO NOT MODIFY */
+  ecs_commands *_deferred;
+  /** number of open deferred sections - DO NOT MODIFY */
+  int _defer_depth;
+  /** changes queued by each thread running jobs for an update, indexed by
+   *  \ref job_thread_index - DO NOT MODIFY */
+  ecs_commands *_queued[JOB_MAX_THREADS];
+  /** order in which queued changes are applied - DO NOT MODIFY */
+  array *_queue_order;
+  /** true while \ref ecs_update_systems runs - DO NOT MODIFY */
+  bool _updating;
+  /** entities with each tag and on each team, in no particular order -
+   *  DO NOT MODIFY */
+  array *_tag_sets[NUM_ENTITY_TAGS], *_team_sets[NUM_ENTITY_TEAMS];
+  /** tick stamped on components written since the last
+   *  \ref ecs_change_tick call - DO NOT MODIFY */
+  uint32_t _change_tick;
+  /** queries kept up to date by component changes, indexed by
+   *  \ref ecs_query::_id - DO NOT MODIFY */
+  ecs_query *_queries[ECS_MAX_QUERIES];
+  /** state of the random generator used while the systems run, so the
+   *  outcome of an update does not depend on the thread running it -
+   *  DO NOT MODIFY */
+  uint64_t _rand_state;
+  /** state of the weapon system - DO NOT MODIFY */
+  struct weapon_system_state *_weapons;
+  /** state of the scenery system - DO NOT MODIFY */
+  struct scenery_system_state *_scenery;
+  /** scratch storage of the collision system - DO NOT MODIFY */
+  struct collision_system_state *_collision;
+  /** positions indexed by the spatial system - DO NOT MODIFY */
+  struct spatial_system_state *_spatial;
+  /** number of times \ref ecs_update_systems has run - DO NOT MODIFY */
+  int _updates;
+} ecs_world;
 /******************************************************************************/
 
 /* functions ******************************************************************/
-/** initialize entity-component-system framework */
-void ecs_init();
+/** create a world running every built-in system, with default capacities.
+  * its random generator is seeded from the generator of the calling thread.
+  * \return a new world. free with \ref ecs_world_free
+**/
+ecs_world* ecs_world_new();
+
+/** create a world running every built-in system
+  * \param capacity number of entities and components to reserve storage for.
+  * exceeding these grows the storage rather than failing.
+**/
+ecs_world* ecs_world_new_with_capacity(ecs_capacity capacity);
 
 /** create new entity with no attached components.
+  * \param world world to create the entity in
   * \param position initial location of the center point of the new entity
   * \return a new \ref ecs_entity. free with \ref ecs_entity_free.
 **/
-ecs_entity *ecs_entity_new(vector position, ecs_entity_tag tag);
+ecs_entity *ecs_entity_new(ecs_world *world, vector position,
+    ecs_entity_tag tag);
+
+/** recompute the \ref ecs_bounds of every entity from its position, sprite
+  * and \ref Collider. run every update by \ref bounds_system_fn */
+void ecs_update_bounds(ecs_world *world);
+
+/** recompute the bounds of one entity, e.g. after moving it once
+  * \ref ecs_update_bounds has run for the update */
+void ecs_refresh_bounds(ecs_entity *entity);
 
-/** free an entity and every \ref ecs_component attached to it
+/** bounds of an entity as of the last \ref ecs_update_bounds. an entity
+  * created since then has an empty box at its initial position.
+  * \return pointer invalidated by the next entity creation
+**/
+ecs_bounds* ecs_entity_bounds(ecs_entity *entity);
+
+/** free an entity and every \ref ecs_component attached to it.
+  * every \ref ecs_handle referring to the entity becomes stale.
+  * inside a deferred section the entity is only marked \ref
+  * ecs_entity::destroyed and freed when the section ends. when the change
+  * must be queued (see \ref ecs_must_queue) the entity is not marked: it
+  * stays alive to every job until it is freed at the next sync point, and
+  * queuing it again is harmless.
   * \param entity entity to be destroyed
 **/
 void ecs_entity_free(ecs_entity *entity);
 
+/** true if the calling thread may not change a world directly: the world
+  * is being updated, and the caller is a job started by the update rather
+  * than a system run by the updating thread. entities must then not be
+  * created and components not added or removed. instead \ref
+  * ecs_entity_free, \ref ecs_emit_particles, \ref ecs_play_sound and
+  * \ref ecs_call_synced queue their change for the thread. at the next
+  * sync point, after the deferred changes, the queued changes are applied
+  * on the updating thread ordered by the entity that caused them, then by
+  * the system that queued them (changes queued without an entity come
+  * first), then by the range of any \ref job_parallel_for the system
+  * started, then in the order they were queued. the result does not depend
+  * on which thread ran which job. queued changes need not be declared to
+  * \ref ecs_add_system.
+**/
+bool ecs_must_queue(ecs_world *world);
+
+/** spawn particles from a generator into the world of an entity, or queue
+  * them (see \ref ecs_must_queue). either way the number of particles is
+  * decided immediately, as by \ref spawn_particles.
+  * \param source entity emitting the particles
+**/
+void ecs_emit_particles(ecs_entity *source, particle_generator *gen,
+    double time, double density, vector source_velocity);
+
+/** play a sound once through \ref al_game_play_sound, or queue it (see
+  * \ref ecs_must_queue)
+  * \param source entity making the sound, or NULL
+**/
+void ecs_play_sound(ecs_world *world, ecs_entity *source, const char *name);
+
+/** call fn(world, args), or queue the call (see \ref ecs_must_queue). a
+  * queued call receives a copy of the arguments and runs even if source has
+  * been freed by then, so it must look up any entity it uses by handle.
+  * \param source entity causing the call, or NULL
+  * \param size bytes of args, at most \ref ECS_MAX_CALL_ARGS
+**/
+void ecs_call_synced(ecs_world *world, ecs_entity *source, ecs_synced_fn fn,
+    const void *args, size_t size);
+
+/** look up the entity referred to by a handle in constant time
+  * \param handle handle taken from \ref ecs_entity::handle
+  * \return the entity, or NULL if it has been freed or handle is
+  * \ref ECS_NULL_HANDLE
+**/
+ecs_entity* ecs_entity_get(ecs_world *world, ecs_handle handle);
+
 /** attach a new component to an entity. If \ref entity already has a component
-  * of this type, it will be freed and replaced
+  * of this type, it will be cleaned up and replaced in place
   * \param entity \ref ecs_entity to which the component will be attached
   * \param type type of component to attach
-  * \return an \b UNINITIALIZED component.  The general component fields (\ref
-  * owner_entity, \ref type, \ref active) will be set, but the type-specific
-  * fields must be initialized by the caller.
+  * \return a zeroed component.  The general component fields (\ref
+  * owner_entity, \ref type) will be set, but the type-specific
+  * fields must be initialized by the caller. The pointer is invalidated by
+  * the next add or removal of a component of the same type.
 **/
 ecs_component* ecs_add_component(ecs_entity *entity, ecs_component_type type);
 
-/** remove the component of a given type from an entity
+/** attach a copy of a component to an entity, replacing any component of the
+  * same type as \ref ecs_add_component does
+  * \param src component to copy. only its type, \ref on_destroy and
+  * type-specific data are used, so it need not be attached to anything
+  * \return the attached copy
+**/
+ecs_component* ecs_add_component_copy(ecs_entity *entity,
+    const ecs_component *src);
+
+/** make room for \c count more entities having the components in
+  * \c signature, so creating them grows each store at most once instead of
+  * repeatedly as components are added */
+void ecs_reserve(ecs_world *world, ecs_signature signature, int count);
+
+/** remove the component of a given type from an entity. inside a deferred
+  * section the component stays attached until the section ends.
   * \param entity entity from which to remove component
   * \param type type of component to remove. If entity has no such component,
   * \ref ecs_remove_component does nothing.
 **/
 void ecs_remove_component(ecs_entity *entity, ecs_component_type type);
 
+/** get a component for modification, marking it changed so systems that
+  * track changes revisit it on their next pass.
+  * \return the component of the given type, or NULL if entity has none
+**/
+ecs_component* ecs_write_component(ecs_entity *entity,
+    ecs_component_type type);
+
+/** mark a component changed after modifying it through a pointer obtained
+  * some other way. new components start out marked changed */
+void ecs_mark_changed(ecs_component *comp);
+
+/** start a change-tracking pass. every change made after this call compares
+  * greater than the returned tick.
+  * \return tick to pass as \c since to \ref ecs_changed_since on the next
+  * pass. passing 0 treats every component as changed
+**/
+uint32_t ecs_change_tick(ecs_world *world);
+
+/** true if a component was written after the pass that returned \c since */
+bool ecs_changed_since(ecs_component *comp, uint32_t since);
+
+/** the change tick \ref ecs_update_systems took as the calling system last
+  * started, so \ref ecs_changed_since tells what was written since. each
+  * system has its own, kept in its \ref ecs_system_entry. 0, counting
+  * everything as changed, on a system's first run and outside an update
+**/
+uint32_t ecs_system_since(ecs_world *world);
+
+/** begin a deferred section. until the matching \ref ecs_defer_end,
+  * \ref ecs_entity_free and \ref ecs_remove_component are recorded instead
+  * of applied. sections may be nested. every system run by
+  * \ref ecs_update_systems is wrapped in a deferred section.
+**/
+void ecs_defer_begin(ecs_world *world);
+
+/** end a deferred section. ending the outermost section is a sync point:
+  * every change recorded since it began is applied in order, followed by
+  * the changes queued by jobs (see \ref ecs_must_queue).
+**/
+void ecs_defer_end(ecs_world *world);
+
+/** create an empty command buffer for changes to the entities of a world */
+ecs_commands* ecs_commands_new(ecs_world *world);
+
+/** free a command buffer, discarding any commands not yet played back */
+void ecs_commands_free(ecs_commands *cmds);
+
+/** record destruction of an entity. marks the entity
+  * \ref ecs_entity::destroyed; destroying it more than once is harmless.
+**/
+void ecs_commands_destroy(ecs_commands *cmds, ecs_entity *entity);
+
+/** record addition of a component to an entity.
+  * \return a zeroed staging component to be initialized by the caller. its
+  * data is copied into the component store on playback. the pointer is only
+  * valid until the next command is recorded to \c cmds.
+**/
+ecs_component* ecs_commands_add_component(ecs_commands *cmds,
+    ecs_entity *entity, ecs_component_type type);
+
+/** record removal of the component of a given type from an entity */
+void ecs_commands_remove_component(ecs_commands *cmds, ecs_entity *entity,
+    ecs_component_type type);
+
+/** apply every recorded command in the order it was recorded, then empty the
+  * buffer. changes to entities destroyed in the meantime are skipped.
+**/
+void ecs_commands_playback(ecs_commands *cmds);
+
+/** create a query matching every entity that has all the components in
+  * \c signature, including entities that already exist.
+  * at most \ref ECS_MAX_QUERIES queries may exist at once.
+  * \param signature component types, e.g.
+  * ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_SIGNATURE(ECS_COMPONENT_PROPULSION)
+  * \return a new query. free with \ref ecs_query_free, or let
+  * \ref ecs_world_free free it
+**/
+ecs_query* ecs_query_new(ecs_world *world, ecs_signature signature);
+
+/** find the query of a world having exactly \c signature, creating it with
+  * \ref ecs_query_new if there is none. lets a system keep one query per
+  * world without storing it
+**/
+ecs_query* ecs_query_find(ecs_world *world, ecs_signature signature);
+
+/** stop maintaining a query and free it */
+void ecs_query_free(ecs_query *query);
+
+/** number of entities currently matching a query */
+int ecs_query_count(ecs_query *query);
+
+/** get a row of a query
+  * \param idx index in [0, \ref ecs_query_count)
+  * \return row holding the entity and its requested components. the pointer
+  * is invalidated by the next change to the set of matching entities.
+**/
+ecs_query_row* ecs_query_get(ecs_query *query, int idx);
+
+/** index into \ref ecs_query_row::components of a requested component type.
+  * constant for the life of the query, so look it up once per iteration */
+int ecs_query_column(ecs_query *query, ecs_component_type type);
+
 /** attach a sprite to an entity so it can be rendered
   * \param entity entity to which sprite should be attached
   * \param name key to identify sprite
@@ -156,22 +597,99 @@ sprite* ecs_attach_animation(ecs_entity *entity, const char *name, int depth,
     int frame_width, int frame_height, double animation_rate, AnimationType
     type);
 
+/** attach a copy of a sprite to an entity
+  * \param entity entity to which sprite should be attached
+  * \param src sprite to copy, usually made by \ref sprite_template
+  * \param depth layer at which sprite should be drawn
+  * \return the newly created and attached sprite
+**/
+sprite* ecs_attach_sprite_copy(ecs_entity *entity, const sprite *src,
+    int depth);
+
 /** remove and free sprite attached to an entity
   * \param entity entity from which to remove sprite
 **/
 void ecs_remove_sprite(ecs_entity *entity);
 
-/** call every \ref ecs_system function in \ref ecs_systems.
+/** register a system to run every update, after those already registered
+  * wherever their access conflicts. systems conflict if either writes what
+  * the other reads or writes, if both write \ref ECS_ACCESS_RANDOM or
+  * \ref ECS_ACCESS_STRUCTURE, or if one writes \ref ECS_ACCESS_STRUCTURE
+  * and the other accesses data of entities.
+  * access includes anything done by handlers the system calls.
+  * \param reads data the system only reads, e.g.
+  * ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION
+  * \param writes data the system modifies
+**/
+void ecs_add_system(ecs_world *world, ecs_system fn, ecs_access reads,
+    ecs_access writes);
+
+/** update every system in \ref ecs_world::systems, then the particles of
+ *  the world. each update the systems are split into stages: a system runs
+ *  in the stage after the last one holding an earlier system it conflicts
+ *  with. the systems of a stage run concurrently as jobs (see util/job.h),
+ *  and each stage ends in a sync point (see \ref ecs_defer_end). the first
+ *  update runs serially so systems may create their queries then.
  *  \param time time elapsed since last update call (seconds) */
-void ecs_update_systems(double time);
+void ecs_update_systems(ecs_world *world, double time);
+
+/** call \ref ecs_update_systems for several worlds at once, each as a job
+  * (see util/job.h). returns once every world has been updated. the calling
+  * thread updates the first world.
+  * \param worlds distinct worlds to update
+  * \param count number of elements in \c worlds
+  * \param time time elapsed since last update call (seconds)
+**/
+void ecs_update_worlds(ecs_world **worlds, int count, double time);
 
 /** free every active \ref ecs_entity and every attached \ref ecs_component */
-void ecs_free_all_entities();
+void ecs_free_all_entities(ecs_world *world);
+
+/** allocation counters for the entity pool */
+pool_stats ecs_entity_stats(ecs_world *world);
+
+/** allocation counters for a component store. \ref pool_stats::slabs counts
+  * the allocations made to reserve or grow the store */
+pool_stats ecs_component_stats(ecs_world *world, ecs_component_type type);
+
+/** move an entity to a different team, keeping the per-team sets current.
+  * always use this rather than assigning \ref ecs_entity::team */
+void ecs_set_team(ecs_entity *entity, ecs_entity_team team);
+
+/** number of live entities with a given tag, in constant time */
+int ecs_tag_count(ecs_world *world, ecs_entity_tag tag);
+
+/** get an entity with a given tag
+  * \param idx index in [0, \ref ecs_tag_count). order is arbitrary and
+  * changes when an entity with the tag is freed
+**/
+ecs_entity* ecs_tag_get(ecs_world *world, ecs_entity_tag tag, int idx);
+
+/** number of live entities on a given team, in constant time */
+int ecs_team_count(ecs_world *world, ecs_entity_team team);
+
+/** get an entity on a given team
+  * \param idx index in [0, \ref ecs_team_count). order is arbitrary and
+  * changes when an entity leaves the team
+**/
+ecs_entity* ecs_team_get(ecs_world *world, ecs_entity_team team,
+    int idx);
 
 /** returns true if entities are on the same team and neither is neutral */
 bool ecs_same_team(ecs_entity *e1, ecs_entity *e2);
 
-/** clean up all resources allocated by the ECS framework. */
-void ecs_shutdown();
+/** append every entity, component and sprite of a world to a snapshot, see
+  * \ref snapshot_take */
+void ecs_save(ecs_world *world, struct snapshot *snap);
+
+/** replace every entity with those appended to a snapshot by \ref ecs_save.
+  * entities are restored with the same handles. \ref ecs_component::on_destroy
+  * is not called for the replaced components. the bounds and the spatial
+  * index are recomputed from the restored entities.
+**/
+void ecs_load(ecs_world *world, struct snapshot *snap);
+
+/** free a world, every entity in it and its queries, sprites and particles */
+void ecs_world_free(ecs_world *world);
 /******************************************************************************/
 #endif /* end of include guard: ECS_H */
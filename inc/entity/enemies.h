@@ -2,19 +2,25 @@
 #define ENEMIES_H
 
 #include "ecs.h"
+#include "prefab.h"
 #include "wave.h"
 #include "system/weapon_sys.h"
 #include "system/behavior_sys.h"
 
-/** spawn an enemy
-  * \param data struct containing info on how to spawn enemy
-  * \return newly created entity
+/** spawn a group of enemies, reserving storage for all of them at once
+  * \param world world to spawn the enemies in
+  * \param data info on how to spawn each enemy
+  * \param count number of enemies to spawn
 **/
-void spawn_enemy(EnemySpawnData data);
+void spawn_enemies(ecs_world *world, const EnemySpawnData *data, int count);
+
+/** build the enemy blueprints now rather than on first spawn. call before
+ *  updating worlds on more than one thread (see \ref prefab.h) */
+void enemies_preload();
 
 /** spawn mine that seeks out the player
   * \param enter_from side of screen to enter from
-  * \param player pointer to player entity
+  * \param player pointer to player entity, whose world the mine is spawned in
   * \return newly created entity
 **/
 ecs_entity* spawn_mine(Direction enter_from, ecs_entity *player);
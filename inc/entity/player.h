@@ -4,7 +4,7 @@
 #include "ecs.h"
 #include "system/weapon_sys.h"
 
-ecs_entity* make_player_ship();
+ecs_entity* make_player_ship(ecs_world *world);
 
 // Weapons
 extern Weapon seeker_launcher;
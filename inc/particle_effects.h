@@ -6,6 +6,9 @@
 #include "al_game.h"
 #include "util/geometry.h"
 #include "util/al_helper.h"
+#include "util/list.h"
+#include "util/pool.h"
+#include "util/array.h"
 
 /**
  * \file particle_generator.h
@@ -28,6 +31,8 @@ typedef struct generator_data {
   ALLEGRO_COLOR start_color, end_color; /*!< color at start and end of life */
 } generator_data;
 
+struct snapshot;
+
 typedef struct particle_generator {
   generator_data *data; /*!< data used to determine generator properties */
   vector position;      /*!< location of generator */
@@ -46,28 +51,56 @@ typedef struct particle {
   const generator_data* data; /*!< reference to data used to create particle */
 } particle;
 
+/** particles spawned into one world, see \ref particle_system_new */
+typedef struct particle_system {
+  list *_particles;       /*!< every live particle - DO NOT MODIFY */
+  pool *_particle_pool;   /*!< storage for the particles - DO NOT MODIFY */
+  pool *_node_pool;       /*!< storage for the list nodes - DO NOT MODIFY */
+  array *_live;           /*!< particles being updated - DO NOT MODIFY */
+} particle_system;
+
 /*! \fn void particle_init(ALLEGRO_BITMAP *display)
     \brief set up particle engine
     \param display pointer to the main display
  */
 void particle_init(ALLEGRO_BITMAP *display);
-// load all generator datas, return list of all of generator names
+// load and cache all generator datas, return list of all of generator names.
+// call at startup so no generator is loaded from file mid-game. generators
+// are shared by every particle system, so load them all before updating
+// particle systems on more than one thread
 list* load_all_generator_data();
+// create an empty particle system, reserving storage for capacity particles.
+// exceeding it grows the storage rather than failing
+particle_system* particle_system_new(int capacity);
+// free a particle system and every particle in it
+void particle_system_free(particle_system *ps);
 // retrieve a generator with which to spawn particles
 particle_generator get_particle_generator(char *name);
 // create particles at a specified position using a generator
 // density multiplies the generator's default spawn rate. Use 1.0 for default
-void spawn_particles(particle_generator *gen, double time, double density,
-    vector source_velocity);
-// call once for each update
-void update_particles(double time);
+void spawn_particles(particle_system *ps, particle_generator *gen,
+    double time, double density, vector source_velocity);
+// the number of particles spawn_particles would create, keeping the
+// fraction left over in the generator as it does
+int particle_spawn_count(particle_generator *gen, double time,
+    double density);
+// create count particles at the position of a generator
+void emit_particles(particle_system *ps, const particle_generator *gen,
+    int count, vector source_velocity);
+// call once for each update. the particles are updated in parallel on the
+// job system (see util/job.h)
+void update_particles(particle_system *ps, double time);
 // call once during each draw
-void draw_particles();
+void draw_particles(particle_system *ps);
 // remove all particles
-void clear_particles();
-// remove all particles and generator datas.
+void clear_particles(particle_system *ps);
+// remove the particle bitmap and all generator datas.
 void particle_shutdown();
 // return number of active particles
-int get_particle_count();
+int get_particle_count(particle_system *ps);
+// append every particle to a snapshot (see snapshot.h)
+void particle_save(particle_system *ps, struct snapshot *snap);
+// replace every particle with those appended by particle_save
+void particle_load(particle_system *ps, struct snapshot *snap);
 
 #endif /* end of include guard: PARTICLE_EFFECTS_H */
@@ -0,0 +1,92 @@
+#ifndef PREFAB_H
+#define PREFAB_H
+
+/** \file prefab.h
+  * \brief blueprints for creating many identical entities cheaply
+  * Prefabs are shared by every \ref ecs_world. Finding or loading one by
+  * name is thread safe. Filling in a prefab is not, so define every prefab
+  * before creating or updating worlds on more than one thread; spawning
+  * from existing prefabs is safe.
+**/
+
+#include "ecs.h"
+
+/** template from which entities are instantiated.
+ *  Bitmaps and particle generators are resolved when the prefab is defined,
+ *  so instantiating one does no lookups by name. */
+typedef struct prefab {
+  /** tag given to every instance */
+  ecs_entity_tag tag;
+  /** team given to every instance */
+  ecs_entity_team team;
+  /** true if instances get a copy of \ref sprite */
+  bool has_sprite;
+  /** sprite copied to every instance */
+  sprite sprite;
+  /** layer at which instance sprites are drawn */
+  int depth;
+  /** types of the components in \ref components */
+  ecs_signature signature;
+  /** component data copied to every instance, indexed by
+   *  \ref ecs_component_type. only types in \ref signature are used */
+  ecs_component components[NUM_COMPONENT_TYPES];
+} prefab;
+
+/** create an empty prefab and register it under a name
+  * \param name key to find the prefab with \ref prefab_get. must be unused
+  * \param tag tag given to every instance
+  * \return a prefab with no sprite or components. freed by
+  * \ref prefab_shutdown
+**/
+prefab* prefab_new(const char *name, ecs_entity_tag tag);
+
+/** find a prefab by name. If none is registered under that name, it is
+  * loaded from the section of data/sprite.cfg with the same name.
+  * \return the prefab, or NULL if it is neither registered nor configured
+**/
+prefab* prefab_get(const char *name);
+
+/** give instances of a prefab a sprite
+  * \param name name of bitmap resource
+  * \param depth layer at which sprite should be drawn
+**/
+void prefab_set_sprite(prefab *prefab, const char *name, int depth);
+
+/** give instances of a prefab an animated sprite
+  * \param name name of bitmap resource
+  * \param depth layer at which sprite should be drawn
+  * \param frame_width width in px of a single frame of the animation
+  * \param frame_height height in px of a single frame of the animation
+  * \param animation_rate frame cycle rate in frames/second
+  * \param type behavior of animation upon reaching end
+**/
+void prefab_set_animation(prefab *prefab, const char *name, int depth,
+    int frame_width, int frame_height, double animation_rate,
+    AnimationType type);
+
+/** give instances of a prefab a component
+  * \return zeroed component whose type-specific fields are copied to every
+  * instance. initialize them as for \ref ecs_add_component
+**/
+ecs_component* prefab_add_component(prefab *prefab, ecs_component_type type);
+
+/** create a single instance of a prefab
+  * \param world world to create the instance in
+  * \return the new entity, free with \ref ecs_entity_free
+**/
+ecs_entity* prefab_spawn(ecs_world *world, prefab *prefab, vector position);
+
+/** create many instances of a prefab at once. storage for all of them is
+  * reserved up front, so a batch grows each component store at most once.
+  * \param world world to create the instances in
+  * \param positions starting position of each instance
+  * \param count number of instances to create
+  * \param out receives the new entities if not NULL
+**/
+void prefab_instantiate(ecs_world *world, prefab *prefab,
+    const vector *positions, int count, ecs_entity **out);
+
+/** free every registered prefab */
+void prefab_shutdown();
+
+#endif /* end of include guard: PREFAB_H */
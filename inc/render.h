@@ -5,10 +5,12 @@
   * \brief structs and functions for rendering images to the display
 **/
 
+#include <stdint.h>
 #include "al_game.h"
 #include "particle_effects.h"
 #include "util/geometry.h"
 #include "util/list.h"
+#include "util/pool.h"
 
 /** number of sprite layers above and below 0. */
 #define SPRITE_LAYER_LIMIT 5
@@ -30,14 +32,15 @@ typedef struct sprite {
   vector center;
   /** horizontal and vertical scaling factors to use when drawing sprite */
   vector scale;
-  /** reference to owner's position */
-  vector *position_ptr;
-  /** reference to owner's rotation */
-  double *angle_ptr;
+  /** handle of the owner, whose position and rotation the sprite is drawn
+   *  at. resolved by the \ref sprite_locate_fn of the layers */
+  uint64_t owner;
   /** layer at which to draw sprite - modify only using \ref sprite_set_depth */
   int _depth;
   /** node holding sprite in backing sprite store - DO NOT MODIFY */
   list_node *_node;
+  /** layers holding the sprite - DO NOT MODIFY */
+  struct sprite_layers *_layers;
   int frame_width;       ///< width of a single frame within the spritesheet
   int frame_height;      ///< width of a single frame within the spritesheet
   double animation_rate; ///< frames/sec
@@ -47,26 +50,74 @@ typedef struct sprite {
   int current_frame;  ///< frame currently being displayed
 } sprite;
 
-/** initialize sprite framework */
-void sprite_init();
+/** find the position and rotation of the owner of a sprite
+  * \param ctx context given to \ref sprite_layers_new
+  * \param owner \ref sprite::owner of the sprite
+  * \return false if the owner no longer exists, so the sprite is not drawn
+**/
+typedef bool (*sprite_locate_fn)(void *ctx, uint64_t owner, vector *position,
+    double *angle);
+
+/** every sprite of a world, in the order they are drawn */
+typedef struct sprite_layers {
+  /** a list of sprites for each depth, from deepest to shallowest */
+  list *layers[SPRITE_LAYER_COUNT];
+  /** finds where each sprite's owner is when drawing - DO NOT MODIFY */
+  sprite_locate_fn _locate;
+  /** context passed to \ref _locate - DO NOT MODIFY */
+  void *_locate_ctx;
+  /** storage for the sprites and the layer list nodes - DO NOT MODIFY */
+  pool *_sprites, *_nodes;
+} sprite_layers;
+
+/** create an empty set of sprite layers
+  * \param capacity number of sprites to reserve storage for. exceeding it
+  * grows the storage rather than failing
+  * \param locate finds the owner of a sprite when it is drawn
+  * \param ctx passed to locate
+**/
+sprite_layers* sprite_layers_new(int capacity, sprite_locate_fn locate,
+    void *ctx);
 
-/** shut down sprite framework */
-void sprite_shutdown();
+/** free a set of sprite layers and every sprite in it */
+void sprite_layers_free(sprite_layers *layers);
+
+/** describe a sprite without placing it in a layer, resolving the bitmap
+  * once so \ref sprite_copy can create sprites without looking it up again
+  * \param name name of bitmap resource to load
+  * \param frame_width width in px of a single frame, 0 for the whole bitmap
+  * \param frame_height height in px of a single frame, 0 for the whole bitmap
+  * \param animation_rate frame cycle rate in frames/second
+  * \param type behavior of animation upon reaching end
+  * \return sprite to be copied. not drawn and never needs to be freed
+**/
+sprite sprite_template(const char *name, int frame_width, int frame_height,
+    double animation_rate, AnimationType type);
+
+/** create a new sprite with the same appearance as another
+  * \param layers layers to place the sprite in
+  * \param src sprite to copy, usually made by \ref sprite_template
+  * \param owner handle of the owner, see \ref sprite::owner
+  * \param depth layer at which to draw sprite
+  * \return the new sprite. free with \ref sprite_free
+**/
+sprite* sprite_copy(sprite_layers *layers, const sprite *src,
+    uint64_t owner, int depth);
 
 /** create a new sprite
+  * \param layers layers to place the sprite in
   * \param name name of bitmap resource to load
-  * \param ref_position pointer to position of owner
-  * \param ref_angle pointer to rotation of owner
+  * \param owner handle of the owner, see \ref sprite::owner
   * \param depth layer at which to draw sprite
   * \return return value description
 **/
-sprite* sprite_new(const char *name, vector *ref_position,
-    double *ref_angle, int depth);
+sprite* sprite_new(sprite_layers *layers, const char *name,
+    uint64_t owner, int depth);
 
 /** create a new animated sprite
+  * \param layers layers to place the sprite in
   * \param name name of bitmap resource to load
-  * \param ref_position pointer to position of owner
-  * \param ref_angle pointer to rotation of owner
+  * \param owner handle of the owner, see \ref sprite::owner
   * \param depth layer at which to draw sprite
   * \param frame_width width in px of a single frame of the animation
   * \param frame_height height in px of a single frame of the animation
@@ -74,9 +125,9 @@ sprite* sprite_new(const char *name, vector *ref_position,
   * \param type behavior of animation upon reaching end
   * \return return value description
 **/
-sprite* animation_new(const char *name, vector *ref_position, double *ref_angle, 
-    int depth, int frame_width, int frame_height, double animation_rate,
-    AnimationType type);
+sprite* animation_new(sprite_layers *layers, const char *name,
+    uint64_t owner, int depth, int frame_width,
+    int frame_height, double animation_rate, AnimationType type);
 
 /** delete a sprite*/
 void sprite_free(sprite *sprite);
@@ -84,8 +135,12 @@ void sprite_free(sprite *sprite);
 /** change the depth of a sprite */
 void sprite_set_depth(sprite *sprite, int depth);
 
-/** draw every sprite to the display */
-void render_all_sprites();
+/** draw every sprite in a set of layers to the display, and the particles
+  * between the layers below and above depth 0
+  * \param time time elapsed since the last draw, to advance animations
+**/
+void render_all_sprites(sprite_layers *layers, particle_system *particles,
+    double time);
 
 /** return the width of a sprite (taking scaling into account) */
 int sprite_width(sprite *s);
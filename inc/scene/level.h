@@ -4,10 +4,12 @@
 #include "scene/scene.h"
 #include "al_game.h"
 #include "ecs.h"
+#include "snapshot.h"
 #include "entity/player.h"
 #include "entity/enemies.h"
 #include "util/al_helper.h"
 
-scene level_new(void);
+/** create the level scene, populating the given world */
+scene level_new(ecs_world *world);
 
 #endif /* end of include guard: LEVEL_H */
@@ -0,0 +1,111 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/** \file snapshot.h
+  * \brief capture and restore the state of an \ref ecs_world
+  * A snapshot holds every entity, component and sprite, the particles, the
+  * weapon and scenery system state, the pairs of colliders in contact and
+  * the random number generator state of a world. Components include how
+  * long each collider has been idle, so sleeping colliders stay asleep.
+  * It may be restored into the world it was taken from or into another
+  * world created with the same capacities.
+  * Bitmaps, particle generator data, weapons and handler functions are
+  * stored by address, so a snapshot is only valid within the process that
+  * took it. Sounds, enemy waves and scene state are not captured.
+**/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "util/array.h"
+
+/** forward declaration of \ref ecs_world, defined in \ref ecs.h */
+struct ecs_world;
+
+/** binary image of the game world */
+typedef struct snapshot {
+  /** encoded state - DO NOT MODIFY */
+  array *_bytes;
+  /** offset of the next byte to read while restoring - DO NOT MODIFY */
+  size_t _read_pos;
+} snapshot;
+
+/** recent snapshots kept compactly, for rewinding a number of frames.
+ *  every \ref _keyframe_interval frames a snapshot is stored whole. the
+ *  frames in between are stored as a delta from the preceding whole one,
+ *  so restoring any frame decodes at most one delta */
+typedef struct snapshot_history {
+  /** number of frames stored in \ref _frames - DO NOT MODIFY */
+  int _capacity;
+  /** frames between whole snapshots - DO NOT MODIFY */
+  int _keyframe_interval;
+  /** frames pushed since creation or the last restore - DO NOT MODIFY */
+  int _pushed;
+  /** oldest frame whose slot has not been overwritten. a restore never moves
+   *  it back, as the discarded frames may have replaced older ones - DO NOT
+   *  MODIFY */
+  int _oldest;
+  /** ring of encoded frames, frame n is at n % capacity - DO NOT MODIFY */
+  array **_frames;
+  /** snapshot encoded frames are taken into and decoded to - DO NOT MODIFY */
+  snapshot *_scratch;
+} snapshot_history;
+
+/* Methods------------------------------------------------------------------- */
+/** create an empty snapshot. free with \ref snapshot_free */
+snapshot* snapshot_new();
+
+/** free a snapshot */
+void snapshot_free(snapshot *snap);
+
+/** capture the current state of a world, replacing the contents of a
+  * snapshot. must not be called inside a deferred section (see
+  * \ref ecs_defer_begin)
+**/
+void snapshot_take(snapshot *snap, struct ecs_world *world);
+
+/** return a world to the state captured by \ref snapshot_take.
+  * every existing entity is replaced. Restored components count as changed
+  * (see \ref ecs_write_component). must not be called inside a deferred
+  * section
+**/
+void snapshot_restore(snapshot *snap, struct ecs_world *world);
+
+/** number of bytes used by a snapshot */
+size_t snapshot_size(snapshot *snap);
+
+/** append raw data while a snapshot is taken - used by the save functions
+ *  of each module */
+void snapshot_write(snapshot *snap, const void *src, size_t size);
+
+/** read back data appended by \ref snapshot_write, in the same order */
+void snapshot_read(snapshot *snap, void *dst, size_t size);
+
+/** create an empty history
+  * \param capacity number of frames to keep
+  * \param keyframe_interval frames between whole snapshots, at most
+  * \c capacity. larger values save memory but make the oldest
+  * \c keyframe_interval - 1 frames unavailable once the ring is full
+**/
+snapshot_history* snapshot_history_new(int capacity, int keyframe_interval);
+
+/** free a history and every frame in it */
+void snapshot_history_free(snapshot_history *history);
+
+/** capture the current state of a world as the newest frame, overwriting
+  * the oldest frame once the history is full */
+void snapshot_history_push(snapshot_history *history, struct ecs_world *world);
+
+/** number of frames that can currently be restored */
+int snapshot_history_length(snapshot_history *history);
+
+/** return a world to an earlier frame. frames newer than it are
+  * discarded, so pushing may continue from the restored frame. the older
+  * frames they overwrote stay unavailable.
+  * \param frames_ago 0 for the newest frame, up to
+  * \ref snapshot_history_length - 1
+**/
+void snapshot_history_restore(snapshot_history *history,
+    struct ecs_world *world, int frames_ago);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: SNAPSHOT_H */
@@ -3,6 +3,6 @@
 
 #include "ecs.h"
 
-void behavior_system_fn(double time);
+void behavior_system_fn(struct ecs_world *world, double time);
 
 #endif /* end of include guard: BEHAVIOR_SYS_H */
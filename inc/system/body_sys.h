@@ -9,7 +9,12 @@
 #include "ecs.h"
 
 /** system function to update movement of physical bodies */
-void body_system_fn(double time);
+void body_system_fn(struct ecs_world *world, double time);
+
+/** system function run after movement. recomputes the bounds of every
+  * entity (see \ref ecs_update_bounds), then destroys bodies whose bounds
+  * have left the screen through a side in \ref Body::destroy_on_exit */
+void bounds_system_fn(struct ecs_world *world, double time);
 
 /** set up a body component to have constant velocity
   * \param b Body component to modify
@@ -3,8 +3,95 @@
 
 #include "ecs.h"
 
-/** system to detect and handle collisions between \ref Collider components */
-void collision_system_fn(double time);
+struct snapshot;
+
+/** side in pixels of the broadphase grid cells of a new world */
+#define COLLISION_DEFAULT_CELL_SIZE 64
+/** seconds a body must be still before its collider sleeps, in a new
+ *  world */
+#define COLLISION_DEFAULT_SLEEP_DELAY 0.5
+
+/** work done by the last \ref collision_system_fn update of a world */
+typedef struct collision_stats {
+  int colliders;    ///< entities with a collider and a body
+  int resting;      ///< colliders asleep or stationary
+  int cell_entries; ///< colliders summed over every grid cell their paths
+                    ///< cover
+  int pair_tests;   ///< pairs sharing a cell that may collide (see
+                    ///< \ref Collider::mask), tested for overlap
+  int overlaps;     ///< tested pairs whose hit boxes touched during the
+                    ///< update
+  int contacts;     ///< pairs remembered as touching into the next update
+} collision_stats;
+
+/** two colliders whose hit boxes touched during an update. events are
+ *  found in parallel, then responded to in order once all are found */
+typedef struct collision_event {
+  /** the colliding entities, the first coming earlier in the query */
+  struct ecs_entity *entity1, *entity2;
+  /** unit normal of the face of entity2's hit box that entity1 reached,
+   *  zero if they did not move relative to each other */
+  vector normal;
+  /** fraction of the update, from 0 to 1, at which they first touched */
+  double time;
+} collision_event;
+
+/** create the scratch storage of a world's collision system - called by
+ *  \ref ecs_world_new */
+void collision_system_init(struct ecs_world *world);
+/** free the storage created by \ref collision_system_init */
+void collision_system_shutdown(struct ecs_world *world);
+
+/** set the side of the square cells of the broadphase grid covering the
+ *  screen. only colliders sharing a cell are tested against each other.
+ *  colliders are listed in every cell they cover while moving through an
+ *  update, so a size near that of common colliders works best */
+void collision_system_set_cell_size(struct ecs_world *world, float cell_size);
+
+/** set how long a body must be still before its collider falls asleep.
+ *  sleeping and \ref Collider::stationary colliders are only tested
+ *  against moving ones, so pairs that are both at rest cost nothing. a
+ *  collider wakes as soon as its body moves. INFINITY keeps every collider
+ *  awake */
+void collision_system_set_sleep_delay(struct ecs_world *world,
+    double seconds);
+
+/** counters from the last update of a world's collision system */
+collision_stats collision_system_stats(struct ecs_world *world);
+
+/** number of collisions found by the last update of a world's collision
+ *  system, including any skipped because a handler destroyed an entity */
+int collision_system_event_count(struct ecs_world *world);
+/** get a collision found by the last update of a world's collision system
+ *  \param idx index in [0, \ref collision_system_event_count), in the order
+ *  the collisions were responded to. entities may have been destroyed since
+**/
+const collision_event* collision_system_event(struct ecs_world *world,
+    int idx);
+
+/** append the pairs in contact to a snapshot (see \ref snapshot.h) */
+void collision_system_save(struct ecs_world *world, struct snapshot *snap);
+/** restore the contacts appended by \ref collision_system_save */
+void collision_system_load(struct ecs_world *world, struct snapshot *snap);
+
+/** system to detect and handle collisions between \ref Collider components.
+ *  colliders are kept inside the level and pairs whose hit boxes touched
+ *  at any time during the update, swept along their velocities, are found
+ *  among colliders sharing a cell of a uniform grid whose categories, masks
+ *  and teams allow them to collide. strips of cells are searched in
+ *  parallel on the job system (see util/job.h), each pair in the first cell
+ *  both cover, so colliders straddling cells are tested once. finding them
+ *  only reads the world and records a \ref collision_event per pair, in
+ *  the same order however many threads searched. the events are then
+ *  responded to in order on the calling thread: elastic pairs are moved
+ *  back to their time of impact to bounce, and each pair's handlers run at
+ *  most once. pairs that touched are remembered into the next update, so
+ *  \ref Collider::on_collision only runs as a pair starts touching,
+ *  \ref Collider::on_collision_stay while it stays in contact and
+ *  \ref Collider::on_collision_exit once it separates. pairs of resting
+ *  colliders that have not moved since they last touched stay in contact
+ *  without being tested again */
+void collision_system_fn(struct ecs_world *world, double time);
 
 /** create a hitrect the size of a sprite (takes scale into account) */
 rectangle hitrect_from_sprite(sprite *sprite);
@@ -3,7 +3,7 @@
 
 #include "ecs.h"
 
-void health_system_fn(double time);
+void health_system_fn(struct ecs_world *world, double time);
 
 /** deal damage to an entity */
 void deal_damage(struct ecs_entity *entity, double amount);
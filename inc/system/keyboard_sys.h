@@ -3,6 +3,7 @@
 
 #include "ecs.h"
 
-void ecs_handle_keypress(ALLEGRO_EVENT ev);
+/** pass a keyboard event to every keyboard listener in a world */
+void ecs_handle_keypress(struct ecs_world *world, ALLEGRO_EVENT ev);
 
 #endif /* end of include guard: KEYBOARD_SYS_H */
@@ -3,6 +3,7 @@
 
 #include "ecs.h"
 
-void ecs_handle_mouse(ALLEGRO_EVENT ev);
+/** pass a mouse event to every mouse listener in a world */
+void ecs_handle_mouse(struct ecs_world *world, ALLEGRO_EVENT ev);
 
 #endif /* end of include guard: MOUSE_SYS_H */
@@ -4,7 +4,7 @@
 #include "ecs.h"
 #include "particle_effects.h"
 
-void propulsion_system_fn(double time);
+void propulsion_system_fn(struct ecs_world *world, double time);
 
 void propulsion_assign_sound(struct ecs_entity *prop_entity, char *sound_name);
 
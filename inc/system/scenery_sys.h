@@ -3,34 +3,50 @@
 
 #include "ecs.h"
 
+struct snapshot;
+
+/** create the spawn timers of a world - called by \ref ecs_world_new */
+void scenery_system_init(struct ecs_world *world);
+/** free the timers created by \ref scenery_system_init */
+void scenery_system_shutdown(struct ecs_world *world);
+
 /** system update function for scenery */
-void scenery_system_fn(double time);
+void scenery_system_fn(struct ecs_world *world, double time);
 
+/** append spawn timers to a snapshot (see \ref snapshot.h) */
+void scenery_system_save(struct ecs_world *world, struct snapshot *snap);
+/** restore the timers appended by \ref scenery_system_save */
+void scenery_system_load(struct ecs_world *world, struct snapshot *snap);
 /** set frequency at which clouds spawn */
-void scenery_sys_set_cloud_frequency(double clouds_per_sec);
+void scenery_sys_set_cloud_frequency(struct ecs_world *world,
+    double clouds_per_sec);
 
 /** fill out scenery before level begins. 
  *  Creates numerous entities, creating the appearance that the system has been
- *  run for awhile*/
-void scenery_pre_populate();
+ *  run for awhile. Also loads the scenery prefabs, so call it before
+ *  updating worlds on more than one thread */
+void scenery_pre_populate(struct ecs_world *world);
 
 /** add a scrolling background
+  * \param world world to add the background to
   * \param name name of bitmap resource to use for background
   * \param depth layer at which to draw background
   * \param speed movement rate of background (towards \ref WEST)
   * \param offset starting x offset towards EAST
 **/
-void scenery_add_background(const char *name, int depth, double speed, int
-    offset);
+void scenery_add_background(struct ecs_world *world, const char *name,
+    int depth, double speed, int offset);
 
 /** create an explosion
+  * \param world world to create the explosion in
   * \param pos center position of explosion
   * \param size x and y scale of explosion
   * \param anim_rate rate of animation for explosion
   * \param tint shade of explosion
   * \param sound_name name of sound effect to play
+  * safe to call from jobs, see \ref ecs_call_synced
 **/
-void scenery_make_explosion(vector pos, vector size, double anim_rate,
-    ALLEGRO_COLOR tint, const char *sound_name);
+void scenery_make_explosion(struct ecs_world *world, vector pos, vector size,
+    double anim_rate, ALLEGRO_COLOR tint, const char *sound_name);
 
 #endif /* end of include guard: SCENERY_H */
@@ -0,0 +1,64 @@
+#ifndef SPATIAL_SYS_H
+#define SPATIAL_SYS_H
+
+#include "ecs.h"
+
+/** side in pixels of the cells of a world's spatial index */
+#define SPATIAL_CELL_SIZE 64
+/** most entities \ref ecs_query_knn finds at once */
+#define ECS_QUERY_MAX_K 64
+
+/** bit of an \ref ecs_entity_tag in \ref ecs_spatial_filter::tags */
+#define ECS_TAG_BIT(tag) ((uint32_t)1 << (tag))
+/** bit of an \ref ecs_entity_team in \ref ecs_spatial_filter::teams */
+#define ECS_TEAM_BIT(team) ((uint32_t)1 << (team))
+
+/** which entities a spatial query may find. zero initialize to find any */
+typedef struct ecs_spatial_filter {
+  uint32_t tags;  ///< \ref ECS_TAG_BIT of each tag to find, 0 for any
+  uint32_t teams; ///< \ref ECS_TEAM_BIT of each team to find, 0 for any
+  struct ecs_entity *exclude; ///< entity never found, e.g. the asker
+} ecs_spatial_filter;
+
+/** create the spatial index of a world - called by \ref ecs_world_new */
+void spatial_system_init(struct ecs_world *world);
+/** free the storage created by \ref spatial_system_init */
+void spatial_system_shutdown(struct ecs_world *world);
+
+/** system listing the positions of every entity in a grid over the screen,
+ *  so the spatial queries below only look at entities near the spot they
+ *  ask about. it runs after the health and timer systems and before any
+ *  entity moves, so queries see positions as of the start of the update,
+ *  including entities those two systems created in it. entities created
+ *  later in the update are not found, and those destroyed since the index
+ *  was built are skipped. \ref ecs_load rebuilds the index from the
+ *  entities it restores. queries only read the index, so systems reading
+ *  \ref ECS_ACCESS_SPATIAL may ask them at the same time */
+void spatial_system_fn(struct ecs_world *world, double time);
+
+/** find the entities whose positions are within a distance of a spot
+  * \param out receives the entities found, ordered by where they are in the
+  * index, so the same for the same world
+  * \param max most entities written to out
+  * \return number of entities found, which may be more than max
+**/
+int ecs_query_radius(struct ecs_world *world, vector center, double radius,
+    ecs_spatial_filter filter, struct ecs_entity **out, int max);
+/** find the entity whose position is nearest a spot
+  * \param radius distance beyond which entities are not found. may be
+  * INFINITY
+  * \return the nearest entity, or NULL if none is within radius
+**/
+struct ecs_entity* ecs_query_nearest(struct ecs_world *world, vector center,
+    double radius, ecs_spatial_filter filter);
+/** find the entities whose positions are nearest a spot
+  * \param radius distance beyond which entities are not found. may be
+  * INFINITY
+  * \param k most entities to find, at most \ref ECS_QUERY_MAX_K
+  * \param out receives the entities found, nearest first
+  * \return number of entities found, at most k
+**/
+int ecs_query_knn(struct ecs_world *world, vector center, double radius,
+    int k, ecs_spatial_filter filter, struct ecs_entity **out);
+
+#endif /* end of include guard: SPATIAL_SYS_H */
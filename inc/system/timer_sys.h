@@ -3,6 +3,6 @@
 
 #include "ecs.h"
 
-void timer_system_fn(double time);
+void timer_system_fn(struct ecs_world *world, double time);
 
 #endif /* end of include guard: TIMER_SYS_H */
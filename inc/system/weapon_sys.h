@@ -5,6 +5,8 @@
 #include "system/health_sys.h"
 #include "system/scenery_sys.h"
 
+struct snapshot;
+
 typedef enum WeaponState {
   WEAPON_READY,
   WEAPON_FIRING,
@@ -27,16 +29,28 @@ typedef struct Weapon {
   double deceleration_factor;  ///< deceleration_factor of projectile \c Body
   double fire_delay;           ///< time between successive launches
   ecs_entity_trigger fire_fn;  ///< special function to use when firing
+  struct prefab *_projectile;  ///< projectile blueprint - DO NOT MODIFY
 } Weapon;
 
-/** set weapons for the weapon system */
-void weapon_system_set_weapons(struct ecs_entity *player, Weapon *wep1, Weapon *wep2);
+/** create the targeting and firing state of a world - called by
+ *  \ref ecs_world_new */
+void weapon_system_init(struct ecs_world *world);
+/** free the state created by \ref weapon_system_init */
+void weapon_system_shutdown(struct ecs_world *world);
+
+/** set weapons for the weapon system of the player's world */
+void weapon_system_set_weapons(struct ecs_entity *player, Weapon *wep1,
+    Weapon *wep2);
 
+/** append targeting and firing state to a snapshot (see \ref snapshot.h) */
+void weapon_system_save(struct ecs_world *world, struct snapshot *snap);
+/** restore the state appended by \ref weapon_system_save */
+void weapon_system_load(struct ecs_world *world, struct snapshot *snap);
 /** update the weapon system */
-void weapon_system_fn(double time);
+void weapon_system_fn(struct ecs_world *world, double time);
 
 /** draw weapon targeting indicators */
-void weapon_system_draw();
+void weapon_system_draw(struct ecs_world *world);
 
 /** try locking on to the provided entity */
 void weapon_set_target(struct ecs_entity *target);
@@ -45,7 +59,7 @@ void weapon_set_target(struct ecs_entity *target);
 void weapon_clear_target(struct ecs_entity *target);
 
 /** fire the player's current weapon */
-void weapon_fire_player();
+void weapon_fire_player(struct ecs_world *world);
 
 void fire_swarmer_pod(struct ecs_entity *firing_entity);
 
@@ -53,9 +67,9 @@ void fire_swarmer_pod(struct ecs_entity *firing_entity);
 void weapon_fire_enemy(struct ecs_entity *enemy, void *player);
 
 /** switch between primary and secondary weapon */
-void weapon_swap();
+void weapon_swap(struct ecs_world *world);
 
-/** switch between primary and secondary weapon */
-void launch_flare(vector pos);
+/** launch a flare that distracts seeking projectiles */
+void launch_flare(struct ecs_world *world, vector pos);
 
 #endif /* end of include guard: WEAPON_SYS_H */
@@ -6,11 +6,21 @@
 **/
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 #include <allegro5/allegro.h>
 #include <allegro5/color.h>
 #include "util/geometry.h"
 
+/** seed the generator used by the rand* functions. each thread has its own
+ *  generator, so this only affects the calling thread */
+void rand_seed(uint64_t seed);
+/** get the state of the random generator, e.g. to save it in a snapshot */
+uint64_t rand_get_state();
+/** restore a state returned by \ref rand_get_state */
+void rand_set_state(uint64_t state);
+/** return 64 random bits, e.g. to seed another generator */
+uint64_t rand_bits();
 /**return a random int between min and max (inclusive) */
 int randi(int min, int max);
 
@@ -0,0 +1,30 @@
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+#include <stdbool.h>
+
+/** \file alloc_guard.h
+  * \brief count heap allocations made during a section of code
+  * Counting only works in builds compiled with ALLOC_GUARD defined and
+  * linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see the
+  * \c guard make target). Allocations from every thread are counted, so
+  * jobs run during a section count towards it. Only allocations made by the
+  * game's own code are seen - allocations inside Allegro are not counted.
+  * In other builds every function here does nothing.
+**/
+
+/* Methods------------------------------------------------------------------- */
+/** \brief true if this build counts allocations */
+bool alloc_guard_enabled();
+/** \brief start counting allocations
+  * \param abort_on_alloc if true, the first allocation before
+  * \ref alloc_guard_end prints an error and aborts, so a debugger shows
+  * where it was made
+**/
+void alloc_guard_begin(bool abort_on_alloc);
+/** \brief stop counting allocations
+  * \return number of allocations since \ref alloc_guard_begin
+**/
+int alloc_guard_end();
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: ALLOC_GUARD_H */
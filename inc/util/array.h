@@ -0,0 +1,57 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** \file array.h
+  * \brief A growable array of fixed-size elements stored contiguously
+**/
+
+/* Types -------------------------------------------------------------------- */
+/** \brief packed storage for elements of a single size */
+typedef struct array {
+  char *data;       ///< start of element storage
+  size_t elem_size; ///< size in bytes of a single element
+  int length;       ///< number of elements in use
+  int capacity;     ///< number of elements that fit before reallocating
+} array;
+
+/** \brief loop over the elements of an array in order, assigning a pointer
+    to each to \c var, declared by the caller. the pointer is computed inline
+    rather than by \ref array_get. only elements present when the loop starts
+    are visited. the body may push elements, which may move the storage, but
+    must not remove any. e.g.
+    \code vector *v; ARRAY_FOREACH(v, points) { v->x += 1; } \endcode */
+#define ARRAY_FOREACH(var, arr)                                        \
+  for (int var##_idx = 0, var##_end = (arr)->length;                   \
+      var##_idx < var##_end &&                                          \
+      ((var) = (void*)((arr)->data + (arr)->elem_size * var##_idx), 1); \
+      var##_idx++)
+/* -------------------------------------------------------------------------- */
+
+/* Methods------------------------------------------------------------------- */
+/** \brief create a new array
+  * \param elem_size size in bytes of each element
+  * \param capacity number of elements to reserve space for (may be 0)
+**/
+array* array_new(size_t elem_size, int capacity);
+/** \brief destroy an array and its storage */
+void array_free(array *array);
+/** \brief append a zeroed element and return a pointer to it.
+    may reallocate storage, invalidating pointers to existing elements */
+void* array_push(array *array);
+/** \brief make room for at least \c capacity elements in one allocation.
+    returns true if storage moved, invalidating pointers to elements */
+bool array_reserve(array *array, int capacity);
+/** \brief get a pointer to the element at \c idx */
+void* array_get(array *array, int idx);
+/** \brief get the index of an element from a pointer into the array */
+int array_index_of(array *array, void *elem);
+/** \brief remove the element at \c idx by moving the last element into its
+    place. returns true if an element was moved */
+bool array_swap_remove(array *array, int idx);
+/** \brief remove all elements without releasing storage */
+void array_clear(array *array);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: ARRAY_H */
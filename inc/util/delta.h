@@ -0,0 +1,29 @@
+#ifndef DELTA_H
+#define DELTA_H
+#include <stddef.h>
+#include "util/array.h"
+
+/** \file delta.h
+  * \brief compact encoding of the difference between two byte buffers
+**/
+
+/* Methods------------------------------------------------------------------- */
+/** \brief encode \c cur as a difference from \c base.
+    bytes that match \c base cost almost nothing, so the encoding of a buffer
+    that differs little from its base is small. \c base may be shorter or
+    longer than \c cur.
+  * \param out byte array (element size 1) that the encoding replaces
+**/
+void delta_encode(const char *base, size_t base_len, const char *cur,
+    size_t cur_len, array *out);
+/** \brief rebuild the buffer encoded by \ref delta_encode
+  * \param base the same base passed to \ref delta_encode
+  * \param out byte array (element size 1) that the rebuilt buffer replaces
+**/
+void delta_decode(const char *base, size_t base_len, const char *delta,
+    size_t delta_len, array *out);
+/** \brief append \c size bytes to a byte array, growing it geometrically */
+void delta_append(array *bytes, const void *src, size_t size);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: DELTA_H */
@@ -2,6 +2,7 @@
 #define GEOMETRY_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 #include <stdlib.h>
 
@@ -23,6 +24,29 @@ typedef enum Direction {
   ALL_DIRECTIONS = NORTH | SOUTH | EAST | WEST
 } Direction;
 
+/** An axis-aligned box stored as the coordinates of its edges */
+typedef struct aabb {
+  float left, top, right, bottom;
+} aabb;
+
+/** axis-aligned boxes stored as one array per edge, so one box can be
+ *  tested against several at once (see \ref aabb_intersect_batch). the
+ *  arrays belong to the caller */
+typedef struct aabb_soa {
+  float *left, *top, *right, *bottom;
+} aabb_soa;
+
+/** most boxes tested by one call to \ref aabb_intersect_batch */
+#define AABB_BATCH 32
+
+/** instructions \ref aabb_intersect_batch_path may test boxes with */
+typedef enum aabb_batch_path {
+  AABB_BATCH_SCALAR, ///< plain C, always available
+  AABB_BATCH_SSE2,   ///< 4 boxes at a time, if the compiler targets SSE2
+  AABB_BATCH_AVX2,   ///< 8 boxes at a time, if the processor has AVX2
+  NUM_AABB_BATCH_PATHS
+} aabb_batch_path;
+
 /** A 2D vector */
 typedef struct vector {
   double x, y;
@@ -63,6 +87,43 @@ vector vector_rotate(vector v, double angle);
 bool rect_contains_point(rectangle r, point p);
 /** return true if rectangles intersect*/
 bool rect_intersect(rectangle r1, rectangle r2);
+/** box of size \c w by \c h centered on a point */
+aabb aabb_around(vector center, double w, double h);
+/** move a box by an offset */
+aabb aabb_offset(aabb box, vector offset);
+/** smallest box containing both boxes */
+aabb aabb_union(aabb b1, aabb b2);
+/** return true if boxes overlap or touch */
+bool aabb_intersect(aabb b1, aabb b2);
+/** test a box against the boxes [first, first + count) of a packed array,
+  * as \ref aabb_intersect does. bit i of the result is set if the box
+  * touches box first + i. uses AVX2 where the processor has it, else SSE2
+  * where the compiler targets it. the processor is checked once
+  * \param count number of boxes to test, at most \ref AABB_BATCH
+**/
+uint32_t aabb_intersect_batch(aabb box, aabb_soa boxes, int first,
+    int count);
+/** \ref aabb_intersect_batch without vector instructions */
+uint32_t aabb_intersect_batch_scalar(aabb box, aabb_soa boxes, int first,
+    int count);
+/** \ref aabb_intersect_batch using the given instructions, e.g. to compare
+  * the paths. the path must be supported, see \ref aabb_batch_supported */
+uint32_t aabb_intersect_batch_path(aabb_batch_path path, aabb box,
+    aabb_soa boxes, int first, int count);
+/** true if this build and processor can run a path of
+  * \ref aabb_intersect_batch_path */
+bool aabb_batch_supported(aabb_batch_path path);
+/** time from 0 to 1 at which box \c a, moving by \c motion, first touches
+  * the still box \c b, found in closed form. 0 if they touch at the start,
+  * INFINITY if they do not meet during the move. to sweep two moving boxes,
+  * pass the difference of their motions
+  * \param normal if not NULL and the boxes meet, set to the unit normal of
+  * the face of \c b that \c a reached, or the zero vector if \c a does not
+  * move
+**/
+double aabb_sweep(aabb a, aabb b, vector motion, vector *normal);
+/** return true if p is inside box or on its edge */
+bool aabb_contains_point(aabb box, vector p);
 /** normalize an angle (radians) so it falls between -PI and PI */
 double normalize_angle(double angle);
 /** return shortest angle from \c to to \c from */
@@ -0,0 +1,79 @@
+#ifndef JOB_H
+#define JOB_H
+#include <stdatomic.h>
+
+/** \file job.h
+  * \brief spread work across a fixed set of worker threads
+  * Each worker owns a queue of jobs. A worker takes its newest job first and
+  * when its own queue is empty steals the oldest job of another worker. The
+  * thread calling \ref job_system_init is worker 0 and only runs jobs while
+  * it waits (see \ref job_wait). Jobs are kept in fixed size queues, so
+  * submitting one never allocates.
+  * Before \ref job_system_init and after \ref job_system_shutdown every job
+  * runs immediately on the submitting thread, so code using jobs behaves the
+  * same, only serially.
+**/
+
+/** most threads that may run jobs, including the one starting the system */
+#define JOB_MAX_THREADS 64
+
+/* Types -------------------------------------------------------------------- */
+/** \brief work done by a job: handle the elements [begin, end) of whatever
+  * ctx refers to */
+typedef void (*job_fn)(void *ctx, int begin, int end);
+
+/** \brief jobs that have been submitted but have not finished. zero
+  * initialize before use, e.g. job_wait_group wg = {0}; */
+typedef struct job_wait_group {
+  atomic_int _pending; ///< jobs not yet finished - DO NOT MODIFY
+} job_wait_group;
+/* -------------------------------------------------------------------------- */
+
+/* Methods------------------------------------------------------------------- */
+/** \brief start the worker threads
+  * \param num_threads total number of threads running jobs, including the
+  * calling thread. 0 or less uses one per online processor
+**/
+void job_system_init(int num_threads);
+/** \brief finish every queued job, then stop the worker threads. must be
+  * called by the thread that called \ref job_system_init */
+void job_system_shutdown();
+/** \brief number of threads running jobs, 1 when the system is not started */
+int job_thread_count();
+/** \brief index of the calling thread among those running jobs, from 0 to
+  * \ref job_thread_count - 1. threads outside the system share index 0 with
+  * the thread that started it */
+int job_thread_index();
+/** \brief number of jobs the calling thread is in the middle of, counting
+  * ranges \ref job_parallel_for runs on the caller and jobs run while
+  * waiting. 0 outside of any job, whether or not the system is started */
+int job_depth();
+/** \brief tag the jobs the calling thread submits from now on. a job runs
+  * with the tag it was submitted with, so the ranges of a job_parallel_for
+  * carry the tag of the code that started it. 0 until set */
+void job_set_tag(int tag);
+/** \brief tag of the calling thread, see \ref job_set_tag */
+int job_tag();
+/** \brief begin of the range the calling thread is running, 0 outside of any
+  * job. with \ref job_tag this names work the same way whichever thread runs
+  * it */
+int job_range_begin();
+/** \brief queue fn(ctx, begin, end) to run on any worker
+  * \param wg wait group counting the job until it finishes
+**/
+void job_submit(job_wait_group *wg, job_fn fn, void *ctx, int begin,
+    int end);
+/** \brief run queued jobs until every job in a wait group has finished.
+  * jobs may submit and wait for other jobs */
+void job_wait(job_wait_group *wg);
+/** \brief call fn on every element of [0, count) split into ranges of grain
+  * elements, and return once every range is done. The calling thread runs
+  * the first range. Ranges may run in any order and at the same time, so fn
+  * must not write anything another range reads.
+  * \param grain elements per job. large enough that each job outweighs the
+  * cost of queueing it
+**/
+void job_parallel_for(int count, int grain, job_fn fn, void *ctx);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: JOB_H */
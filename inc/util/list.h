@@ -1,6 +1,7 @@
 #ifndef LIST_H
 #define LIST_H
 #include <stdlib.h>
+#include "util/pool.h"
 
 /** \file list.h
   * \brief A basic doubly-linked list
@@ -16,23 +17,37 @@ typedef struct list_node {
 typedef struct list {
   list_node *head, *tail;
   int length;
+  pool *_nodes; ///< source of nodes, NULL to use the heap - DO NOT MODIFY
 } list;
 
 /** \brief function that can be applied to each node of a list */
 typedef void (*list_lambda)(void*);
+
+/** \brief loop over the values of a list from head to tail, assigning each
+    to \c var, a pointer declared by the caller. unlike \ref list_each the
+    loop body is inlined rather than called through a pointer. the body may
+    remove the current node, but no other. e.g.
+    \code sprite *s; LIST_FOREACH(s, sprites) { draw_sprite(s); } \endcode */
+#define LIST_FOREACH(var, lst)                                     \
+  for (list_node *var##_node = (lst)->head, *var##_next;           \
+      var##_node != NULL &&                                         \
+      (var##_next = var##_node->next, (var) = var##_node->value, 1); \
+      var##_node = var##_next)
 /* -------------------------------------------------------------------------- */
 
 /* Methods------------------------------------------------------------------- */
 /** \brief create a new list */
 list* list_new(void);
+/** \brief create a new list whose nodes come from a pool instead of the
+    heap, so pushing and removing does not allocate once the pool has room.
+    several lists may share a pool of \c sizeof(list_node) objects */
+list* list_new_pooled(pool *nodes);
 /** destroy a list and all of its nodes.
   * if fn is not NULL, call it on the value of every node */
 void list_free(list *list, list_lambda fn);
-/** remove all of a list's elements by calling \ref fn (if fn is not NULL) */
+/** remove all of a list's elements, calling \ref fn on each value if fn is
+  * not NULL. fn must not modify the list */
 void list_clear(list *list, list_lambda fn);
-/** \brief destroy a list and all of its nodes */
-/** \brief if fn is not NULL, call it on the value of every node */
-void list_free(list *list, list_lambda fn);
 /** \brief prepend node containing value to list */
 list_node* list_push(list *list, void *value);
 /** \brief remove and retrieve head of list */
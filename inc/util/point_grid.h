@@ -0,0 +1,87 @@
+#ifndef POINT_GRID_H
+#define POINT_GRID_H
+#include <stdbool.h>
+#include "util/array.h"
+#include "util/geometry.h"
+
+/** \file point_grid.h
+  * \brief find the points near a spot among many, without testing them all
+  * Points are listed in the square cells of a uniform grid over an area, so
+  * a query only visits the cells it could find points in. Points outside
+  * the area are listed in the nearest cells and are still found, only less
+  * cheaply. Queries only read the grid, so any number may run at once.
+**/
+
+/* Types -------------------------------------------------------------------- */
+/** \brief decide whether a query may return a point
+  * \param ctx context given to the query
+  * \param id index of the point in the points given to
+  * \ref point_grid_build
+**/
+typedef bool (*point_grid_filter)(void *ctx, int id);
+
+/** \brief handle a point found by a query
+  * \param ctx context given to the query
+  * \param id index of the point in the points given to
+  * \ref point_grid_build
+**/
+typedef void (*point_grid_visitor)(void *ctx, int id);
+
+/** \brief points listed by the cells of a grid covering an area */
+typedef struct point_grid {
+  aabb area;          ///< box covered by the cells
+  float cell_size;    ///< side of the square cells
+  int cols, rows;     ///< cells across and down the area
+  int count;          ///< points listed by the last \ref point_grid_build
+  array *_cell_start; ///< int first entry of each cell, then the end -
+                      ///< DO NOT MODIFY
+  array *_entries;    ///< points and their ids, by cell - DO NOT MODIFY
+  array *_points;     ///< vector of each point, by id - DO NOT MODIFY
+} point_grid;
+/* -------------------------------------------------------------------------- */
+
+/* Methods------------------------------------------------------------------- */
+/** \brief create an empty grid
+  * \param area box to divide into cells
+  * \param cell_size side of the cells. near the radius of common queries
+  * works best
+  * \param capacity number of points to reserve space for (may be 0)
+**/
+point_grid* point_grid_new(aabb area, float cell_size, int capacity);
+/** \brief destroy a grid and its storage */
+void point_grid_free(point_grid *grid);
+/** \brief list points in a grid in place of those listed before. only
+  * allocates when listing more points than there is space for
+  * \param points points to list, identified by their index. copied
+**/
+void point_grid_build(point_grid *grid, const vector *points, int count);
+/** \brief call a function on each point within a distance of a spot, in
+  * order of cell then id
+  * \return number of points visited
+**/
+int point_grid_visit_radius(point_grid *grid, vector center, double radius,
+    point_grid_visitor visit, void *ctx);
+/** \brief find the points within a distance of a spot
+  * \param filter if not NULL, only points it accepts are found. it is called
+  * once for each point within the distance
+  * \param out receives the ids of the points found, ordered by cell then id
+  * \param max most ids written to out
+  * \return number of points found, which may be more than max
+**/
+int point_grid_radius(point_grid *grid, vector center, double radius,
+    point_grid_filter filter, void *ctx, int *out, int max);
+/** \brief find the points nearest a spot, visiting cells outward from it
+  * until no unvisited cell could hold a nearer one
+  * \param radius distance beyond which points are not found. may be
+  * INFINITY
+  * \param k most points to find
+  * \param filter if not NULL, only points it accepts are found
+  * \param out receives the ids of the points found, nearest first. points
+  * at the same distance are ordered by id
+  * \return number of points found, at most k
+**/
+int point_grid_nearest(point_grid *grid, vector center, double radius, int k,
+    point_grid_filter filter, void *ctx, int *out);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: POINT_GRID_H */
@@ -0,0 +1,43 @@
+#ifndef POOL_H
+#define POOL_H
+#include <stdlib.h>
+
+/** \file pool.h
+  * \brief A slab allocator for many objects of a single size
+**/
+
+/* Types -------------------------------------------------------------------- */
+/** \brief allocation counters for a \ref pool */
+typedef struct pool_stats {
+  int live;  ///< objects currently allocated
+  int peak;  ///< highest value \ref live has reached
+  int slabs; ///< slabs requested from the system allocator
+} pool_stats;
+
+/** \brief hands out fixed-size objects carved from large slabs.
+    released objects are kept on a free list and reused before any new slab
+    is allocated. slabs are only returned to the system by \ref pool_free */
+typedef struct pool {
+  size_t elem_size;  ///< size of each object (rounded up for alignment)
+  int slab_size;     ///< number of objects carved from each slab
+  void *_free_list;  ///< head of the list of released objects
+  void *_slabs;      ///< head of the list of allocated slabs
+  pool_stats stats;  ///< allocation counters
+} pool;
+/* -------------------------------------------------------------------------- */
+
+/* Methods------------------------------------------------------------------- */
+/** \brief create a new pool. the first slab is allocated immediately.
+  * \param elem_size size in bytes of each object
+  * \param slab_size number of objects to allocate per slab
+**/
+pool* pool_new(size_t elem_size, int slab_size);
+/** \brief destroy a pool, releasing every slab and every object in it */
+void pool_free(pool *pool);
+/** \brief get a zeroed object from the pool */
+void* pool_alloc(pool *pool);
+/** \brief return an object obtained from \ref pool_alloc to the pool */
+void pool_release(pool *pool, void *obj);
+/* -------------------------------------------------------------------------- */
+
+#endif /* end of include guard: POOL_H */
@@ -15,17 +15,20 @@ typedef struct EnemySpawnData {
   vector target; ///< location to move to
   vector exit; ///< location to move to when exiting
   double duration; ///< how long to stay before exiting (seconds)
-  ecs_entity *player; ///< pointer to player enemy
+  ecs_handle player; ///< handle to player entity
 } EnemySpawnData;
 
-/** function used by an \ref EnemyWave to spawn enemy instances.
- *  enemy starts at \c start and moves to \c target. It waits for \c duration
- *  before moving to \c exit. \c player is a pointer to the player entity */
-typedef void (*wave_spawn_fn)(EnemySpawnData);
+/** function used by an \ref EnemyWave to spawn a group of enemy instances.
+ *  each enemy starts at \c start and moves to \c target. It waits for
+ *  \c duration before moving to \c exit. \c player is a handle to the player
+ *  entity. \c count is the number of elements in \c data. enemies are
+ *  spawned in \c world, the world of the player */
+typedef void (*wave_spawn_fn)(ecs_world *world, const EnemySpawnData *data,
+    int count);
 
 /** Represents a wave of enemies in a level */
 typedef struct EnemyWave {
-  wave_spawn_fn spawn_fn; ///< function called to spawn enemies
+  wave_spawn_fn spawn_fn; ///< function called to spawn the wave's enemies
   int quantity;           ///< number of enemies to spawn
   Direction spawn_side;   ///< side of screen to spawn from
   Direction exit_side;    ///< side of screen to spawn from
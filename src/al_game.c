@@ -25,7 +25,7 @@ static void* font_from_file(const char *filename);
 static void* sound_from_file(const char *filename);
 
 int al_game_init() {
-  srand((unsigned)time(NULL));
+  rand_seed((uint64_t)time(NULL));
 
   // initialize allegro and subsystems
   if (!al_init()) {
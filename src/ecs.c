@@ -1,76 +1,756 @@
+#include <stddef.h>
+#include <stdalign.h>
+#include <string.h>
+#include <threads.h>
 #include "ecs.h"
+#include "snapshot.h"
+#include "util/job.h"
 
-// externally declared in ecs.h - will be populated and used here
-list *ecs_systems;
-list *ecs_entities;
-list *ecs_component_store[NUM_COMPONENT_TYPES];
+// size of a component holding only the header and the given union member
+#define COMPONENT_SIZE(member) \
+  (offsetof(ecs_component, member) + sizeof(((ecs_component*)0)->member))
+// offset of the type-specific data shared by every union member
+#define COMPONENT_DATA_OFFSET offsetof(ecs_component, body)
 
-void ecs_init() {
-  sprite_init();
-  ecs_systems = list_new();
-  ecs_entities = list_new();
+// mask selecting the entity table index of an ecs_handle
+#define HANDLE_INDEX_MASK 0xFFFFFFFFull
+// entities per slab and components, sprites and particles reserved by
+// ecs_world_new
+#define DEFAULT_ENTITY_CAPACITY 512
+#define DEFAULT_COMPONENT_CAPACITY 256
+#define DEFAULT_SPRITE_CAPACITY 512
+#define DEFAULT_PARTICLE_CAPACITY 32768
+
+// bytes used by a single stored component of each type
+static const size_t component_sizes[NUM_COMPONENT_TYPES] = {
+  [ECS_COMPONENT_BODY]              = COMPONENT_SIZE(body),
+  [ECS_COMPONENT_COLLIDER]          = COMPONENT_SIZE(collider),
+  [ECS_COMPONENT_PROPULSION]        = COMPONENT_SIZE(propulsion),
+  [ECS_COMPONENT_HEALTH]            = COMPONENT_SIZE(health),
+  [ECS_COMPONENT_TIMER]             = COMPONENT_SIZE(timer),
+  [ECS_COMPONENT_BEHAVIOR]          = COMPONENT_SIZE(behavior),
+  [ECS_COMPONENT_KEYBOARD_LISTENER] = COMPONENT_SIZE(keyboard_listener),
+  [ECS_COMPONENT_MOUSE_LISTENER]    = COMPONENT_SIZE(mouse_listener)
+};
+// slot in the entity table referenced by an ecs_handle
+typedef struct entity_slot {
+  ecs_entity *entity;  // entity occupying slot, NULL if free
+  uint32_t generation; // incremented each time the slot is freed, never 0
+  int next_free;       // index of next free slot, -1 if last
+} entity_slot;
+// kinds of change that can be recorded in an ecs_commands buffer
+typedef enum ecs_command_type {
+  ECS_COMMAND_NONE,             // cancelled, skipped on playback
+  ECS_COMMAND_DESTROY,          // free entity
+  ECS_COMMAND_ADD_COMPONENT,    // attach staged component
+  ECS_COMMAND_REMOVE_COMPONENT, // remove component of type component.type
+  ECS_COMMAND_PARTICLES,        // emit particles
+  ECS_COMMAND_SOUND,            // play a sound once
+  ECS_COMMAND_CALL              // call a function with copied arguments
+} ecs_command_type;
+
+// a single recorded change
+typedef struct ecs_command {
+  ecs_command_type type;
+  ecs_handle entity; // entity the change applies to, or that caused it
+  int tag, range;    // job that queued the change, see queue_command
+  union {
+    ecs_component component; // staged component, only type used for removal
+    struct {
+      particle_generator generator;
+      int count;
+      vector velocity;
+    } particles;
+    const char *sound;
+    struct {
+      ecs_synced_fn fn;
+      alignas(max_align_t) char args[ECS_MAX_CALL_ARGS];
+    } call;
+  };
+} ecs_command;
+
+// position of a queued command, see play_queued
+typedef struct queued_command {
+  uint64_t source; // 0 if queued without an entity, else its slot + 1
+  int tag, range;  // job that queued the command
+  int thread;      // thread that queued the command
+  int index;       // index of the command in the queue of that thread
+} queued_command;
+
+// world whose systems the calling thread is running, and the job depth
+// they run at. calls from deeper jobs are queued, see ecs_must_queue
+static thread_local ecs_world *updating_world;
+static thread_local int update_depth;
+
+// point the owner of every component in a store back at its current slot
+static void relink_store(ecs_world *world, ecs_component_type type);
+// point an entity and every query row it occupies at a moved component
+static void set_component(ecs_entity *entity, ecs_component_type type,
+    ecs_component *comp);
+// add an entity to an unordered set, returning its index there
+static int set_insert(array *set, ecs_entity *entity);
+// remove the entity at idx from a set. the entity moved into its place, if
+// any, is returned so its index can be updated
+static ecs_entity* set_erase(array *set, int idx);
+// add a row for an entity that has just come to match a query
+static void query_insert(ecs_query *query, ecs_entity *entity);
+// remove the row of an entity that no longer matches a query
+static void query_erase(ecs_query *query, ecs_entity *entity);
+// boxes of an entity at its current position
+static ecs_bounds compute_bounds(ecs_entity *entity);
+// free an entity and its components immediately
+static void destroy_entity(ecs_entity *entity);
+// apply a recorded change
+static void apply_command(ecs_world *world, ecs_command *cmd);
+// append a command to the queue of the calling thread
+static ecs_command* queue_command(ecs_world *world, ecs_entity *source,
+    ecs_command_type type);
+// apply the commands queued by every thread, see ecs_must_queue
+static void play_queued(ecs_world *world);
+// remove a component from an entity and its store immediately
+static void remove_component_now(ecs_entity *entity, ecs_component_type type);
+// find where the owner of a sprite is, see sprite_locate_fn
+static bool locate_entity(void *ctx, uint64_t owner, vector *position,
+    double *angle);
+
+ecs_world* ecs_world_new() {
+  ecs_capacity capacity = {
+    .entities = DEFAULT_ENTITY_CAPACITY,
+    .sprites = DEFAULT_SPRITE_CAPACITY,
+    .particles = DEFAULT_PARTICLE_CAPACITY
+  };
   for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
-    ecs_component_store[i] = list_new();
+    capacity.components[i] = DEFAULT_COMPONENT_CAPACITY;
   }
-  list_push(ecs_systems, scenery_system_fn);
-  list_push(ecs_systems, collision_system_fn);
-  list_push(ecs_systems, body_system_fn);
-  list_push(ecs_systems, propulsion_system_fn);
-  list_push(ecs_systems, weapon_system_fn);
-  list_push(ecs_systems, behavior_system_fn);
-  list_push(ecs_systems, timer_system_fn);
-  list_push(ecs_systems, health_system_fn);
+  return ecs_world_new_with_capacity(capacity);
 }
 
-ecs_entity* ecs_entity_new(vector position, ecs_entity_tag tag) {
-  ecs_entity *entity = calloc(1, sizeof(ecs_entity));
+ecs_world* ecs_world_new_with_capacity(ecs_capacity capacity) {
+  ecs_world *world = calloc(1, sizeof(ecs_world));
+  world->sprites = sprite_layers_new(capacity.sprites, locate_entity, world);
+  world->particles = particle_system_new(capacity.particles);
+  world->_entity_capacity = capacity.entities;
+  world->systems = array_new(sizeof(ecs_system_entry), 16);
+  world->_entity_node_pool = pool_new(sizeof(list_node), capacity.entities);
+  world->entities = list_new_pooled(world->_entity_node_pool);
+  world->_entity_pool = pool_new(sizeof(ecs_entity), capacity.entities);
+  world->_slots = array_new(sizeof(entity_slot), capacity.entities);
+  world->_bounds = array_new(sizeof(ecs_bounds), capacity.entities);
+  world->_free_slot = -1;
+  world->_deferred = ecs_commands_new(world);
+  array_reserve(world->_deferred->_commands, capacity.entities);
+  for (int i = 0; i < JOB_MAX_THREADS; i++) {
+    world->_queued[i] = ecs_commands_new(world);
+  }
+  world->_queue_order = array_new(sizeof(queued_command), 0);
+  world->_change_tick = 1;
+  world->_rand_state = rand_bits();
+  for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
+    // round up so every packed component stays aligned
+    size_t align = _Alignof(ecs_component);
+    size_t size = (component_sizes[i] + align - 1) / align * align;
+    world->component_store[i] = array_new(size, capacity.components[i]);
+    world->_store_stats[i] =
+      (pool_stats){ .slabs = capacity.components[i] > 0 };
+  }
+  for (int i = 0; i < NUM_ENTITY_TAGS; i++) {
+    world->_tag_sets[i] = array_new(sizeof(ecs_entity*), capacity.entities);
+  }
+  for (int i = 0; i < NUM_ENTITY_TEAMS; i++) {
+    world->_team_sets[i] = array_new(sizeof(ecs_entity*), capacity.entities);
+  }
+  weapon_system_init(world);
+  scenery_system_init(world);
+  collision_system_init(world);
+  spatial_system_init(world);
+  // what a system writes includes whatever the handlers it calls may do
+  ecs_add_system(world, health_system_fn,
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION,
+      ECS_SIGNATURE(ECS_COMPONENT_HEALTH) | ECS_ACCESS_PARTICLES |
+      ECS_ACCESS_RANDOM | ECS_ACCESS_STRUCTURE);
+  ecs_add_system(world, timer_system_fn, 0,
+      ECS_SIGNATURE(ECS_COMPONENT_TIMER) | ECS_ACCESS_STRUCTURE);
+  // the spatial index is built before anything moves, sharing a stage
+  // with the behavior system. it lists what health and timers spawned
+  ecs_add_system(world, spatial_system_fn, ECS_ACCESS_POSITION,
+      ECS_ACCESS_SPATIAL);
+  ecs_add_system(world, behavior_system_fn, ECS_ACCESS_POSITION,
+      ECS_SIGNATURE(ECS_COMPONENT_BEHAVIOR) |
+      ECS_SIGNATURE(ECS_COMPONENT_PROPULSION) |
+      ECS_SIGNATURE(ECS_COMPONENT_BODY));
+  ecs_add_system(world, weapon_system_fn,
+      ECS_ACCESS_POSITION | ECS_ACCESS_SPATIAL,
+      ECS_SIGNATURE(ECS_COMPONENT_BEHAVIOR) | ECS_ACCESS_SOUND |
+      ECS_ACCESS_STRUCTURE);
+  ecs_add_system(world, propulsion_system_fn,
+      ECS_SIGNATURE(ECS_COMPONENT_PROPULSION),
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION |
+      ECS_ACCESS_PARTICLES | ECS_ACCESS_RANDOM);
+  ecs_add_system(world, body_system_fn, 0,
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION);
+  ecs_add_system(world, bounds_system_fn,
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) |
+      ECS_SIGNATURE(ECS_COMPONENT_COLLIDER) | ECS_ACCESS_POSITION,
+      ECS_ACCESS_BOUNDS | ECS_ACCESS_STRUCTURE);
+  ecs_add_system(world, collision_system_fn, 0,
+      ECS_SIGNATURE(ECS_COMPONENT_COLLIDER) |
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION |
+      ECS_ACCESS_BOUNDS | ECS_ACCESS_PARTICLES | ECS_ACCESS_RANDOM |
+      ECS_ACCESS_STRUCTURE);
+  ecs_add_system(world, scenery_system_fn, 0,
+      ECS_ACCESS_RANDOM | ECS_ACCESS_STRUCTURE);
+  return world;
+}
+
+ecs_entity* ecs_entity_new(ecs_world *world, vector position,
+    ecs_entity_tag tag)
+{
+  assert(!ecs_must_queue(world));
+  ecs_entity *entity = pool_alloc(world->_entity_pool);
+  entity->world = world;
   entity->position = position;
-  entity->_node = list_push(ecs_entities, entity); // push onto entity list
+  entity->_node = list_push(world->entities, entity); // push onto entity list
   entity->tag = tag;
+  entity->team = TEAM_NEUTRAL;
+  entity->_tag_index = set_insert(world->_tag_sets[(int)tag], entity);
+  entity->_team_index =
+    set_insert(world->_team_sets[(int)TEAM_NEUTRAL], entity);
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    entity->_query_rows[i] = -1; // matches no query until it has components
+  }
+  // claim a slot in the entity table, reusing a freed one if possible
+  int idx = world->_free_slot;
+  entity_slot *slot;
+  if (idx >= 0) {
+    slot = array_get(world->_slots, idx);
+    world->_free_slot = slot->next_free;
+  }
+  else {
+    idx = world->_slots->length;
+    slot = array_push(world->_slots);
+    slot->generation = 1;
+    array_push(world->_bounds);
+  }
+  slot->entity = entity;
+  entity->handle = ((ecs_handle)slot->generation << 32) | (uint32_t)idx;
+  ecs_refresh_bounds(entity);
   return entity;
 }
 
+void ecs_update_bounds(ecs_world *world) {
+  int count = world->_slots->length;
+  for (int i = 0; i < count; i++) {
+    entity_slot *slot = array_get(world->_slots, i);
+    if (slot->entity != NULL) {
+      *(ecs_bounds*)array_get(world->_bounds, i) =
+        compute_bounds(slot->entity);
+    }
+  }
+}
+
+void ecs_refresh_bounds(ecs_entity *entity) {
+  *ecs_entity_bounds(entity) = compute_bounds(entity);
+}
+
+ecs_bounds* ecs_entity_bounds(ecs_entity *entity) {
+  int idx = entity->handle & HANDLE_INDEX_MASK;
+  return array_get(entity->world->_bounds, idx);
+}
+
+static ecs_bounds compute_bounds(ecs_entity *entity) {
+  ecs_bounds bounds;
+  sprite *s = entity->sprite;
+  bounds.extent = (s == NULL) ? aabb_around(entity->position, 0, 0) :
+    aabb_around(entity->position, s->frame_width * s->scale.x,
+        s->frame_height * s->scale.y);
+  ecs_component *collider = entity->components[ECS_COMPONENT_COLLIDER];
+  bounds.hit = (collider == NULL) ? bounds.extent :
+    aabb_around(entity->position, collider->collider.rect.w,
+        collider->collider.rect.h);
+  return bounds;
+}
+
 void ecs_entity_free(ecs_entity *entity) {
+  ecs_world *world = entity->world;
+  if (ecs_must_queue(world)) {
+    // not marked destroyed: other jobs may read the mark, and whether they
+    // saw it would depend on which job ran first
+    queue_command(world, entity, ECS_COMMAND_DESTROY);
+  }
+  else if (world->_defer_depth > 0) {
+    ecs_commands_destroy(world->_deferred, entity);
+  }
+  else {
+    destroy_entity(entity);
+  }
+}
+
+static void destroy_entity(ecs_entity *entity) {
+  ecs_world *world = entity->world;
   ecs_remove_sprite(entity);
   for (ecs_component_type i = 0; i < NUM_COMPONENT_TYPES; i++) {
-    ecs_remove_component(entity, i);
+    remove_component_now(entity, i);
   }
-  list_remove(ecs_entities, entity->_node, free);
+  // release slot, bumping its generation to invalidate outstanding handles
+  int idx = entity->handle & HANDLE_INDEX_MASK;
+  entity_slot *slot = array_get(world->_slots, idx);
+  slot->entity = NULL;
+  if (++slot->generation == 0) { slot->generation = 1; }
+  slot->next_free = world->_free_slot;
+  world->_free_slot = idx;
+  ecs_entity *moved = set_erase(world->_tag_sets[(int)entity->tag],
+      entity->_tag_index);
+  if (moved) { moved->_tag_index = entity->_tag_index; }
+  moved = set_erase(world->_team_sets[(int)entity->team],
+      entity->_team_index);
+  if (moved) { moved->_team_index = entity->_team_index; }
+  list_remove(world->entities, entity->_node, NULL);
+  pool_release(world->_entity_pool, entity);
+}
+
+ecs_entity* ecs_entity_get(ecs_world *world, ecs_handle handle) {
+  uint32_t idx = handle & HANDLE_INDEX_MASK;
+  if (idx >= (uint32_t)world->_slots->length) { return NULL; }
+  entity_slot *slot = array_get(world->_slots, idx);
+  return (slot->generation == handle >> 32) ? slot->entity : NULL;
 }
 
 ecs_component* ecs_add_component(ecs_entity *entity, ecs_component_type type) {
   assert(entity != NULL);
-  ecs_remove_component(entity, type); // remove previous component if it had one
-  ecs_component *comp = calloc(1, sizeof(ecs_component));
+  ecs_world *world = entity->world;
+  assert(!ecs_must_queue(world));
+  array *store = world->component_store[(int)type];
+  ecs_component *comp = entity->components[(int)type];
+  if (comp != NULL) { // replace previous component in place
+    if (comp->on_destroy != NULL) { comp->on_destroy(comp); }
+    memset(comp, 0, store->elem_size);
+    if (world->_defer_depth > 0) { // must survive a pending removal
+      array *cmds = world->_deferred->_commands;
+      for (int i = 0; i < cmds->length; i++) {
+        ecs_command *cmd = array_get(cmds, i);
+        if (cmd->type == ECS_COMMAND_REMOVE_COMPONENT &&
+            cmd->entity == entity->handle && cmd->component.type == type)
+        {
+          cmd->type = ECS_COMMAND_NONE;
+        }
+      }
+    }
+  }
+  else {
+    char *old_data = store->data;
+    comp = array_push(store); // zeroed slot at end of store
+    pool_stats *stats = &world->_store_stats[(int)type];
+    if (store->data != old_data) { // store grew and moved, fix back-references
+      ++stats->slabs;
+      relink_store(world, type);
+    }
+    if (store->length > stats->peak) { stats->peak = store->length; }
+  }
   comp->type = type;           // tag entity type
   comp->owner_entity = entity; // point component back to owner
+  ecs_mark_changed(comp);      // new components count as changed
   // place component in entity's component slot for that type
   entity->components[(int)type] = comp;
-  // place component in global store, give it a pointer to its node
-  list_push(ecs_component_store[(int)type], comp);
-  // mark as active
-  comp->active = true;
+  if (!(entity->signature & ECS_SIGNATURE(type))) { // new type may complete
+    entity->signature |= ECS_SIGNATURE(type);       // some query signatures
+    for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+      ecs_query *q = world->_queries[i];
+      if (q && (q->signature & ECS_SIGNATURE(type)) &&
+          (entity->signature & q->signature) == q->signature)
+      {
+        query_insert(q, entity);
+      }
+    }
+  }
   return comp;
 }
 
+ecs_component* ecs_add_component_copy(ecs_entity *entity,
+    const ecs_component *src)
+{
+  ecs_component *comp = ecs_add_component(entity, src->type);
+  comp->on_destroy = src->on_destroy;
+  memcpy((char*)comp + COMPONENT_DATA_OFFSET,
+      (const char*)src + COMPONENT_DATA_OFFSET,
+      component_sizes[(int)src->type] - COMPONENT_DATA_OFFSET);
+  return comp;
+}
+
+void ecs_reserve(ecs_world *world, ecs_signature signature, int count) {
+  array_reserve(world->_slots, world->_slots->length + count);
+  array_reserve(world->_bounds, world->_slots->length + count);
+  for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
+    array *store = world->component_store[i];
+    if ((signature & ECS_SIGNATURE(i)) &&
+        array_reserve(store, store->length + count))
+    { // store moved, fix back-references
+      ++world->_store_stats[i].slabs;
+      relink_store(world, i);
+    }
+  }
+}
+
 void ecs_remove_component(ecs_entity *entity, ecs_component_type type) {
   assert(entity != NULL);
+  ecs_world *world = entity->world;
+  assert(!ecs_must_queue(world));
+  if (world->_defer_depth > 0) {
+    ecs_commands_remove_component(world->_deferred, entity, type);
+  }
+  else {
+    remove_component_now(entity, type);
+  }
+}
+
+static void remove_component_now(ecs_entity *entity, ecs_component_type type) {
+  ecs_world *world = entity->world;
   // get component of given type from entity
   ecs_component *comp = entity->components[(int)type];
   // if entity did not have a component of this type, do nothing
   if (comp != NULL) {
     // give it a chance to clean up
     if (comp->on_destroy != NULL) { comp->on_destroy(comp); }
-    // mark component as inactive
-    comp->active = false;
+    // drop entity from every query that requires this type
+    for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+      if (entity->_query_rows[i] >= 0 &&
+          (world->_queries[i]->signature & ECS_SIGNATURE(type)))
+      {
+        query_erase(world->_queries[i], entity);
+      }
+    }
     // make sure entity no longer references a component for that type
     entity->components[(int)type] = NULL;
+    entity->signature &= ~ECS_SIGNATURE(type);
+    array *store = world->component_store[(int)type];
+    if (array_swap_remove(store, array_index_of(store, comp))) {
+      // last component moved into the hole, point its owner at new slot
+      set_component(comp->owner_entity, type, comp);
+    }
+  }
+}
+
+static void relink_store(ecs_world *world, ecs_component_type type) {
+  array *store = world->component_store[(int)type];
+  for (int i = 0; i < store->length; i++) {
+    ecs_component *comp = array_get(store, i);
+    if (comp->owner_entity == NULL) { continue; } // just pushed, not yet owned
+    set_component(comp->owner_entity, type, comp);
+  }
+}
+
+static void set_component(ecs_entity *entity, ecs_component_type type,
+    ecs_component *comp)
+{
+  ecs_query **queries = entity->world->_queries;
+  entity->components[(int)type] = comp;
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    int row_idx = entity->_query_rows[i];
+    int col = row_idx >= 0 ? queries[i]->_columns[(int)type] : -1;
+    if (col >= 0) {
+      ecs_query_row *row = array_get(queries[i]->_rows, row_idx);
+      row->components[col] = comp;
+    }
+  }
+}
+
+ecs_query* ecs_query_new(ecs_world *world, ecs_signature signature) {
+  ecs_query **queries = world->_queries;
+  int id = 0;
+  while (id < ECS_MAX_QUERIES && queries[id] != NULL) { ++id; }
+  assert(id < ECS_MAX_QUERIES && "too many queries, raise ECS_MAX_QUERIES");
+  ecs_query *query = malloc(sizeof(ecs_query));
+  query->signature = signature;
+  query->_id = id;
+  query->_world = world;
+  int num_columns = 0;
+  for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
+    query->_columns[i] = (signature & ECS_SIGNATURE(i)) ? num_columns++ : -1;
+  }
+  query->_rows = array_new(
+      sizeof(ecs_query_row) + num_columns * sizeof(ecs_component*),
+      world->_entity_capacity);
+  queries[id] = query;
+  // pick up entities that already match
+  for (list_node *node = world->entities->head; node; node = node->next) {
+    ecs_entity *entity = node->value;
+    if ((entity->signature & signature) == signature) {
+      query_insert(query, entity);
+    }
+  }
+  return query;
+}
+
+ecs_query* ecs_query_find(ecs_world *world, ecs_signature signature) {
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    ecs_query *query = world->_queries[i];
+    if (query != NULL && query->signature == signature) { return query; }
+  }
+  return ecs_query_new(world, signature);
+}
+
+void ecs_query_free(ecs_query *query) {
+  for (int i = 0; i < query->_rows->length; i++) {
+    ecs_query_row *row = array_get(query->_rows, i);
+    row->entity->_query_rows[query->_id] = -1;
+  }
+  query->_world->_queries[query->_id] = NULL;
+  array_free(query->_rows);
+  free(query);
+}
+
+int ecs_query_count(ecs_query *query) {
+  return query->_rows->length;
+}
+
+ecs_query_row* ecs_query_get(ecs_query *query, int idx) {
+  return array_get(query->_rows, idx);
+}
+
+int ecs_query_column(ecs_query *query, ecs_component_type type) {
+  assert(query->_columns[(int)type] >= 0 && "type not in query signature");
+  return query->_columns[(int)type];
+}
+
+static void query_insert(ecs_query *query, ecs_entity *entity) {
+  assert(entity->_query_rows[query->_id] < 0);
+  entity->_query_rows[query->_id] = query->_rows->length;
+  ecs_query_row *row = array_push(query->_rows);
+  row->entity = entity;
+  for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
+    if (query->_columns[i] >= 0) {
+      row->components[query->_columns[i]] = entity->components[i];
+    }
+  }
+}
+
+static void query_erase(ecs_query *query, ecs_entity *entity) {
+  int idx = entity->_query_rows[query->_id];
+  entity->_query_rows[query->_id] = -1;
+  if (array_swap_remove(query->_rows, idx)) {
+    // last row moved into the hole, tell its entity where it went
+    ecs_query_row *row = array_get(query->_rows, idx);
+    row->entity->_query_rows[query->_id] = idx;
+  }
+}
+
+ecs_component* ecs_write_component(ecs_entity *entity,
+    ecs_component_type type)
+{
+  ecs_component *comp = entity->components[(int)type];
+  if (comp != NULL) { ecs_mark_changed(comp); }
+  return comp;
+}
+
+void ecs_mark_changed(ecs_component *comp) {
+  comp->_changed = comp->owner_entity->world->_change_tick;
+}
+
+uint32_t ecs_change_tick(ecs_world *world) {
+  return world->_change_tick++;
+}
+
+bool ecs_changed_since(ecs_component *comp, uint32_t since) {
+  return comp->_changed > since;
+}
+
+uint32_t ecs_system_since(ecs_world *world) {
+  if (!world->_updating) { return 0; }
+  // run_stage tags the jobs of each system with its index
+  return ((ecs_system_entry*)array_get(world->systems, job_tag()))->_since;
+}
+
+void ecs_defer_begin(ecs_world *world) {
+  ++world->_defer_depth;
+}
+
+void ecs_defer_end(ecs_world *world) {
+  assert(world->_defer_depth > 0);
+  if (--world->_defer_depth == 0) {
+    ecs_commands_playback(world->_deferred);
+    play_queued(world);
+  }
+}
+
+bool ecs_must_queue(ecs_world *world) {
+  return world->_updating &&
+    (updating_world != world || job_depth() != update_depth);
+}
+
+static ecs_command* queue_command(ecs_world *world, ecs_entity *source,
+    ecs_command_type type)
+{
+  ecs_command *cmd =
+    array_push(world->_queued[job_thread_index()]->_commands);
+  cmd->type = type;
+  cmd->entity = source ? source->handle : ECS_NULL_HANDLE;
+  // run_stage tags each system, so the system and the range it is in name
+  // the job the same way whichever thread runs it
+  cmd->tag = job_tag();
+  cmd->range = job_range_begin();
+  return cmd;
+}
+
+void ecs_emit_particles(ecs_entity *source, particle_generator *gen,
+    double time, double density, vector source_velocity)
+{
+  ecs_world *world = source->world;
+  int count = particle_spawn_count(gen, time, density);
+  if (count == 0) { return; }
+  if (ecs_must_queue(world)) {
+    ecs_command *cmd = queue_command(world, source, ECS_COMMAND_PARTICLES);
+    cmd->particles.generator = *gen;
+    cmd->particles.count = count;
+    cmd->particles.velocity = source_velocity;
+  }
+  else {
+    emit_particles(world->particles, gen, count, source_velocity);
+  }
+}
+
+void ecs_play_sound(ecs_world *world, ecs_entity *source, const char *name) {
+  if (ecs_must_queue(world)) {
+    queue_command(world, source, ECS_COMMAND_SOUND)->sound = name;
+  }
+  else {
+    al_game_play_sound(name, false); // false: dont loop
+  }
+}
+
+void ecs_call_synced(ecs_world *world, ecs_entity *source, ecs_synced_fn fn,
+    const void *args, size_t size)
+{
+  assert(size <= ECS_MAX_CALL_ARGS);
+  if (ecs_must_queue(world)) {
+    ecs_command *cmd = queue_command(world, source, ECS_COMMAND_CALL);
+    cmd->call.fn = fn;
+    memcpy(cmd->call.args, args, size);
+  }
+  else {
+    fn(world, args);
+  }
+}
+
+static int compare_queued(const void *p1, const void *p2) {
+  const queued_command *q1 = p1, *q2 = p2;
+  if (q1->source != q2->source) { return q1->source < q2->source ? -1 : 1; }
+  if (q1->tag != q2->tag) { return q1->tag - q2->tag; }
+  if (q1->range != q2->range) { return q1->range - q2->range; }
+  // a job runs on one thread, so this only orders ranges of nested loops
+  if (q1->thread != q2->thread) { return q1->thread - q2->thread; }
+  return q1->index - q2->index;
+}
+
+static void play_queued(ecs_world *world) {
+  array *order = world->_queue_order;
+  array_clear(order);
+  for (int t = 0; t < JOB_MAX_THREADS; t++) {
+    array *cmds = world->_queued[t]->_commands;
+    for (int i = 0; i < cmds->length; i++) {
+      ecs_command *cmd = array_get(cmds, i);
+      ecs_handle source = cmd->entity;
+      *(queued_command*)array_push(order) = (queued_command){
+        .source = source ? (source & HANDLE_INDEX_MASK) + 1 : 0,
+        .tag = cmd->tag, .range = cmd->range, .thread = t, .index = i
+      };
+    }
+  }
+  if (order->length == 0) { return; }
+  // slots, systems and ranges are the same every run, unlike jobs to
+  // threads
+  qsort(order->data, order->length, sizeof(queued_command), compare_queued);
+  for (int i = 0; i < order->length; i++) {
+    queued_command *q = array_get(order, i);
+    apply_command(world, array_get(world->_queued[q->thread]->_commands,
+          q->index));
+  }
+  for (int t = 0; t < JOB_MAX_THREADS; t++) {
+    array_clear(world->_queued[t]->_commands);
+  }
+}
+
+ecs_commands* ecs_commands_new(ecs_world *world) {
+  ecs_commands *cmds = malloc(sizeof(ecs_commands));
+  cmds->_world = world;
+  cmds->_commands = array_new(sizeof(ecs_command), 0);
+  return cmds;
+}
+
+void ecs_commands_free(ecs_commands *cmds) {
+  array_free(cmds->_commands);
+  free(cmds);
+}
+
+void ecs_commands_destroy(ecs_commands *cmds, ecs_entity *entity) {
+  assert(entity->world == cmds->_world);
+  if (entity->destroyed) { return; } // already queued for destruction
+  entity->destroyed = true;
+  ecs_command *cmd = array_push(cmds->_commands);
+  cmd->type = ECS_COMMAND_DESTROY;
+  cmd->entity = entity->handle;
+}
+
+ecs_component* ecs_commands_add_component(ecs_commands *cmds,
+    ecs_entity *entity, ecs_component_type type)
+{
+  ecs_command *cmd = array_push(cmds->_commands);
+  cmd->type = ECS_COMMAND_ADD_COMPONENT;
+  cmd->entity = entity->handle;
+  cmd->component.type = type;
+  cmd->component.owner_entity = entity;
+  return &cmd->component;
+}
+
+void ecs_commands_remove_component(ecs_commands *cmds, ecs_entity *entity,
+    ecs_component_type type)
+{
+  if (entity->components[(int)type] == NULL) { return; } // nothing to remove
+  ecs_command *cmd = array_push(cmds->_commands);
+  cmd->type = ECS_COMMAND_REMOVE_COMPONENT;
+  cmd->entity = entity->handle;
+  cmd->component.type = type;
+}
+
+void ecs_commands_playback(ecs_commands *cmds) {
+  array *commands = cmds->_commands;
+  // changes made while playing back apply immediately, so the buffer does
+  // not grow while it is walked
+  for (int i = 0; i < commands->length; i++) {
+    apply_command(cmds->_world, array_get(commands, i));
+  }
+  array_clear(commands);
+}
+
+static void apply_command(ecs_world *world, ecs_command *cmd) {
+  ecs_entity *entity = ecs_entity_get(world, cmd->entity);
+  switch (cmd->type) {
+    case ECS_COMMAND_DESTROY:
+      if (entity) { destroy_entity(entity); }
+      break;
+    case ECS_COMMAND_ADD_COMPONENT:
+      if (entity) { ecs_add_component_copy(entity, &cmd->component); }
+      break;
+    case ECS_COMMAND_REMOVE_COMPONENT:
+      if (entity) { remove_component_now(entity, cmd->component.type); }
+      break;
+    case ECS_COMMAND_PARTICLES:
+      emit_particles(world->particles, &cmd->particles.generator,
+          cmd->particles.count, cmd->particles.velocity);
+      break;
+    case ECS_COMMAND_SOUND:
+      al_game_play_sound(cmd->sound, false);
+      break;
+    case ECS_COMMAND_CALL:
+      cmd->call.fn(world, cmd->call.args);
+      break;
+    case ECS_COMMAND_NONE:
+      break;
   }
 }
 
 sprite* ecs_attach_sprite(ecs_entity *entity, const char *name, int depth) {
   assert(entity->sprite == NULL); // shouldn't have sprite already
-  sprite* s = sprite_new(name, &(entity->position), &(entity->angle), depth);
+  sprite* s = sprite_new(entity->world->sprites, name, entity->handle,
+      depth);
   entity->sprite = s;
   return s;
 }
@@ -79,13 +759,32 @@ sprite* ecs_attach_animation(ecs_entity *entity, const char *name, int depth,
     int frame_width, int frame_height, double animation_rate, AnimationType
     type)
 {
-  assert(entity->sprite == NULL); // shouldn't have sprite already sprite* s =
-  sprite *s = animation_new(name, &(entity->position), &(entity->angle), depth,
-      frame_width, frame_height, animation_rate, type);
+  assert(entity->sprite == NULL); // shouldn't have sprite already
+  sprite *s = animation_new(entity->world->sprites, name, entity->handle,
+      depth, frame_width, frame_height, animation_rate, type);
   entity->sprite = s;
   return s;
 }
 
+sprite* ecs_attach_sprite_copy(ecs_entity *entity, const sprite *src,
+    int depth)
+{
+  assert(entity->sprite == NULL); // shouldn't have sprite already
+  entity->sprite = sprite_copy(entity->world->sprites, src, entity->handle,
+      depth);
+  return entity->sprite;
+}
+
+static bool locate_entity(void *ctx, uint64_t owner, vector *position,
+    double *angle)
+{
+  ecs_entity *entity = ecs_entity_get(ctx, owner);
+  if (entity == NULL) { return false; }
+  *position = entity->position;
+  *angle = entity->angle;
+  return true;
+}
+
 void ecs_remove_sprite(ecs_entity *entity) {
   if (entity->sprite != NULL) {
     sprite_free(entity->sprite);
@@ -93,28 +792,459 @@ void ecs_remove_sprite(ecs_entity *entity) {
   }
 }
 
-void ecs_update_systems(double time) {
-  list_node *sys_node = ecs_systems->head;
-  while (sys_node != NULL) {  // iterate through every update function
-    ecs_system sys = (ecs_system)sys_node->value;
-    sys(time);  // run the system update function, passing the elapsed time
-    sys_node = sys_node->next;
+void ecs_add_system(ecs_world *world, ecs_system fn, ecs_access reads,
+    ecs_access writes)
+{
+  ecs_system_entry *entry = array_push(world->systems);
+  entry->fn = fn;
+  entry->reads = reads;
+  entry->writes = writes;
+}
+
+// everything creating or destroying an entity may change
+static const ecs_access entity_data =
+  (ECS_SIGNATURE(NUM_COMPONENT_TYPES) - 1) | ECS_ACCESS_POSITION |
+  ECS_ACCESS_BOUNDS | ECS_ACCESS_SPATIAL | ECS_ACCESS_STRUCTURE;
+// what only the thread calling ecs_update_systems may write
+static const ecs_access updating_thread =
+  ECS_ACCESS_RANDOM | ECS_ACCESS_STRUCTURE;
+
+// true if two systems may not run at the same time
+static bool systems_conflict(ecs_system_entry *s1, ecs_system_entry *s2) {
+  ecs_access access1 = s1->reads | s1->writes;
+  ecs_access access2 = s2->reads | s2->writes;
+  if ((s1->writes & updating_thread) && (s2->writes & updating_thread)) {
+    return true;
+  }
+  if (((s1->writes & ECS_ACCESS_STRUCTURE) && (access2 & entity_data)) ||
+      ((s2->writes & ECS_ACCESS_STRUCTURE) && (access1 & entity_data)))
+  {
+    return true;
+  }
+  return (s1->writes & access2) || (s2->writes & s1->reads);
+}
+
+// assign each system the stage it runs in. return the number of stages
+static int schedule_systems(ecs_world *world, int *stages) {
+  array *systems = world->systems;
+  if (world->serial_systems || world->_updates == 0) {
+    for (int i = 0; i < systems->length; i++) { stages[i] = i; }
+    return systems->length;
+  }
+  // a system follows the last earlier system it conflicts with
+  int num_stages = 0;
+  for (int i = 0; i < systems->length; i++) {
+    stages[i] = 0;
+    for (int j = 0; j < i; j++) {
+      if (stages[j] >= stages[i] &&
+          systems_conflict(array_get(systems, i), array_get(systems, j)))
+      {
+        stages[i] = stages[j] + 1;
+      }
+    }
+    if (stages[i] >= num_stages) { num_stages = stages[i] + 1; }
+  }
+  return num_stages;
+}
+
+// a system and its arguments, passed to a job
+typedef struct system_run {
+  ecs_system fn;
+  ecs_world *world;
+  double time;
+} system_run;
+
+static void run_system(void *ctx, int begin, int end) {
+  system_run *run = ctx;
+  run->fn(run->world, run->time);
+}
+
+// run the systems of a stage. the one using the random generator or
+// changing structure, if any, runs on this thread so it draws from the
+// world's generator and may create entities, and the rest run as jobs
+static void run_stage(ecs_world *world, int *stages, int stage, double time) {
+  int count = world->systems->length;
+  int local = -1;
+  for (int i = 0; i < count; i++) {
+    ecs_system_entry *entry = array_get(world->systems, i);
+    if (stages[i] != stage) { continue; }
+    if (local < 0 || (entry->writes & updating_thread)) { local = i; }
+  }
+  if (local < 0) { return; }
+  for (int i = 0; i < count; i++) {
+    ecs_system_entry *entry = array_get(world->systems, i);
+    if (stages[i] != stage) { continue; }
+    // ticks are taken here as the systems of a stage may run at once
+    entry->_since = entry->_last_tick;
+    entry->_last_tick = ecs_change_tick(world);
+  }
+  system_run runs[count];
+  job_wait_group wg = {0};
+  int outer_tag = job_tag();
+  ecs_defer_begin(world);
+  for (int i = 0; i < count; i++) {
+    ecs_system_entry *entry = array_get(world->systems, i);
+    if (stages[i] != stage || i == local) { continue; }
+    runs[i] = (system_run){ .fn = entry->fn, .world = world, .time = time };
+    job_set_tag(i); // changes the system queues are ordered by its index
+    job_submit(&wg, run_system, &runs[i], 0, 1);
+  }
+  job_set_tag(local);
+  ((ecs_system_entry*)array_get(world->systems, local))->fn(world, time);
+  job_wait(&wg);
+  job_set_tag(outer_tag);
+  ecs_defer_end(world); // sync point: apply destruction requested by stage
+}
+
+void ecs_update_systems(ecs_world *world, double time) {
+  // draw from the world's own generator, so the result of an update does
+  // not depend on which thread runs it or on other worlds
+  uint64_t outer_rand_state = rand_get_state();
+  rand_set_state(world->_rand_state);
+  ecs_world *outer_world = updating_world;
+  int outer_depth = update_depth;
+  updating_world = world;
+  update_depth = job_depth();
+  world->_updating = true;
+  int count = world->systems->length;
+  int stages[count > 0 ? count : 1];
+  int num_stages = schedule_systems(world, stages);
+  for (int stage = 0; stage < num_stages; stage++) {
+    run_stage(world, stages, stage, time);
   }
+  world->_updating = false;
+  updating_world = outer_world;
+  update_depth = outer_depth;
+  update_particles(world->particles, time);
+  ++world->_updates;
+  world->_rand_state = rand_get_state();
+  rand_set_state(outer_rand_state);
 }
 
-void ecs_free_all_entities() {
-  // free every entity without destroying the list
-  list_clear(ecs_entities, (list_lambda)ecs_entity_free);
+// worlds and the time to step them by, shared by the jobs
+typedef struct world_step {
+  ecs_world **worlds;
+  double time;
+} world_step;
+
+static void step_worlds(void *ctx, int begin, int end) {
+  world_step *step = ctx;
+  for (int i = begin; i < end; i++) {
+    ecs_update_systems(step->worlds[i], step->time);
+  }
+}
+
+void ecs_update_worlds(ecs_world **worlds, int count, double time) {
+  world_step step = { .worlds = worlds, .time = time };
+  job_parallel_for(count, 1, step_worlds, &step);
+}
+
+void ecs_free_all_entities(ecs_world *world) {
+  // free every entity without destroying the list. use list each instead of
+  // list clear - ecs_entity_free handles removal of entity from list
+  list_each(world->entities, (list_lambda)ecs_entity_free);
+}
+
+pool_stats ecs_entity_stats(ecs_world *world) {
+  return world->_entity_pool->stats;
+}
+
+pool_stats ecs_component_stats(ecs_world *world, ecs_component_type type) {
+  pool_stats stats = world->_store_stats[(int)type];
+  stats.live = world->component_store[(int)type]->length;
+  return stats;
+}
+
+void ecs_set_team(ecs_entity *entity, ecs_entity_team team) {
+  if (team == entity->team) { return; }
+  array **team_sets = entity->world->_team_sets;
+  ecs_entity *moved = set_erase(team_sets[(int)entity->team],
+      entity->_team_index);
+  if (moved) { moved->_team_index = entity->_team_index; }
+  entity->team = team;
+  entity->_team_index = set_insert(team_sets[(int)team], entity);
+}
+
+int ecs_tag_count(ecs_world *world, ecs_entity_tag tag) {
+  return world->_tag_sets[(int)tag]->length;
+}
+
+ecs_entity* ecs_tag_get(ecs_world *world, ecs_entity_tag tag, int idx) {
+  return *(ecs_entity**)array_get(world->_tag_sets[(int)tag], idx);
+}
+
+int ecs_team_count(ecs_world *world, ecs_entity_team team) {
+  return world->_team_sets[(int)team]->length;
+}
+
+ecs_entity* ecs_team_get(ecs_world *world, ecs_entity_team team, int idx) {
+  return *(ecs_entity**)array_get(world->_team_sets[(int)team], idx);
+}
+
+static int set_insert(array *set, ecs_entity *entity) {
+  *(ecs_entity**)array_push(set) = entity;
+  return set->length - 1;
+}
+
+static ecs_entity* set_erase(array *set, int idx) {
+  if (!array_swap_remove(set, idx)) { return NULL; } // removed last element
+  return *(ecs_entity**)array_get(set, idx);
 }
 
 bool ecs_same_team(ecs_entity *e1, ecs_entity *e2) {
   return (e1->team & e2->team);
 }
 
-void ecs_shutdown() {
-  list_free(ecs_systems, NULL);
+// index in the entity table of an entity
+static uint32_t slot_of(ecs_entity *entity) {
+  return entity->handle & HANDLE_INDEX_MASK;
+}
+
+// entity occupying a slot while loading
+static ecs_entity* entity_at(ecs_world *world, uint32_t idx) {
+  return ((entity_slot*)array_get(world->_slots, idx))->entity;
+}
+
+// save the order of the entities in a tag or team set
+static void save_set(snapshot *snap, array *set) {
+  snapshot_write(snap, &set->length, sizeof(set->length));
+  for (int i = 0; i < set->length; i++) {
+    uint32_t idx = slot_of(*(ecs_entity**)array_get(set, i));
+    snapshot_write(snap, &idx, sizeof(idx));
+  }
+}
+
+// rebuild a tag or team set in its saved order
+static void load_set(ecs_world *world, snapshot *snap, array *set) {
+  int count;
+  snapshot_read(snap, &count, sizeof(count));
+  array_clear(set);
+  for (int i = 0; i < count; i++) {
+    uint32_t idx;
+    snapshot_read(snap, &idx, sizeof(idx));
+    set_insert(set, entity_at(world, idx));
+  }
+}
+
+void ecs_save(ecs_world *world, snapshot *snap) {
+  assert(world->_defer_depth == 0); // pending commands are not captured
+  array *slots = world->_slots;
+  list *entities = world->entities;
+  // entity table, so restored entities keep their handles
+  snapshot_write(snap, &world->_free_slot, sizeof(world->_free_slot));
+  snapshot_write(snap, &slots->length, sizeof(slots->length));
+  for (int i = 0; i < slots->length; i++) {
+    entity_slot *slot = array_get(slots, i);
+    snapshot_write(snap, &slot->generation, sizeof(slot->generation));
+    snapshot_write(snap, &slot->next_free, sizeof(slot->next_free));
+  }
+  // entities from the list tail, so pushing them back on load restores the
+  // list order. each is followed by its sprite if it has one
+  snapshot_write(snap, &entities->length, sizeof(entities->length));
+  for (list_node *node = entities->tail; node != NULL; node = node->prev) {
+    ecs_entity *entity = node->value;
+    uint32_t idx = slot_of(entity);
+    bool has_sprite = entity->sprite != NULL;
+    snapshot_write(snap, &idx, sizeof(idx));
+    snapshot_write(snap, &entity->tag, sizeof(entity->tag));
+    snapshot_write(snap, &entity->team, sizeof(entity->team));
+    snapshot_write(snap, &entity->position, sizeof(entity->position));
+    snapshot_write(snap, &entity->angle, sizeof(entity->angle));
+    snapshot_write(snap, &has_sprite, sizeof(has_sprite));
+    if (has_sprite) { // the owner's handle is restored with its slot
+      sprite s = *entity->sprite;
+      s._node = NULL;
+      s._layers = NULL;
+      snapshot_write(snap, &s, sizeof(s));
+    }
+  }
+  // component stores in order, each component preceded by its owner
+  for (int type = 0; type < NUM_COMPONENT_TYPES; type++) {
+    array *store = world->component_store[type];
+    snapshot_write(snap, &store->length, sizeof(store->length));
+    for (int i = 0; i < store->length; i++) {
+      // the owner's address and the change tick are not restored, so keep
+      // them out of the snapshot
+      ecs_component comp;
+      memcpy(&comp, array_get(store, i), store->elem_size);
+      uint32_t idx = slot_of(comp.owner_entity);
+      comp.owner_entity = NULL;
+      comp._changed = 0;
+      snapshot_write(snap, &idx, sizeof(idx));
+      snapshot_write(snap, &comp, store->elem_size);
+    }
+  }
+  for (int i = 0; i < NUM_ENTITY_TAGS; i++) {
+    save_set(snap, world->_tag_sets[i]);
+  }
+  for (int i = 0; i < NUM_ENTITY_TEAMS; i++) {
+    save_set(snap, world->_team_sets[i]);
+  }
+  // query row order, which decides the order systems visit entities in
+  ecs_query **queries = world->_queries;
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    ecs_signature signature = queries[i] ? queries[i]->signature : 0;
+    snapshot_write(snap, &signature, sizeof(signature));
+    if (queries[i] != NULL) {
+      array *rows = queries[i]->_rows;
+      snapshot_write(snap, &rows->length, sizeof(rows->length));
+      for (int j = 0; j < rows->length; j++) {
+        uint32_t idx = slot_of(((ecs_query_row*)array_get(rows, j))->entity);
+        snapshot_write(snap, &idx, sizeof(idx));
+      }
+    }
+  }
+}
+
+void ecs_load(ecs_world *world, snapshot *snap) {
+  assert(world->_defer_depth == 0);
+  array *slots = world->_slots;
+  list *entities = world->entities;
+  // drop the current world. components are overwritten rather than
+  // destroyed, so on_destroy is not called
+  for (list_node *node = entities->head; node != NULL; node = node->next) {
+    ecs_entity *entity = node->value;
+    ecs_remove_sprite(entity);
+    pool_release(world->_entity_pool, entity);
+  }
+  list_clear(entities, NULL);
+  // entity table
+  snapshot_read(snap, &world->_free_slot, sizeof(world->_free_slot));
+  int num_slots;
+  snapshot_read(snap, &num_slots, sizeof(num_slots));
+  array_clear(slots);
+  array_reserve(slots, num_slots);
+  array_clear(world->_bounds);
+  array_reserve(world->_bounds, num_slots);
+  for (int i = 0; i < num_slots; i++) {
+    entity_slot *slot = array_push(slots);
+    slot->entity = NULL;
+    snapshot_read(snap, &slot->generation, sizeof(slot->generation));
+    snapshot_read(snap, &slot->next_free, sizeof(slot->next_free));
+    array_push(world->_bounds); // filled in once components are loaded
+  }
+  // entities
+  int num_entities;
+  snapshot_read(snap, &num_entities, sizeof(num_entities));
+  for (int i = 0; i < num_entities; i++) {
+    ecs_entity *entity = pool_alloc(world->_entity_pool);
+    memset(entity, 0, sizeof(ecs_entity));
+    entity->world = world;
+    uint32_t idx;
+    bool has_sprite;
+    snapshot_read(snap, &idx, sizeof(idx));
+    snapshot_read(snap, &entity->tag, sizeof(entity->tag));
+    snapshot_read(snap, &entity->team, sizeof(entity->team));
+    snapshot_read(snap, &entity->position, sizeof(entity->position));
+    snapshot_read(snap, &entity->angle, sizeof(entity->angle));
+    snapshot_read(snap, &has_sprite, sizeof(has_sprite));
+    if (has_sprite) {
+      sprite s;
+      snapshot_read(snap, &s, sizeof(s));
+      entity->sprite = sprite_copy(world->sprites, &s, s.owner, s._depth);
+    }
+    for (int j = 0; j < ECS_MAX_QUERIES; j++) { entity->_query_rows[j] = -1; }
+    entity_slot *slot = array_get(slots, idx);
+    slot->entity = entity;
+    entity->handle = ((ecs_handle)slot->generation << 32) | idx;
+    entity->_node = list_push(entities, entity);
+  }
+  // components, stamped with the current tick since systems tracking
+  // changes have not seen the restored values
+  for (int type = 0; type < NUM_COMPONENT_TYPES; type++) {
+    array *store = world->component_store[type];
+    pool_stats *stats = &world->_store_stats[type];
+    int count;
+    snapshot_read(snap, &count, sizeof(count));
+    array_clear(store);
+    if (array_reserve(store, count)) { ++stats->slabs; }
+    for (int i = 0; i < count; i++) {
+      uint32_t idx;
+      snapshot_read(snap, &idx, sizeof(idx));
+      ecs_component *comp = array_push(store);
+      snapshot_read(snap, comp, store->elem_size);
+      comp->owner_entity = entity_at(world, idx);
+      comp->owner_entity->components[type] = comp;
+      comp->owner_entity->signature |= ECS_SIGNATURE(type);
+      ecs_mark_changed(comp);
+    }
+    if (store->length > stats->peak) { stats->peak = store->length; }
+  }
+  for (int i = 0; i < NUM_ENTITY_TAGS; i++) {
+    array *set = world->_tag_sets[i];
+    load_set(world, snap, set);
+    for (int j = 0; j < set->length; j++) {
+      (*(ecs_entity**)array_get(set, j))->_tag_index = j;
+    }
+  }
+  for (int i = 0; i < NUM_ENTITY_TEAMS; i++) {
+    array *set = world->_team_sets[i];
+    load_set(world, snap, set);
+    for (int j = 0; j < set->length; j++) {
+      (*(ecs_entity**)array_get(set, j))->_team_index = j;
+    }
+  }
+  // query rows in their saved order. queries created since the snapshot
+  // was taken are filled in entity order instead
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    ecs_signature signature;
+    snapshot_read(snap, &signature, sizeof(signature));
+    int count = 0;
+    if (signature != 0) { snapshot_read(snap, &count, sizeof(count)); }
+    ecs_query *query = world->_queries[i];
+    bool same = query != NULL && query->signature == signature;
+    if (query != NULL) { array_clear(query->_rows); }
+    for (int j = 0; j < count; j++) {
+      uint32_t idx;
+      snapshot_read(snap, &idx, sizeof(idx));
+      if (same) { query_insert(query, entity_at(world, idx)); }
+    }
+    if (query != NULL && !same) {
+      for (list_node *node = entities->head; node; node = node->next) {
+        ecs_entity *entity = node->value;
+        if ((entity->signature & query->signature) == query->signature) {
+          query_insert(query, entity);
+        }
+      }
+    }
+  }
+  ecs_update_bounds(world);
+  // the spatial index listed the entities the load replaced
+  spatial_system_fn(world, 0);
+}
+
+void ecs_world_free(ecs_world *world) {
+  array_free(world->systems);
   // use list each instead of list_free - ecs_entity_free handles removal of
   // entity from list
-  list_each(ecs_entities, (list_lambda)ecs_entity_free);
-  free(ecs_entities);
+  list_each(world->entities, (list_lambda)ecs_entity_free);
+  free(world->entities);
+  pool_free(world->_entity_node_pool);
+  for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
+    array_free(world->component_store[i]);
+  }
+  array_free(world->_slots);
+  array_free(world->_bounds);
+  pool_free(world->_entity_pool);
+  ecs_commands_free(world->_deferred);
+  for (int i = 0; i < JOB_MAX_THREADS; i++) {
+    ecs_commands_free(world->_queued[i]);
+  }
+  array_free(world->_queue_order);
+  for (int i = 0; i < ECS_MAX_QUERIES; i++) {
+    if (world->_queries[i] != NULL) { ecs_query_free(world->_queries[i]); }
+  }
+  for (int i = 0; i < NUM_ENTITY_TAGS; i++) {
+    array_free(world->_tag_sets[i]);
+  }
+  for (int i = 0; i < NUM_ENTITY_TEAMS; i++) {
+    array_free(world->_team_sets[i]);
+  }
+  weapon_system_shutdown(world);
+  scenery_system_shutdown(world);
+  collision_system_shutdown(world);
+  spatial_system_shutdown(world);
+  sprite_layers_free(world->sprites);
+  particle_system_free(world->particles);
+  free(world);
 }
@@ -6,15 +6,16 @@ static const double max_fire_time = 9;
 static void fire_at_player(ecs_entity *enemy) {
   ecs_component *behavior_comp = enemy->components[ECS_COMPONENT_BEHAVIOR];
   assert(behavior_comp);
-  ecs_entity *player = behavior_comp->behavior.target;
-  weapon_fire_enemy(enemy, player);
+  ecs_entity *player = ecs_entity_get(enemy->world,
+      behavior_comp->behavior.target);
+  if (player) { weapon_fire_enemy(enemy, player); }
   // reset fire timer
   Timer *timer = &enemy->components[ECS_COMPONENT_TIMER]->timer;
   timer->time_left = randd(min_fire_time, max_fire_time);
 }
 
 static void asplode_enemy(ecs_entity *enemy) {
-  scenery_make_explosion(enemy->position, (vector){6,4}, 40,
+  scenery_make_explosion(enemy->world, enemy->position, (vector){6,4}, 40,
       al_map_rgb(255,160,160), "explosion1"); 
   ecs_entity_free(enemy);
 }
@@ -29,79 +30,115 @@ static void start_crashing(ecs_entity *enemy) {
   timer->timer_action = asplode_enemy;
 }
 
-void spawn_enemy(EnemySpawnData data) {
-  ecs_entity *enemy = ecs_entity_new(data.start, ENTITY_SHIP);
+static void mine_collide(ecs_entity *mine, ecs_entity *player) {
+  deal_damage(player, 10);
+  asplode_enemy(mine);
+}
+
+// blueprint shared by every enemy ship, built on first spawn
+static prefab* enemy_prefab() {
+  static prefab *p;
+  if (p != NULL) { return p; }
+  p = prefab_new("enemy1", ENTITY_SHIP);
+  p->team = TEAM_ENEMY;
   // sprite
-  ecs_attach_animation(enemy, "enemy1", 1, 64, 24, 6, ANIMATE_LOOP);
+  prefab_set_animation(p, "enemy1", 1, 64, 24, 6, ANIMATE_LOOP);
   // body
-  Body *bod = &ecs_add_component(enemy, ECS_COMPONENT_BODY)->body;
+  Body *bod = &prefab_add_component(p, ECS_COMPONENT_BODY)->body;
   bod->max_linear_velocity = 200;
   bod->mass = 10;
   // collider
-  Collider *col = &ecs_add_component(enemy, ECS_COMPONENT_COLLIDER)->collider;
-  col->rect = hitrect_from_sprite(enemy->sprite);
+  Collider *col = &prefab_add_component(p, ECS_COMPONENT_COLLIDER)->collider;
+  col->rect = hitrect_from_sprite(&p->sprite);
   col->elastic_collision = true;
   col->collide_particle_effect = get_particle_generator("sparks");
+  col->category = COLLIDE_ENEMY;
+  col->mask = COLLIDE_PLAYER; // bounce off the player
   // mouse listener
   MouseListener *listener =
-    &ecs_add_component(enemy, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
-  listener->click_rect = col->rect;
+    &prefab_add_component(p, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
   listener->on_enter = weapon_set_target;
   listener->on_leave = weapon_clear_target;
   // propulsion
-  Propulsion *pro = &ecs_add_component(enemy, ECS_COMPONENT_PROPULSION)->propulsion;
+  Propulsion *pro =
+    &prefab_add_component(p, ECS_COMPONENT_PROPULSION)->propulsion;
   pro->linear_accel = 100;
   pro->turn_rate = 1*PI;
   // behavior
-  Behavior *beh = &ecs_add_component(enemy, ECS_COMPONENT_BEHAVIOR)->behavior;
-  beh->target = data.player;
+  Behavior *beh = &prefab_add_component(p, ECS_COMPONENT_BEHAVIOR)->behavior;
   beh->type = BEHAVIOR_MOVE;
-  beh->location = data.target;
-  enemy->team = TEAM_ENEMY;
-  Timer *timer = &ecs_add_component(enemy, ECS_COMPONENT_TIMER)->timer;
-  timer->time_left = randd(min_fire_time, max_fire_time);
+  // timer
+  Timer *timer = &prefab_add_component(p, ECS_COMPONENT_TIMER)->timer;
   timer->timer_action = fire_at_player;
-  ecs_component *health_comp = ecs_add_component(enemy, ECS_COMPONENT_HEALTH);
+  // health
+  ecs_component *health_comp = prefab_add_component(p, ECS_COMPONENT_HEALTH);
   health_comp->health = make_health(10, start_crashing, "smoke");
+  return p;
 }
 
-static void mine_collide(ecs_entity *mine, ecs_entity *player) {
-  deal_damage(player, 10);
-  asplode_enemy(mine);
-}
-
-ecs_entity* spawn_mine(Direction enter_from, ecs_entity *player) {
-  vector start = {SCREEN_W, 300};
-  ecs_entity *mine = ecs_entity_new((vector)start, ENTITY_SHIP);
+// blueprint shared by every mine, built on first spawn
+static prefab* mine_prefab() {
+  static prefab *p;
+  if (p != NULL) { return p; }
+  p = prefab_new("mine", ENTITY_SHIP);
+  p->team = TEAM_ENEMY;
   // sprite
-  ecs_attach_sprite(mine, "mine", 3);
+  prefab_set_sprite(p, "mine", 3);
   // body
-  Body *bod = &ecs_add_component(mine, ECS_COMPONENT_BODY)->body;
+  Body *bod = &prefab_add_component(p, ECS_COMPONENT_BODY)->body;
   bod->max_linear_velocity = 200;
   bod->mass = 10;
   // collider
-  Collider *col = &ecs_add_component(mine, ECS_COMPONENT_COLLIDER)->collider;
-  col->rect = hitrect_from_sprite(mine->sprite);
+  Collider *col = &prefab_add_component(p, ECS_COMPONENT_COLLIDER)->collider;
+  col->rect = hitrect_from_sprite(&p->sprite);
   col->on_collision = mine_collide;
+  col->category = COLLIDE_HAZARD;
+  col->mask = COLLIDE_ALL; // blow up on anything not on its team
   // mouse listener
   MouseListener *listener =
-    &ecs_add_component(mine, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
-  listener->click_rect = col->rect;
+    &prefab_add_component(p, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
   listener->on_enter = weapon_set_target;
   listener->on_leave = weapon_clear_target;
   // propulsion
-  Propulsion *pro = &ecs_add_component(mine, ECS_COMPONENT_PROPULSION)->propulsion;
+  Propulsion *pro =
+    &prefab_add_component(p, ECS_COMPONENT_PROPULSION)->propulsion;
   pro->linear_accel = 300;
   pro->turn_rate = 1*PI;
   // behavior
-  Behavior *beh = &ecs_add_component(mine, ECS_COMPONENT_BEHAVIOR)->behavior;
-  beh->target = player;
+  Behavior *beh = &prefab_add_component(p, ECS_COMPONENT_BEHAVIOR)->behavior;
   beh->type = BEHAVIOR_FOLLOW;
-  mine->team = TEAM_ENEMY;
-  Timer *timer = &ecs_add_component(mine, ECS_COMPONENT_TIMER)->timer;
+  // timer
+  Timer *timer = &prefab_add_component(p, ECS_COMPONENT_TIMER)->timer;
   timer->time_left = 10;
   timer->timer_action = asplode_enemy;
-  ecs_component *health_comp = ecs_add_component(mine, ECS_COMPONENT_HEALTH);
+  // health
+  ecs_component *health_comp = prefab_add_component(p, ECS_COMPONENT_HEALTH);
   health_comp->health = make_health(10, start_crashing, "smoke");
+  return p;
+}
+
+void spawn_enemies(ecs_world *world, const EnemySpawnData *data, int count) {
+  prefab *p = enemy_prefab();
+  // grow storage once for the whole group
+  ecs_reserve(world, p->signature, count);
+  for (int i = 0; i < count; i++) {
+    ecs_entity *enemy = prefab_spawn(world, p, data[i].start);
+    Behavior *beh = &enemy->components[ECS_COMPONENT_BEHAVIOR]->behavior;
+    beh->target = data[i].player;
+    beh->location = data[i].target;
+    Timer *timer = &enemy->components[ECS_COMPONENT_TIMER]->timer;
+    timer->time_left = randd(min_fire_time, max_fire_time);
+  }
+}
+
+void enemies_preload() {
+  enemy_prefab();
+  mine_prefab();
+}
+
+ecs_entity* spawn_mine(Direction enter_from, ecs_entity *player) {
+  vector start = {SCREEN_W, 300};
+  ecs_entity *mine = prefab_spawn(player->world, mine_prefab(), start);
+  mine->components[ECS_COMPONENT_BEHAVIOR]->behavior.target = player->handle;
   return mine;
 }
@@ -3,8 +3,9 @@
 static void kbd_handler(ecs_entity *e, int keycode, bool down);
 
 /* Functions ******************************************************************/
-ecs_entity* make_player_ship() {
-  ecs_entity *player = ecs_entity_new((vector){.x = 50, .y = 400}, ENTITY_SHIP);
+ecs_entity* make_player_ship(ecs_world *world) {
+  ecs_entity *player = ecs_entity_new(world, (vector){.x = 50, .y = 400},
+      ENTITY_SHIP);
   ecs_attach_animation(player, "viper", 2, 64, 64, 8, ANIMATE_LOOP);
   // keyboard input listener component
   ecs_component *k = ecs_add_component(player, ECS_COMPONENT_KEYBOARD_LISTENER);
@@ -26,7 +27,9 @@ ecs_entity* make_player_ship() {
   col->keep_inside_level = true;
   col->elastic_collision = true;
   col->collide_particle_effect = get_particle_generator("sparks");
-  player->team = TEAM_FRIENDLY;
+  col->category = COLLIDE_PLAYER;
+  col->mask = COLLIDE_ENEMY; // bounce off enemy ships
+  ecs_set_team(player, TEAM_FRIENDLY);
   return player;
 }
 
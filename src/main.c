@@ -1,16 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "al_game.h"
 #include "ecs.h"
 #include "particle_effects.h"
+#include "prefab.h"
 #include "system/keyboard_sys.h"
 #include "system/mouse_sys.h"
 #include "scene/scene.h"
 #include "scene/level.h"
+#include "util/alloc_guard.h"
+#include "util/job.h"
 
 static double last_frame_time; // when the last update occured
 static double elapsed_time;    // time elapsed for current update
+static ecs_world *world;       // world the game is played in
 
 // compute frame time and update all systems. return current fps
 static bool main_update();
@@ -24,9 +29,17 @@ int main(int argc, char *argv[]) {
     exit(-1);
   }
 
+  job_system_init(0); // a worker per processor
   particle_init(al_get_backbuffer(display));
-  ecs_init();                  // set up entity-component-system framework
-  register_scene(level_new()); // set initial scene
+  list_free(load_all_generator_data(), free); // load every particle effect
+  world = ecs_world_new();          // set up entity-component-system world
+  register_scene(level_new(world)); // set initial scene
+
+  // in builds made with `make guard`, count heap allocations made by each
+  // frame. with --strict-alloc, the first one aborts. the first frame is
+  // exempt: systems create their queries on their first update
+  bool strict_alloc = argc > 1 && strcmp(argv[1], "--strict-alloc") == 0;
+  int frames = 0, alloc_frames = 0, allocs = 0;
 
   bool run = true;         // false when game should exit
   bool frame_tick = false; // true when frame time has ticked (time to update)
@@ -42,20 +55,33 @@ int main(int argc, char *argv[]) {
       case ALLEGRO_EVENT_DISPLAY_CLOSE:
         run = false;       // stop running if user asks to close window
       default:
-        ecs_handle_keypress(ev);
-        ecs_handle_mouse(ev);
+        ecs_handle_keypress(world, ev);
+        ecs_handle_mouse(world, ev);
         scene_handle_input(ev);
         break;
     }
     if (frame_tick && al_is_event_queue_empty(event_queue)) {
       frame_tick = false;
+      alloc_guard_begin(strict_alloc && frames > 0);
       run = main_update();
       main_draw();
+      int frame_allocs = alloc_guard_end();
+      if (frames++ > 0 && frame_allocs > 0) {
+        ++alloc_frames;
+        allocs += frame_allocs;
+      }
     }
   }
 
+  if (alloc_guard_enabled()) {
+    printf("%d allocations in %d of %d frames\n", allocs, alloc_frames,
+        frames);
+  }
+
+  ecs_world_free(world);
+  job_system_shutdown();
   particle_shutdown();
-  ecs_shutdown();
+  prefab_shutdown();
   al_game_shutdown();
   return 0;
 }
@@ -65,16 +91,16 @@ static bool main_update() {
   double delta = cur_time - last_frame_time; // time elapsed since last frame
   elapsed_time = delta;
   last_frame_time = cur_time;
-  ecs_update_systems(delta);      // update every system
-  update_particles(delta);        // update particles
+  ecs_update_systems(world, delta); // update every system and particle
   bool run = scene_update(delta); // run scene's update function
   return run;
 }
 
 static void main_draw() {
   al_clear_to_color(scene_bg_color);
-  render_all_sprites(elapsed_time);   // also draws particles
-  weapon_system_draw();
+  // also draws particles
+  render_all_sprites(world->sprites, world->particles, elapsed_time);
+  weapon_system_draw(world);
   scene_draw(); // the scene may draw something in addition to sprites (UI)
   al_flip_display();
 }
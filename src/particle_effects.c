@@ -1,17 +1,12 @@
 #include "particle_effects.h"
+#include "snapshot.h"
+#include "util/job.h"
 
 /* Static Variables ----------------------------------------------------------*/
 static const int BMP_SIZE = 32;
 static const char* DATA_PATH = "data/particle_effects.cfg";
+static const int UPDATE_GRAIN = 1024; // particles updated per job
 static ALLEGRO_BITMAP *particle_bitmap;
-// threading
-static double time_elapsed; // time elapsed for current update cycle
-/* ---------------------------------------------------------------------------*/
-
-/* Internal Structs ----------------------------------------------------------*/
-
-// node in a doubly linked list of particles
-static list *particle_list;  // list of particles
 static list *data_list;      // list of generator datas
 /* ---------------------------------------------------------------------------*/
 
@@ -55,16 +50,27 @@ static generator_data* load_generator_data(char const *name,
   return data;
 }
 
+// search the cached generator datas for one matching the given name
+static generator_data* find_generator_data(const char *name) {
+  list_node *p = data_list->head;
+  while (p != NULL && strcmp(((generator_data*)p->value)->name, name) != 0) {
+    p = p->next;
+  }
+  return p ? p->value : NULL;
+}
+
 static void data_free_fn(void *data) {
   free(((generator_data *)data)->name);
   free(data);
 }
 
 // helper to set up particle attributes
-static particle* make_particle(generator_data *data, vector pos, double angle) {
+static particle* make_particle(particle_system *ps,
+    const generator_data *data, vector pos, double angle)
+{
   double angle1 = angle - data->spawn_arc / 2;
   double angle2 = angle + data->spawn_arc / 2;
-  particle *p = malloc(sizeof(particle));
+  particle *p = pool_alloc(ps->_particle_pool);
   p->position = pos;
   p->velocity = rand_vec(angle1, angle2, data->spawn_velocity, data->max_velocity);
   p->time_alive = 0;
@@ -75,16 +81,28 @@ static particle* make_particle(generator_data *data, vector pos, double angle) {
   return p;
 }
 
-static void update_particle(particle *p) {
+static void update_particle(particle *p, double time) {
   const generator_data *data = p->data;
   double factor = p->time_alive / p->time_to_live;
-  double time = time_elapsed;
   p->velocity = vector_scale(p->velocity, 1 - data->deceleration * time);
   p->position = vector_add(p->position, vector_scale(p->velocity, time));
   p->time_alive += time;
   p->radius = data->start_radius + factor * data->end_radius;
   p->color = lerp_color(data->start_color, data->end_color, factor);
 }
+
+// particles to update and the time to update them by, shared by the jobs
+typedef struct particle_update {
+  particle **particles;
+  double time;
+} particle_update;
+
+static void update_particle_range(void *ctx, int begin, int end) {
+  particle_update *update = ctx;
+  for (int i = begin; i < end; i++) {
+    update_particle(update->particles[i], update->time);
+  }
+}
 /* ---------------------------------------------------------------------------*/
 
 /* Public Interface ----------------------------------------------------------*/
@@ -96,7 +114,23 @@ void particle_init(ALLEGRO_BITMAP *display) {
       al_map_rgba(255,255,255,255));
   al_set_target_bitmap(display); // set target back to main display
   data_list = list_new();        // create list to store data
-  particle_list = list_new();    // create list to store particles
+}
+
+particle_system* particle_system_new(int capacity) {
+  particle_system *ps = malloc(sizeof(particle_system));
+  ps->_particle_pool = pool_new(sizeof(particle), capacity);
+  ps->_node_pool = pool_new(sizeof(list_node), capacity);
+  ps->_particles = list_new_pooled(ps->_node_pool); // list to store particles
+  ps->_live = array_new(sizeof(particle*), capacity);
+  return ps;
+}
+
+void particle_system_free(particle_system *ps) {
+  list_free(ps->_particles, NULL); // particles are freed with their pool
+  pool_free(ps->_particle_pool);
+  pool_free(ps->_node_pool);
+  array_free(ps->_live);
+  free(ps);
 }
 
 list* load_all_generator_data() {
@@ -106,7 +140,9 @@ list* load_all_generator_data() {
   al_get_first_config_section(cfg, &section);
   char const *name = al_get_next_config_section(&section);
   while (name != NULL) {
-    load_generator_data(name, cfg);
+    if (find_generator_data(name) == NULL) { // cache data not yet loaded
+      list_push(data_list, load_generator_data(name, cfg));
+    }
     list_push(names, strdup(name));
     name = al_get_next_config_section(&section);
   }
@@ -115,57 +151,71 @@ list* load_all_generator_data() {
 }
 
 particle_generator get_particle_generator(char *name) {
-  list_node *p = data_list->head;
-  generator_data *dat = NULL;
-  while (p != NULL && strcmp(((generator_data*)p->value)->name, name) != 0) {
-    p = p->next; // search for data matching the given name
-  }
-  if (p == NULL) {                                        // did not find data
+  generator_data *dat = find_generator_data(name);
+  if (dat == NULL) {                                      // did not find data
     ALLEGRO_CONFIG *cfg = al_load_config_file(DATA_PATH); // open config file
     dat = load_generator_data(name, cfg);                 // load data from file
     list_push(data_list, dat);                            // cache data in list
     al_destroy_config(cfg);
   }
-  else { // found data
-    dat = (generator_data*)p->value;
-  }
   return (particle_generator) {
     .data = dat, .position = {0,0}, .angle = 0, ._spawn_counter = 0
   };
 }
 
-void spawn_particles(particle_generator *gen, double time, double density,
-    vector source_velocity) {
+void spawn_particles(particle_system *ps, particle_generator *gen,
+    double time, double density, vector source_velocity)
+{
+  int count = particle_spawn_count(gen, time, density);
+  emit_particles(ps, gen, count, source_velocity);
+}
+
+int particle_spawn_count(particle_generator *gen, double time,
+    double density)
+{
   generator_data *data = gen->data;
   double spawn_count = gen->_spawn_counter + data->spawn_rate * density * time;
   // place excess in spawn counter
   gen->_spawn_counter = spawn_count - (int)spawn_count;
-  // spawn a whole number of particles
-  for (int i = 0; i < (int)spawn_count; i++) {
+  return (int)spawn_count; // spawn a whole number of particles
+}
+
+void emit_particles(particle_system *ps, const particle_generator *gen,
+    int count, vector source_velocity)
+{
+  for (int i = 0; i < count; i++) {
     // create particle and copy data to node's storage
-    particle *p = make_particle(gen->data, gen->position, gen->angle);
+    particle *p = make_particle(ps, gen->data, gen->position, gen->angle);
     p->velocity = vector_add(p->velocity, source_velocity);
-    list_push(particle_list, p);
+    list_push(ps->_particles, p);
   }
 }
 
-void update_particles(double time) {
-  time_elapsed = time;
-  list_node *pnode = particle_list->head;
+void update_particles(particle_system *ps, double time) {
+  // remove expired particles here, as the list and pool are not thread safe,
+  // and collect the rest to be updated by the jobs
+  array_clear(ps->_live);
+  list_node *pnode = ps->_particles->head;
   while (pnode != NULL) {
     particle *p = (particle*)(pnode->value); // particle struct in node
     if (p->time_alive > p->time_to_live) {   // has particle expired?
-      pnode = list_remove(particle_list, pnode, free); // remove
+      pool_release(ps->_particle_pool, p);
+      pnode = list_remove(ps->_particles, pnode, NULL); // remove
     }
-    else {                 // not expired - perform update
-      update_particle(p);  // update particle attributes
+    else {                      // not expired - queue for update
+      *(particle**)array_push(ps->_live) = p;
       pnode = pnode->next; // move to next particle
     }
   }
+  particle_update update = {
+    .particles = (particle**)ps->_live->data, .time = time
+  };
+  job_parallel_for(ps->_live->length, UPDATE_GRAIN, update_particle_range,
+      &update);
 }
 
-void draw_particles() {
-  list_node *node = particle_list->head;
+void draw_particles(particle_system *ps) {
+  list_node *node = ps->_particles->head;
   al_hold_bitmap_drawing(true);  // better performance for repeated draws
   while (node != NULL) {
     particle *p = (particle*)(node->value);
@@ -183,21 +233,52 @@ void draw_particles() {
 }
 
 // remove all particles
-void clear_particles() {
-  list_free(particle_list, free);
-  particle_list = list_new();
+void clear_particles(particle_system *ps) {
+  list_node *node = ps->_particles->head;
+  while (node != NULL) {
+    pool_release(ps->_particle_pool, node->value);
+    node = list_remove(ps->_particles, node, NULL);
+  }
 }
 
 void particle_shutdown() {
   if (particle_bitmap != NULL) {
     al_destroy_bitmap(particle_bitmap);
   }
-  // remove all force sources, generator datas, and particles
-  list_free(particle_list, free);
+  // remove all generator datas
   list_free(data_list, data_free_fn);
 }
 
-int get_particle_count() {
-  return particle_list->length;
+int get_particle_count(particle_system *ps) {
+  return ps->_particles->length;
+}
+
+void particle_save(particle_system *ps, snapshot *snap) {
+  list *particles = ps->_particles;
+  snapshot_write(snap, &particles->length, sizeof(particles->length));
+  // from the tail, as particle_load rebuilds the list by pushing
+  for (list_node *node = particles->tail; node; node = node->prev) {
+    snapshot_write(snap, node->value, sizeof(particle));
+  }
+}
+
+void particle_load(particle_system *ps, snapshot *snap) {
+  list *particles = ps->_particles;
+  int count;
+  snapshot_read(snap, &count, sizeof(count));
+  // overwrite existing particles before allocating or freeing any
+  list_node *node = particles->tail;
+  for (int i = 0; i < count; i++) {
+    if (node == NULL) {
+      node = list_push(particles, pool_alloc(ps->_particle_pool));
+    }
+    snapshot_read(snap, node->value, sizeof(particle));
+    node = node->prev;
+  }
+  while (node != NULL) { // free particles beyond those restored
+    list_node *prev = node->prev;
+    pool_release(ps->_particle_pool, node->value);
+    list_remove(particles, node, NULL);
+    node = prev;
+  }
 }
-/* ---------------------------------------------------------------------------*/
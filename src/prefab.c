@@ -0,0 +1,195 @@
+#include <threads.h>
+#include "prefab.h"
+
+static const char* DATA_PATH = "data/sprite.cfg";
+// names used for ecs_entity_tag in the config file, indexed by tag
+static const char* tag_names[NUM_ENTITY_TAGS] = {
+  [ENTITY_EXPLOSION] = "explosion",
+  [ENTITY_SHIP]      = "ship",
+  [ENTITY_FLARE]     = "flare",
+  [ENTITY_MISSILE]   = "missile",
+  [ENTITY_HAZARD]    = "hazard",
+  [ENTITY_SCENIC]    = "scenic"
+};
+
+// every prefab by name
+static stringmap *prefabs;
+// held while reading or changing prefabs, created on first use
+static mtx_t prefabs_lock;
+static once_flag prefabs_lock_once = ONCE_FLAG_INIT;
+
+static void init_prefabs_lock() {
+  mtx_init(&prefabs_lock, mtx_plain);
+}
+
+// create an empty prefab under a name, holding prefabs_lock
+static prefab* add_prefab(const char *name, ecs_entity_tag tag) {
+  if (prefabs == NULL) { prefabs = stringmap_new(free); }
+  assert(stringmap_find(prefabs, name) == NULL); // names must be unique
+  prefab *p = calloc(1, sizeof(prefab));
+  p->tag = tag;
+  stringmap_add(prefabs, name, p);
+  return p;
+}
+
+// copy a config value into buf without surrounding quotes
+static void unquote(char *buf, size_t size, const char *str) {
+  size_t len = strlen(str);
+  if (len >= 2 && str[0] == '"' && str[len - 1] == '"') {
+    str++;
+    len -= 2;
+  }
+  if (len >= size) { len = size - 1; }
+  memcpy(buf, str, len);
+  buf[len] = '\0';
+}
+
+// parse a comma separated list of sides (e.g. "north,west")
+static Direction string_to_direction(const char *dirstr) {
+  Direction dir = NONE;
+  char str[40];
+  unquote(str, sizeof(str), dirstr);
+  for (char *tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    while (*tok == ' ') { ++tok; }
+    if      (strcmp(tok, "north") == 0) { dir |= NORTH; }
+    else if (strcmp(tok, "south") == 0) { dir |= SOUTH; }
+    else if (strcmp(tok, "east")  == 0) { dir |= EAST; }
+    else if (strcmp(tok, "west")  == 0) { dir |= WEST; }
+    else { fprintf(stderr, "unknown direction %s in %s\n", tok, DATA_PATH); }
+  }
+  return dir;
+}
+
+static prefab* load_prefab(const char *name, ALLEGRO_CONFIG *cfg) {
+  const char *val = al_get_config_value(cfg, name, "bitmap");
+  if (val == NULL) { return NULL; } // not configured
+  char bitmap[64];
+  unquote(bitmap, sizeof(bitmap), val);
+  ecs_entity_tag tag = ENTITY_SCENIC;
+  if ((val = al_get_config_value(cfg, name, "tag"))) {
+    char tagstr[20];
+    unquote(tagstr, sizeof(tagstr), val);
+    int i = 0;
+    while (i < NUM_ENTITY_TAGS && strcmp(tag_names[i], tagstr) != 0) { ++i; }
+    if (i < NUM_ENTITY_TAGS) { tag = i; }
+    else { fprintf(stderr, "unknown tag %s for %s\n", tagstr, name); }
+  }
+  prefab *p = add_prefab(name, tag);
+  // sprite
+  int depth = 0, frame_width = 0, frame_height = 0;
+  double animation_rate = 0;
+  AnimationType type = ANIMATE_OFF;
+  if ((val = al_get_config_value(cfg, name, "depth"))) { depth = atoi(val); }
+  if ((val = al_get_config_value(cfg, name, "frame_width"))) {
+    frame_width = atoi(val);
+  }
+  if ((val = al_get_config_value(cfg, name, "frame_height"))) {
+    frame_height = atoi(val);
+  }
+  if ((val = al_get_config_value(cfg, name, "animation_rate"))) {
+    animation_rate = atof(val);
+    type = ANIMATE_LOOP;
+  }
+  if ((val = al_get_config_value(cfg, name, "animation"))) {
+    type = strcmp(val, "once") == 0 ? ANIMATE_ONCE : ANIMATE_LOOP;
+  }
+  prefab_set_animation(p, bitmap, depth, frame_width, frame_height,
+      animation_rate, type);
+  if ((val = al_get_config_value(cfg, name, "scale"))) {
+    double scale = atof(val);
+    p->sprite.scale = (vector){scale, scale};
+  }
+  // body, only added if one of its properties is given
+  const char *mass = al_get_config_value(cfg, name, "mass");
+  const char *max_speed = al_get_config_value(cfg, name, "max_speed");
+  const char *exit_sides = al_get_config_value(cfg, name, "destroy_on_exit");
+  if (mass || max_speed || exit_sides) {
+    Body *b = &prefab_add_component(p, ECS_COMPONENT_BODY)->body;
+    if (mass) { b->mass = atof(mass); }
+    if (max_speed) { b->max_linear_velocity = atof(max_speed); }
+    if (exit_sides) { b->destroy_on_exit = string_to_direction(exit_sides); }
+  }
+  return p;
+}
+
+prefab* prefab_new(const char *name, ecs_entity_tag tag) {
+  call_once(&prefabs_lock_once, init_prefabs_lock);
+  mtx_lock(&prefabs_lock);
+  prefab *p = add_prefab(name, tag);
+  mtx_unlock(&prefabs_lock);
+  return p;
+}
+
+prefab* prefab_get(const char *name) {
+  // worlds created on different threads may load the same prefab at once
+  call_once(&prefabs_lock_once, init_prefabs_lock);
+  mtx_lock(&prefabs_lock);
+  prefab *p = prefabs ? stringmap_find(prefabs, name) : NULL;
+  if (p == NULL) { // not defined yet, try loading it
+    ALLEGRO_CONFIG *cfg = al_load_config_file(DATA_PATH);
+    if (cfg != NULL) {
+      p = load_prefab(name, cfg);
+      al_destroy_config(cfg);
+    }
+    else { fprintf(stderr, "could not open %s\n", DATA_PATH); }
+  }
+  mtx_unlock(&prefabs_lock);
+  return p;
+}
+
+void prefab_set_sprite(prefab *prefab, const char *name, int depth) {
+  prefab_set_animation(prefab, name, depth, 0, 0, 0, ANIMATE_OFF);
+}
+
+void prefab_set_animation(prefab *prefab, const char *name, int depth,
+    int frame_width, int frame_height, double animation_rate,
+    AnimationType type)
+{
+  prefab->sprite = sprite_template(name, frame_width, frame_height,
+      animation_rate, type);
+  prefab->has_sprite = true;
+  prefab->depth = depth;
+}
+
+ecs_component* prefab_add_component(prefab *prefab, ecs_component_type type) {
+  ecs_component *comp = &prefab->components[(int)type];
+  memset(comp, 0, sizeof(ecs_component));
+  comp->type = type;
+  prefab->signature |= ECS_SIGNATURE(type);
+  return comp;
+}
+
+ecs_entity* prefab_spawn(ecs_world *world, prefab *prefab, vector position) {
+  ecs_entity *entity;
+  prefab_instantiate(world, prefab, &position, 1, &entity);
+  return entity;
+}
+
+void prefab_instantiate(ecs_world *world, prefab *prefab,
+    const vector *positions, int count, ecs_entity **out)
+{
+  ecs_reserve(world, prefab->signature, count);
+  for (int i = 0; i < count; i++) {
+    ecs_entity *entity = ecs_entity_new(world, positions[i], prefab->tag);
+    ecs_set_team(entity, prefab->team);
+    if (prefab->has_sprite) {
+      ecs_attach_sprite_copy(entity, &prefab->sprite, prefab->depth);
+    }
+    for (int type = 0; type < NUM_COMPONENT_TYPES; type++) {
+      if (prefab->signature & ECS_SIGNATURE(type)) {
+        ecs_add_component_copy(entity, &prefab->components[type]);
+      }
+    }
+    if (out != NULL) { out[i] = entity; }
+  }
+}
+
+void prefab_shutdown() {
+  call_once(&prefabs_lock_once, init_prefabs_lock);
+  mtx_lock(&prefabs_lock);
+  if (prefabs != NULL) {
+    stringmap_free(prefabs);
+    prefabs = NULL;
+  }
+  mtx_unlock(&prefabs_lock);
+}
@@ -1,104 +1,124 @@
 #include "render.h"
 
-// each layer stores a list of sprites to be drawn at that layer
-list *sprite_layers[SPRITE_LAYER_LIMIT * 2 + 1];
-
 static double elapsed_time; // time for current update (draw) call
-static void draw_sprite(sprite *s);
-static list* get_sprite_layer(int layernum);
+static void draw_sprite(sprite *s, vector position, double angle);
+static list* get_sprite_layer(sprite_layers *layers, int layernum);
 static ALLEGRO_FONT *debug_font;
 
-void sprite_init() {
+sprite_layers* sprite_layers_new(int capacity, sprite_locate_fn locate,
+    void *ctx)
+{
+  sprite_layers *layers = malloc(sizeof(sprite_layers));
+  layers->_locate = locate;
+  layers->_locate_ctx = ctx;
+  layers->_sprites = pool_new(sizeof(sprite), capacity);
+  layers->_nodes = pool_new(sizeof(list_node), capacity);
   for (int i = 0; i < SPRITE_LAYER_COUNT; i++) {
-    assert(sprite_layers[i] == NULL); // assert not already initialized
-    sprite_layers[i] = list_new();    // create a new list for each depth layer
+    // create a new list for each depth layer
+    layers->layers[i] = list_new_pooled(layers->_nodes);
   }
 
 #ifndef NDEBUG
   debug_font = al_game_get_font("LiberationMono-Regular");
 #endif
+  return layers;
 }
 
-void sprite_shutdown() {
-  for (int i = 0; i < SPRITE_LAYER_LIMIT * 2 + 1; i++) {
-    list_free(sprite_layers[i], (list_lambda)sprite_free);
+void sprite_layers_free(sprite_layers *layers) {
+  for (int i = 0; i < SPRITE_LAYER_COUNT; i++) {
+    list_free(layers->layers[i], NULL); // sprites are freed with their pool
   }
+  pool_free(layers->_sprites);
+  pool_free(layers->_nodes);
+  free(layers);
 }
 
-sprite* sprite_new(const char *name, vector *ref_position, double *ref_angle,
-    int depth) {
-  sprite *s = calloc(1, sizeof(sprite));
+sprite sprite_template(const char *name, int frame_width, int frame_height,
+    double animation_rate, AnimationType type)
+{
   ALLEGRO_BITMAP *bmp = al_game_get_bitmap(name);
   assert(bmp != NULL);
-  s->bitmap = bmp;
-  s->center = (vector) {
-    .x = al_get_bitmap_width(bmp) / 2,
-    .y = al_get_bitmap_height(bmp) / 2
-  };
-  s->scale = (vector){1, 1};
-  s->tint = al_map_rgb(255,255,255);
-  s->position_ptr = ref_position;
-  s->angle_ptr = ref_angle;
-  // give sprite back-reference to its node so it may be removed when freed
-  s->_node = list_push(get_sprite_layer(depth), s);
-  s->_depth = depth;
   // default to using full sprite
-  s->frame_width = al_get_bitmap_width(bmp);
-  s->frame_height = al_get_bitmap_height(bmp);
-  s->animation_type = ANIMATE_OFF;
+  if (frame_width <= 0) { frame_width = al_get_bitmap_width(bmp); }
+  if (frame_height <= 0) { frame_height = al_get_bitmap_height(bmp); }
+  sprite s = {
+    .bitmap = bmp,
+    .tint = al_map_rgb(255,255,255),
+    .center = { .x = frame_width / 2, .y = frame_height / 2 },
+    .scale = {1, 1},
+    .frame_width = frame_width,
+    .frame_height = frame_height,
+    .animation_type = type
+  };
+  if (type != ANIMATE_OFF) {
+    s.animation_rate = animation_rate;
+    s._animation_timer = 1 / animation_rate;
+  }
   return s;
 }
 
-sprite* animation_new(const char *name, vector *ref_position, double *ref_angle,
-    int depth, int frame_width, int frame_height, double animation_rate,
-    AnimationType type)
+sprite* sprite_copy(sprite_layers *layers, const sprite *src,
+    uint64_t owner, int depth)
 {
-  sprite *s = calloc(1, sizeof(sprite));
-  ALLEGRO_BITMAP *bmp = al_game_get_bitmap(name);
-  assert(bmp != NULL);
-  s->bitmap = bmp;
-  s->center = (vector) {
-    .x = frame_width / 2,
-    .y = frame_height / 2
-  };
-  s->scale = (vector){1, 1};
-  s->tint = al_map_rgb(255,255,255);
-  s->position_ptr = ref_position;
-  s->angle_ptr = ref_angle;
+  sprite *s = pool_alloc(layers->_sprites);
+  *s = *src;
+  s->owner = owner;
+  s->_layers = layers;
   // give sprite back-reference to its node so it may be removed when freed
-  s->_node = list_push(get_sprite_layer(depth), s);
+  s->_node = list_push(get_sprite_layer(layers, depth), s);
   s->_depth = depth;
-  // default to using full sprite
-  s->frame_width = frame_width;
-  s->frame_height = frame_height;
-  s->animation_rate = animation_rate;
-  s->_animation_timer = 1 / animation_rate;
-  s->animation_type = type;
   return s;
 }
 
+sprite* sprite_new(sprite_layers *layers, const char *name,
+    uint64_t owner, int depth)
+{
+  sprite s = sprite_template(name, 0, 0, 0, ANIMATE_OFF);
+  return sprite_copy(layers, &s, owner, depth);
+}
+
+sprite* animation_new(sprite_layers *layers, const char *name,
+    uint64_t owner, int depth, int frame_width,
+    int frame_height, double animation_rate, AnimationType type)
+{
+  sprite s = sprite_template(name, frame_width, frame_height, animation_rate,
+      type);
+  return sprite_copy(layers, &s, owner, depth);
+}
+
 void sprite_free(sprite *sprite) {
-  list_remove(get_sprite_layer(sprite->_depth), sprite->_node, free);
+  sprite_layers *layers = sprite->_layers;
+  list_remove(get_sprite_layer(layers, sprite->_depth), sprite->_node, NULL);
+  pool_release(layers->_sprites, sprite);
 }
 
 void sprite_set_depth(sprite *sprite, int depth) {
+  sprite_layers *layers = sprite->_layers;
   // remove sprite from current layer but do not free it
-  list_remove(get_sprite_layer(sprite->_depth), sprite->_node, NULL);
+  list_remove(get_sprite_layer(layers, sprite->_depth), sprite->_node, NULL);
   sprite->_depth = depth;
   // push sprite onto new layer and set node
-  sprite->_node = list_push(get_sprite_layer(depth), sprite);
+  sprite->_node = list_push(get_sprite_layer(layers, depth), sprite);
 }
 
-void render_all_sprites(double time) {
+void render_all_sprites(sprite_layers *layers, particle_system *particles,
+    double time)
+{
   elapsed_time = time;
   for (int layer = 0; layer < SPRITE_LAYER_COUNT; layer++) {
-    if (layer == SPRITE_LAYER_COUNT / 2) { draw_particles(); }
-    list *sprites = sprite_layers[layer];
-    list_each(sprites, (list_lambda)draw_sprite);
+    if (layer == SPRITE_LAYER_COUNT / 2) { draw_particles(particles); }
+    sprite *s;
+    LIST_FOREACH(s, layers->layers[layer]) {
+      vector position;
+      double angle;
+      if (layers->_locate(layers->_locate_ctx, s->owner, &position, &angle)) {
+        draw_sprite(s, position, angle);
+      }
+    }
   }
 }
 
-static void draw_sprite(sprite *s) {
+static void draw_sprite(sprite *s, vector position, double angle) {
   if (s->animation_type != ANIMATE_OFF) {
     s->_animation_timer -= elapsed_time;
     if (s->_animation_timer < 0) {
@@ -126,28 +146,27 @@ static void draw_sprite(sprite *s) {
       sx, 0, s->frame_width, s->frame_height, // section
       s->tint,                                // sprite color
       s->center.x, s->center.y,               // center of bitmap
-      s->position_ptr->x, s->position_ptr->y, // location to draw center to
+      position.x, position.y,                 // location to draw center to
       s->scale.x, s->scale.y,                 // x and y scaling
-      *(s->angle_ptr),                        // rotation of entity
+      angle,                                  // rotation of entity
       0                                       // horiz/vert flip
   );
 #ifndef NDEBUG
-  al_draw_textf(debug_font, al_map_rgb(255,0,0), s->position_ptr->x,
-      s->position_ptr->y, 0, "angle: %3.3f", *s->angle_ptr);
-  al_draw_textf(debug_font, al_map_rgb(0,0,255), s->position_ptr->x,
-      s->position_ptr->y + 30, 0, "pos: <%3d,%3d>", (int)s->position_ptr->x,
-      (int)s->position_ptr->y);
+  al_draw_textf(debug_font, al_map_rgb(255,0,0), position.x, position.y, 0,
+      "angle: %3.3f", angle);
+  al_draw_textf(debug_font, al_map_rgb(0,0,255), position.x, position.y + 30,
+      0, "pos: <%3d,%3d>", (int)position.x, (int)position.y);
 #endif
 }
 
-static list* get_sprite_layer(int layernum) {
+static list* get_sprite_layer(sprite_layers *layers, int layernum) {
   int layer = layernum + SPRITE_LAYER_LIMIT; // adjust to non-negative index
   if (layer >= SPRITE_LAYER_COUNT || layer < 0) {
     fprintf(stderr, "sprite layer %d is out of range [%d,%d]",
         layernum, -SPRITE_LAYER_LIMIT, SPRITE_LAYER_LIMIT);
     exit(-1);
   }
-  return sprite_layers[layer];
+  return layers->layers[layer];
 }
 
 int sprite_width(sprite *s) {
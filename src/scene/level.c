@@ -1,10 +1,20 @@
 #include "scene/level.h"
 
 static bool run = true;
-static ecs_entity *player_ship;
+static ecs_world *world; // world the level is played in
+static ecs_handle player_ship;
+#ifndef NDEBUG
+// frames kept for rewinding, and how far back backspace rewinds
+static const int rewind_capacity = 300, rewind_keyframes = 30;
+static const int rewind_frames = 120;
+static snapshot_history *rewind_history;
+#endif
 
 static bool level_update(double time) {
   update_enemy_waves(time);
+#ifndef NDEBUG
+  snapshot_history_push(rewind_history, world);
+#endif
   return run;
 }
 
@@ -20,19 +30,38 @@ static void level_draw(void) {
     "Keyboard_listener",
     "Mouse_listener"
   };
+  static char* tag_names[] = {
+    "Explosion",
+    "Ship",
+    "Flare",
+    "Missile",
+    "Hazard",
+    "Scenic"
+  };
+  pool_stats entity_stats = ecs_entity_stats(world);
   al_draw_textf(main_font, al_map_rgb(255,0,0), 0, 0, 0,
-      "#entities: %d", ecs_entities->length);
+      "#entities: %d (peak %d, slabs %d)", entity_stats.live,
+      entity_stats.peak, entity_stats.slabs);
+  // entity counts by tag
+  for (int i = 0; i < NUM_ENTITY_TAGS; i++) {
+    al_draw_textf(main_font, al_map_rgb(255,0,0), 0, 40 + 30 * i, 0,
+        "#%s: %d", tag_names[i], ecs_tag_count(world, i));
+  }
   // component counts
   for (int i = 0; i < NUM_COMPONENT_TYPES; i++) {
-    list *comp_list = ecs_component_store[i];
+    pool_stats stats = ecs_component_stats(world, i);
     al_draw_textf(main_font, al_map_rgb(200,0,200), 0, 300 + 40 * i, 0,
-        "#%s: %d", comp_names[i], comp_list->length);
+        "#%s: %d (peak %d, allocs %d)", comp_names[i], stats.live,
+        stats.peak, stats.slabs);
   }
   // draw hitrects
-  list_node *node = ecs_component_store[ECS_COMPONENT_COLLIDER]->head;
-  for (; node; node = node->next) {
-    rectangle r = ((ecs_component*)node->value)->collider.rect;
-    al_draw_rectangle(r.x, r.y, r.x + r.w, r.y + r.h, al_map_rgba_f(0,1,0,0.5), 2);
+  array *colliders = world->component_store[ECS_COMPONENT_COLLIDER];
+  for (int i = 0; i < colliders->length; i++) {
+    ecs_entity *owner =
+      ((ecs_component*)array_get(colliders, i))->owner_entity;
+    aabb r = ecs_entity_bounds(owner)->hit;
+    al_draw_rectangle(r.left, r.top, r.right, r.bottom,
+        al_map_rgba_f(0,1,0,0.5), 2);
   }
 #endif
 }
@@ -40,10 +69,10 @@ static void level_draw(void) {
 static void level_handle_mouse(ALLEGRO_MOUSE_EVENT ev) {
   if (ev.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) {
     if (ev.button == 1) {
-      weapon_fire_player(); // fire player's current weapon
+      weapon_fire_player(world); // fire player's current weapon
     }
     else if (ev.button == 2) {
-      weapon_swap(); // swap player's current weapon
+      weapon_swap(world); // swap player's current weapon
     }
   }
 }
@@ -53,19 +82,41 @@ static void level_handle_keyboard(ALLEGRO_KEYBOARD_EVENT ev) {
     run = false;
   }
   if (ev.keycode == ALLEGRO_KEY_SPACE) {
-    launch_flare(player_ship->position);
+    ecs_entity *player = ecs_entity_get(world, player_ship);
+    if (player) { launch_flare(world, player->position); }
+  }
+#ifndef NDEBUG
+  if (ev.type == ALLEGRO_EVENT_KEY_DOWN &&
+      ev.keycode == ALLEGRO_KEY_BACKSPACE)
+  { // rewind a couple of seconds
+    int length = snapshot_history_length(rewind_history);
+    if (length > 0) {
+      int frames = length > rewind_frames ? rewind_frames : length - 1;
+      snapshot_history_restore(rewind_history, world, frames);
+    }
   }
+#endif
 }
 
 static void level_shutdown() {
+#ifndef NDEBUG
+  snapshot_history_free(rewind_history);
+  rewind_history = NULL;
+#endif
 }
 
-scene level_new(void) {
-  player_ship = make_player_ship();
-  weapon_system_set_weapons(player_ship, &seeker_launcher, &swarmer_launcher);
-  scenery_add_background("sunset", -SPRITE_LAYER_LIMIT, 0, 0);
-  scenery_pre_populate();
-  start_enemy_waves(player_ship);
+scene level_new(ecs_world *level_world) {
+  world = level_world;
+  ecs_entity *player = make_player_ship(world);
+  player_ship = player->handle;
+  weapon_system_set_weapons(player, &seeker_launcher, &swarmer_launcher);
+  scenery_add_background(world, "sunset", -SPRITE_LAYER_LIMIT, 0, 0);
+  scenery_pre_populate(world);
+  start_enemy_waves(player);
+  enemies_preload();
+#ifndef NDEBUG
+  rewind_history = snapshot_history_new(rewind_capacity, rewind_keyframes);
+#endif
   return (scene){
     .update = level_update,
     .draw = level_draw,
@@ -0,0 +1,124 @@
+#include "snapshot.h"
+#include "ecs.h"
+#include "particle_effects.h"
+#include "util/al_helper.h"
+#include "util/delta.h"
+
+snapshot* snapshot_new() {
+  snapshot *snap = malloc(sizeof(snapshot));
+  snap->_bytes = array_new(1, 0);
+  snap->_read_pos = 0;
+  return snap;
+}
+
+void snapshot_free(snapshot *snap) {
+  array_free(snap->_bytes);
+  free(snap);
+}
+
+void snapshot_take(snapshot *snap, ecs_world *world) {
+  array_clear(snap->_bytes);
+  snapshot_write(snap, &world->_rand_state, sizeof(world->_rand_state));
+  ecs_save(world, snap);
+  particle_save(world->particles, snap);
+  weapon_system_save(world, snap);
+  scenery_system_save(world, snap);
+  collision_system_save(world, snap);
+}
+
+void snapshot_restore(snapshot *snap, ecs_world *world) {
+  snap->_read_pos = 0;
+  snapshot_read(snap, &world->_rand_state, sizeof(world->_rand_state));
+  ecs_load(world, snap);
+  particle_load(world->particles, snap);
+  weapon_system_load(world, snap);
+  scenery_system_load(world, snap);
+  collision_system_load(world, snap);
+  assert(snap->_read_pos == (size_t)snap->_bytes->length);
+}
+
+size_t snapshot_size(snapshot *snap) {
+  return snap->_bytes->length;
+}
+
+void snapshot_write(snapshot *snap, const void *src, size_t size) {
+  delta_append(snap->_bytes, src, size);
+}
+
+void snapshot_read(snapshot *snap, void *dst, size_t size) {
+  assert(snap->_read_pos + size <= (size_t)snap->_bytes->length);
+  memcpy(dst, snap->_bytes->data + snap->_read_pos, size);
+  snap->_read_pos += size;
+}
+
+snapshot_history* snapshot_history_new(int capacity, int keyframe_interval) {
+  assert(keyframe_interval > 0 && keyframe_interval <= capacity);
+  snapshot_history *history = malloc(sizeof(snapshot_history));
+  history->_capacity = capacity;
+  history->_keyframe_interval = keyframe_interval;
+  history->_pushed = 0;
+  history->_oldest = 0;
+  history->_frames = malloc(capacity * sizeof(array*));
+  for (int i = 0; i < capacity; i++) {
+    history->_frames[i] = array_new(1, 0);
+  }
+  history->_scratch = snapshot_new();
+  return history;
+}
+
+void snapshot_history_free(snapshot_history *history) {
+  for (int i = 0; i < history->_capacity; i++) {
+    array_free(history->_frames[i]);
+  }
+  free(history->_frames);
+  snapshot_free(history->_scratch);
+  free(history);
+}
+
+void snapshot_history_push(snapshot_history *history, ecs_world *world) {
+  int frame = history->_pushed++;
+  if (history->_pushed - history->_capacity > history->_oldest) {
+    history->_oldest = history->_pushed - history->_capacity;
+  }
+  int keyframe = frame - frame % history->_keyframe_interval;
+  array *out = history->_frames[frame % history->_capacity];
+  array *cur = history->_scratch->_bytes;
+  snapshot_take(history->_scratch, world);
+  if (frame == keyframe) { // store whole
+    array_clear(out);
+    delta_append(out, cur->data, cur->length);
+  }
+  else { // store difference from keyframe
+    array *base = history->_frames[keyframe % history->_capacity];
+    delta_encode(base->data, base->length, cur->data, cur->length, out);
+  }
+}
+
+int snapshot_history_length(snapshot_history *history) {
+  // a frame can be restored only while its keyframe is still in the ring
+  int interval = history->_keyframe_interval;
+  int first_keyframe =
+    (history->_oldest + interval - 1) / interval * interval;
+  int length = history->_pushed - first_keyframe;
+  return length > 0 ? length : 0;
+}
+
+void snapshot_history_restore(snapshot_history *history, ecs_world *world,
+    int frames_ago)
+{
+  assert(frames_ago >= 0 && frames_ago < snapshot_history_length(history));
+  int frame = history->_pushed - 1 - frames_ago;
+  int keyframe = frame - frame % history->_keyframe_interval;
+  array *enc = history->_frames[frame % history->_capacity];
+  array *cur = history->_scratch->_bytes;
+  if (frame == keyframe) {
+    array_clear(cur);
+    delta_append(cur, enc->data, enc->length);
+  }
+  else {
+    array *base = history->_frames[keyframe % history->_capacity];
+    delta_decode(base->data, base->length, enc->data, enc->length, cur);
+  }
+  snapshot_restore(history->_scratch, world);
+  history->_pushed = frame + 1; // newer frames belong to a discarded future
+}
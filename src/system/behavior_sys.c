@@ -2,9 +2,14 @@
 
 // if distance to target is less than this, consider it reached
 const static double close_enough = 5;
-static double elapsed_time;
+// every entity that can steer itself. behaviors act through propulsion, so
+// entities lacking one are skipped
+static const ecs_signature signature = ECS_SIGNATURE(ECS_COMPONENT_BEHAVIOR) |
+  ECS_SIGNATURE(ECS_COMPONENT_PROPULSION) | ECS_SIGNATURE(ECS_COMPONENT_BODY);
 
-static void move_toward(ecs_entity *ent, Propulsion *p, vector target) {
+static void move_toward(ecs_entity *ent, Propulsion *p, vector target,
+    double elapsed_time)
+{
   // displacement to target
   vector disp = vector_sub(target, ent->position);
   if (p->directed) { // adjust angle towards target to move towards it
@@ -19,23 +24,27 @@ static void move_toward(ecs_entity *ent, Propulsion *p, vector target) {
   }
 }
 
-static void update_behavior(ecs_component *comp) {
-  ecs_entity *ent = comp->owner_entity;
-  Behavior b = comp->behavior;
+static void update_behavior(ecs_entity *ent, Behavior *behavior,
+    Propulsion *p, Body *bod, double time)
+{
+  Behavior b = *behavior;
   // try to move towards target
-  ecs_component *propulsion_comp = ent->components[ECS_COMPONENT_PROPULSION];
-  assert(propulsion_comp);
-  Propulsion *p = &propulsion_comp->propulsion;
   if (b.type == BEHAVIOR_FOLLOW) {
-    move_toward(ent, p, b.target->position);
+    ecs_entity *target = ecs_entity_get(ent->world, b.target);
+    if (target) {
+      move_toward(ent, p, target->position, time);
+    }
+    else { // target was destroyed, stop steering and drift
+      p->angular_throttle = 0;
+      behavior->type = BEHAVIOR_IDLE;
+    }
   }
   else if (b.type == BEHAVIOR_MOVE) {
     // displacement from current to desired location
-    move_toward(ent, p, b.location);
+    move_toward(ent, p, b.location, time);
     if (vector_dist(ent->position, b.location) < close_enough) {
       p->linear_throttle = ZEROVEC;
       p->angular_throttle = 0;
-      Body *bod = &ent->components[ECS_COMPONENT_BODY]->body;
       // TODO: this is cheating, behavior shouldn't directly modify velocity
       bod->velocity = ZEROVEC;
       b.type = BEHAVIOR_IDLE;
@@ -43,18 +52,15 @@ static void update_behavior(ecs_component *comp) {
   }
 }
 
-void behavior_system_fn(double time) {
-  elapsed_time = time;
-  list *components = ecs_component_store[ECS_COMPONENT_BEHAVIOR];
-  list_node *node = components->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
-      update_behavior(comp);
-      node = node->next;
-    }
-    else {
-      node = list_remove(components, node, free);
-    }
+void behavior_system_fn(ecs_world *world, double time) {
+  ecs_query *query = ecs_query_find(world, signature);
+  int behavior_col = ecs_query_column(query, ECS_COMPONENT_BEHAVIOR);
+  int prop_col = ecs_query_column(query, ECS_COMPONENT_PROPULSION);
+  int body_col = ecs_query_column(query, ECS_COMPONENT_BODY);
+  ecs_query_row *row;
+  ECS_QUERY_FOREACH(row, query) {
+    update_behavior(row->entity, &row->components[behavior_col]->behavior,
+        &row->components[prop_col]->propulsion,
+        &row->components[body_col]->body, time);
   }
 }
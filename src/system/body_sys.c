@@ -1,24 +1,41 @@
 #include "system/body_sys.h"
+#include "util/job.h"
 
-static double elapsed_time = 0; // store update time
-static void update_body(ecs_component *body_comp);
+static const int body_grain = 256; // bodies updated per job
+
+static void update_body(ecs_component *body_comp, double elapsed_time);
 // return true if an entity is out of bounds an should be destroyed
-static bool out_of_bounds(ecs_entity *e, Body *b);
+static bool out_of_bounds(aabb extent, Body *b);
 // keep the linear and angular speed of a Body within its limits
-static void limit_speed(Body *b);
+static void limit_speed(Body *b, double elapsed_time);
 
-void body_system_fn(double time) {
-  elapsed_time = time;
-  list *body_list = ecs_component_store[(int)ECS_COMPONENT_BODY];
-  list_node *node = body_list->head;
-  while (node) {
-    ecs_component *body_comp = node->value;
-    if (body_comp->active) {
-      update_body(body_comp);
-      node = node->next;
-    }
-    else {
-      node = list_remove(body_list, node, free);
+// bodies to update and the time to update them by, shared by the jobs
+typedef struct body_update {
+  array *store;
+  double time;
+} body_update;
+
+static void update_body_range(void *ctx, int begin, int end) {
+  body_update *update = ctx;
+  for (int i = begin; i < end; i++) {
+    update_body(array_get(update->store, i), update->time);
+  }
+}
+
+void body_system_fn(ecs_world *world, double time) {
+  // each body only moves its own entity, so they are updated in parallel
+  array *store = world->component_store[ECS_COMPONENT_BODY];
+  body_update update = { .store = store, .time = time };
+  job_parallel_for(store->length, body_grain, update_body_range, &update);
+}
+
+void bounds_system_fn(ecs_world *world, double time) {
+  ecs_update_bounds(world);
+  ecs_component *body_comp;
+  ECS_FOREACH(body_comp, world, ECS_COMPONENT_BODY) {
+    ecs_entity *entity = body_comp->owner_entity;
+    if (out_of_bounds(ecs_entity_bounds(entity)->extent, &body_comp->body)) {
+      ecs_entity_free(entity);
     }
   }
 }
@@ -28,42 +45,26 @@ void make_constant_vel_body(Body *b, vector vel) {
   b->max_linear_velocity = vector_len(vel);
 }
 
-static void update_body(ecs_component *body_comp) {
+static void update_body(ecs_component *body_comp, double elapsed_time) {
   assert(body_comp->type == ECS_COMPONENT_BODY);
   //assert(body_comp->owner_entity->components[ECS_COMPONENT_BODY] == body_comp);
   Body *body = &(body_comp->body);              // the component itself
   ecs_entity *entity = body_comp->owner_entity; // the owner entity
   assert(entity != NULL);
-  limit_speed(body);
+  limit_speed(body, elapsed_time);
   vector displacement = vector_scale(body->velocity, elapsed_time);
   entity->position = vector_add(displacement, entity->position);
-  if (out_of_bounds(entity, body)) {
-    ecs_entity_free(entity);
-  }
 }
 
-static bool out_of_bounds(ecs_entity *e, Body *b) {
-  int top, bottom, left, right;
-  sprite *s = e->sprite;
-  if (s != NULL) {  // determine bounds by sprite
-    left = e->position.x - sprite_width(s) / 2;
-    right = e->position.x + sprite_width(s) / 2;
-    top = e->position.y - sprite_height(s) / 2;
-    bottom = e->position.y + sprite_height(s) / 2;
-  }
-  else {  // just use the entity's center point
-    top = bottom = e->position.x;
-    left = right = e->position.y;
-  }
-
+static bool out_of_bounds(aabb extent, Body *b) {
   return
-    ((b->destroy_on_exit & NORTH) && bottom < 0) ||
-    ((b->destroy_on_exit & WEST ) && right  < 0) ||
-    ((b->destroy_on_exit & SOUTH) && top    > SCREEN_H) ||
-    ((b->destroy_on_exit & EAST ) && left   > SCREEN_W);
+    ((b->destroy_on_exit & NORTH) && extent.bottom < 0) ||
+    ((b->destroy_on_exit & WEST ) && extent.right  < 0) ||
+    ((b->destroy_on_exit & SOUTH) && extent.top    > SCREEN_H) ||
+    ((b->destroy_on_exit & EAST ) && extent.left   > SCREEN_W);
 }
 
-static void limit_speed(Body *b) {
+static void limit_speed(Body *b, double elapsed_time) {
   double linear_factor = vector_len(b->velocity) / b->max_linear_velocity;
   if (linear_factor > 1) { // scale down to max speed
     b->velocity = vector_scale(b->velocity, 1 / linear_factor);
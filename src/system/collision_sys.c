@@ -1,52 +1,667 @@
+#include <math.h>
 #include "system/collision_sys.h"
+#include "snapshot.h"
+#include "util/job.h"
 
-static const double rollback_granularity = 10;
+static const int collider_grain = 16; // colliders prepared per job
+static const int cell_grain = 8;      // grid cells searched per job
+// speed in pixels/sec at or below which a body counts as still
+static const double sleep_speed = 1;
+// fewest slots in each table of contacts
+static const int min_contact_slots = 64;
+// buckets per grid cell: the awake and the resting colliders of each
+// category
+#define CELL_BUCKETS (2 * NUM_COLLISION_CATEGORIES)
+
+// grid cells covered by a hit box, inclusive
+typedef struct cell_span {
+  int left, top, right, bottom;
+} cell_span;
+
+// what decides whether a collider may collide with another, copied out of
+// its components so the pair search reads them packed
+typedef struct collider_filter {
+  collision_mask category, mask;
+  ecs_entity_team team;
+  bool resting; // stationary or asleep
+} collider_filter;
+
+// a pair of colliders found by the pair search, before it is put in order
+typedef struct found_pair {
+  int row;   // query row of the awake collider that found the pair
+  int other; // query row of the other collider
+  collision_event event;
+} found_pair;
+
+// two colliders that touched in an update, remembered into the next
+typedef struct contact {
+  // the entities in the order of their last event, NULL in an empty slot
+  ecs_handle entity1, entity2;
+  aabb hit1, hit2; // their hit boxes after responding to it
+} contact;
+
+// broadphase grid and scratch storage of one world's collision system.
+// the grid covers the screen in square cells; colliders beyond the screen
+// are put in the nearest cells. each collider is listed in every cell its
+// hit box covers, in the bucket of its category and whether it rests, so a
+// collider only walks the buckets of categories it may collide with
+typedef struct collision_system_state {
+  float cell_size;
+  double sleep_delay; // seconds a body must be still to fall asleep
+  int cols, rows;    // cells across and down the screen
+  array *spans;      // cell_span per query row
+  array *filters;    // collider_filter per query row
+  array *motions;    // vector per query row: how far it moved this update
+  array *paths;      // aabb per query row covering its move this update
+  // categories the colliders of each bucket react to in this update
+  collision_mask bucket_masks[NUM_COLLISION_CATEGORIES];
+  array *cell_start; // int per bucket (see bucket_index): first entry in
+                     // cell_rows, then the end
+  array *cell_rows;  // int query rows in each bucket, in ascending order
+  array *cell_paths; // float edges of the path of each entry of cell_rows,
+                     // all lefts then all tops, rights and bottoms
+  // found_pair lists filled by the search jobs each thread ran, created
+  // when a thread first may search
+  array *found[JOB_MAX_THREADS];
+  array *pair_start; // int per query row, then one past the last pair
+  array *pairs;      // int row of the second collider of each pair
+  array *events;     // collision_event of each pair
+  // contacts of the last update and of this one, each a hash table of
+  // contact keyed on the pair of entities, open addressed with a power of
+  // two slots. swapped after each update
+  array *contacts, *next_contacts;
+  collision_stats stats;
+} collision_system_state;
+
+// what the jobs preparing the rows of a query for the grid share
+typedef struct grid_prep {
+  collision_system_state *state;
+  ecs_query *query;
+  int collider_col, body_col;
+  double time; // length of the update
+} grid_prep;
+
+// rows of a query and their grid, shared by the jobs of a pair search
+typedef struct pair_search {
+  ecs_query *query;
+  const cell_span *spans;
+  const collider_filter *filters;
+  const vector *motions;
+  const aabb *paths;
+  const collision_mask *bucket_masks;
+  const int *cell_start, *cell_rows;
+  aabb_soa cell_paths;
+  int cols;
+  array **found;    // found_pair list of each thread
+  atomic_int tests; // pairs tested for time of impact
+} pair_search;
+
+// every entity with both a collider and a body
+static const ecs_signature signature = ECS_SIGNATURE(ECS_COMPONENT_COLLIDER) |
+  ECS_SIGNATURE(ECS_COMPONENT_BODY);
 
 // handle collision with level boundaries
-static void try_boundary_collision(ecs_entity *entity, Collider *collider);
-// check for and handle collision between two entities
-static void try_entity_collision(ecs_entity *e1, Collider *c1, ecs_entity *e2,
-    Collider *c2, double time);
-// roll back time and replay more slowly when a collision detected
-// return time left after collision
-static double roll_back_collision(ecs_entity *e1, Body *b1, Collider *c1,
-    ecs_entity *e2, Body *b2, Collider *c2, double elapsed_time);
+static void try_boundary_collision(ecs_entity *entity, Body *body);
+// respond to a collision between two entities whose hit boxes touched.
+// enter is true if they did not touch in the last update
+static void handle_entity_collision(const collision_event *event,
+    double time, bool enter);
+// time from 0 to 1 into an update at which two hit boxes first touched,
+// each having moved by its motion during the update. greater than 1 if
+// they did not touch. if normal is not NULL and they touched, it is set
+// to the normal of the face of the second box that the first reached
+static double touch_time(aabb hit1, vector motion1, aabb hit2,
+    vector motion2, vector *normal);
 // effect an elastic collision between bodies. called by try_entity_collision
 static void elastic_collision(Body *bod1, Body *bod2);
+// keep the colliders of rows [begin, end) of a query inside the level and
+// work out which cells they cover
+static void prepare_range(void *prep, int begin, int end);
+// list the prepared rows of a query in the cells their hit boxes cover
+// while moving through the update
+static void build_grid(collision_system_state *state, int count);
+// find the pairs that touched among the colliders of cells [begin, end)
+static void search_cells(void *search, int begin, int end);
+// put the pairs found by every thread in order of query row, returning
+// their number
+static int merge_found(collision_system_state *state, int count);
+// empty a contact table, making room for at least count contacts
+static void reset_contacts(array *table, int count);
+// find the contact between two entities in a table. if it is not there,
+// return NULL, or the empty slot it would go in when add is true
+static contact* find_contact(array *table, ecs_handle a, ecs_handle b,
+    bool add);
+// respond to the contacts of the last update that were not found in this
+// one, returning the number carried on because they could not have been
+static int end_contacts(ecs_world *world);
+
+// grow an int array to hold at least length elements
+static int* reserve_ints(array *ints, int length) {
+  if (length > ints->capacity) { array_reserve(ints, 2 * length); }
+  return (int*)ints->data;
+}
+
+// the packed edges of the paths of the grid entries
+static aabb_soa cell_paths_of(collision_system_state *state) {
+  float *edges = (float*)state->cell_paths->data;
+  int stride = state->stats.cell_entries;
+  return (aabb_soa){ edges, edges + stride, edges + 2 * stride,
+    edges + 3 * stride };
+}
+
+void collision_system_init(ecs_world *world) {
+  collision_system_state *state = malloc(sizeof(collision_system_state));
+  int capacity = world->_entity_capacity;
+  *state = (collision_system_state){
+    .spans = array_new(sizeof(cell_span), capacity),
+    .filters = array_new(sizeof(collider_filter), capacity),
+    .motions = array_new(sizeof(vector), capacity),
+    .paths = array_new(sizeof(aabb), capacity),
+    .cell_start = array_new(sizeof(int), 0),
+    .cell_rows = array_new(sizeof(int), 4 * capacity),
+    .cell_paths = array_new(sizeof(float), 16 * capacity),
+    .pair_start = array_new(sizeof(int), capacity + 1),
+    .pairs = array_new(sizeof(int), capacity),
+    .events = array_new(sizeof(collision_event), capacity),
+    .contacts = array_new(sizeof(contact), min_contact_slots),
+    .next_contacts = array_new(sizeof(contact), min_contact_slots)
+  };
+  world->_collision = state;
+  collision_system_set_cell_size(world, COLLISION_DEFAULT_CELL_SIZE);
+  collision_system_set_sleep_delay(world, COLLISION_DEFAULT_SLEEP_DELAY);
+}
+
+void collision_system_shutdown(ecs_world *world) {
+  collision_system_state *state = world->_collision;
+  array_free(state->spans);
+  array_free(state->filters);
+  array_free(state->motions);
+  array_free(state->paths);
+  array_free(state->cell_start);
+  array_free(state->cell_rows);
+  array_free(state->cell_paths);
+  for (int t = 0; t < JOB_MAX_THREADS; t++) {
+    if (state->found[t]) { array_free(state->found[t]); }
+  }
+  array_free(state->pair_start);
+  array_free(state->pairs);
+  array_free(state->events);
+  array_free(state->contacts);
+  array_free(state->next_contacts);
+  free(state);
+  world->_collision = NULL;
+}
+
+void collision_system_set_cell_size(ecs_world *world, float cell_size) {
+  assert(cell_size > 0);
+  collision_system_state *state = world->_collision;
+  state->cell_size = cell_size;
+  state->cols = (int)ceilf(SCREEN_W / cell_size);
+  state->rows = (int)ceilf(SCREEN_H / cell_size);
+  reserve_ints(state->cell_start, state->cols * state->rows * CELL_BUCKETS + 1);
+}
+
+void collision_system_set_sleep_delay(ecs_world *world, double seconds) {
+  world->_collision->sleep_delay = seconds;
+}
+
+collision_stats collision_system_stats(ecs_world *world) {
+  return world->_collision->stats;
+}
+
+int collision_system_event_count(ecs_world *world) {
+  return world->_collision->events->length;
+}
+
+void collision_system_save(ecs_world *world, snapshot *snap) {
+  collision_system_state *state = world->_collision;
+  array *table = state->contacts;
+  // the whole table, so its slots and so the order contacts end in are
+  // the same after a restore. the count sizes the next table
+  snapshot_write(snap, &state->stats.contacts, sizeof(int));
+  snapshot_write(snap, &table->length, sizeof(table->length));
+  snapshot_write(snap, table->data, table->length * sizeof(contact));
+}
 
-void collision_system_fn(double time) {
-  list *comp_list = ecs_component_store[ECS_COMPONENT_COLLIDER];
-  list_node *node = comp_list->head;
-  while(node) {
-    ecs_component *comp = node->value;
-    assert(comp->type == ECS_COMPONENT_COLLIDER);
-    if (!comp->active) {
-      node = list_remove(comp_list, node, free);
+void collision_system_load(ecs_world *world, snapshot *snap) {
+  collision_system_state *state = world->_collision;
+  array *table = state->contacts;
+  int slots;
+  snapshot_read(snap, &state->stats.contacts, sizeof(int));
+  snapshot_read(snap, &slots, sizeof(slots));
+  array_reserve(table, slots);
+  table->length = slots;
+  snapshot_read(snap, table->data, slots * sizeof(contact));
+}
+
+const collision_event* collision_system_event(ecs_world *world, int idx) {
+  return array_get(world->_collision->events, idx);
+}
+
+void collision_system_fn(ecs_world *world, double time) {
+  collision_system_state *state = world->_collision;
+  ecs_query *query = ecs_query_find(world, signature);
+  int count = ecs_query_count(query);
+  if (count > state->spans->capacity) {
+    array_reserve(state->spans, 2 * count);
+    array_reserve(state->filters, 2 * count);
+    array_reserve(state->motions, 2 * count);
+    array_reserve(state->paths, 2 * count);
+  }
+  // each collider only moves itself back into the level and works out the
+  // path it swept through this update, so do every one at once. then grid
+  // the paths and find the pairs that touched along them among those
+  // sharing a cell. cells are searched in parallel, each pair in the one
+  // cell where it is first found, and every thread lists the pairs of the
+  // cells it searched. sweeping keeps fast colliders from passing through
+  // others between updates
+  grid_prep prep = {
+    .state = state, .query = query, .time = time,
+    .collider_col = ecs_query_column(query, ECS_COMPONENT_COLLIDER),
+    .body_col = ecs_query_column(query, ECS_COMPONENT_BODY)
+  };
+  job_parallel_for(count, collider_grain, prepare_range, &prep);
+  build_grid(state, count);
+  pair_search search = {
+    .query = query, .spans = (cell_span*)state->spans->data,
+    .filters = (collider_filter*)state->filters->data,
+    .motions = (vector*)state->motions->data,
+    .paths = (aabb*)state->paths->data,
+    .bucket_masks = state->bucket_masks,
+    .cell_start = (int*)state->cell_start->data,
+    .cell_rows = (int*)state->cell_rows->data, .cols = state->cols,
+    .cell_paths = cell_paths_of(state), .found = state->found
+  };
+  // any one thread may find every pair, so let each list hold as many as
+  // the events can. the lists then only grow along with the events
+  for (int t = 0; t < job_thread_count(); t++) {
+    if (!state->found[t]) {
+      state->found[t] =
+        array_new(sizeof(found_pair), state->events->capacity);
+    }
+    array_clear(state->found[t]);
+    array_reserve(state->found[t], state->events->capacity);
+  }
+  job_parallel_for(state->cols * state->rows, cell_grain, search_cells,
+      &search);
+  int num_pairs = merge_found(state, count);
+  state->stats.colliders = count;
+  state->stats.pair_tests = atomic_load(&search.tests);
+  state->stats.overlaps = num_pairs;
+  // detection only read the world. now respond to the events in order on
+  // this thread. handlers may destroy entities or change their teams, so
+  // skip events whose entities have since been destroyed or joined a team.
+  // remember the pairs that touched, so the next update can tell which
+  // collisions are new and which carry on
+  collision_event *events = (collision_event*)state->events->data;
+  reset_contacts(state->next_contacts, num_pairs +
+      state->stats.contacts);
+  int contacts = 0;
+  for (int e = 0; e < num_pairs; e++) {
+    ecs_entity *e1 = events[e].entity1, *e2 = events[e].entity2;
+    if (e1->destroyed || e2->destroyed || ecs_same_team(e1, e2)) {
       continue;
     }
-    ecs_entity *entity = comp->owner_entity;    // entity owning collider
-    Collider *collider = &comp->collider; // collider component
-    collider->rect.x = entity->position.x - collider->rect.w / 2.0;
-    collider->rect.y = entity->position.y - collider->rect.h / 2.0;
+    bool enter = !find_contact(state->contacts, e1->handle, e2->handle,
+        false);
+    handle_entity_collision(&events[e], time, enter);
+    if (!e1->destroyed && !e2->destroyed) {
+      *find_contact(state->next_contacts, e1->handle, e2->handle, true) =
+        (contact){ .entity1 = e1->handle, .entity2 = e2->handle,
+          .hit1 = ecs_entity_bounds(e1)->hit,
+          .hit2 = ecs_entity_bounds(e2)->hit };
+      ++contacts;
+    }
+  }
+  state->stats.contacts = contacts + end_contacts(world);
+  array *last = state->contacts;
+  state->contacts = state->next_contacts;
+  state->next_contacts = last;
+}
+
+// index of the cell containing a coordinate, clamped to the grid
+static int cell_of(float coord, float cell_size, int num_cells) {
+  int cell = (int)floorf(coord / cell_size);
+  return cell < 0 ? 0 : (cell >= num_cells ? num_cells - 1 : cell);
+}
+
+// index of the bucket holding colliders of a category
+static int bucket_of(collision_mask category) {
+  int bucket = 0;
+  while (!(category & 1)) {
+    category >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// index in cell_start of the bucket of a grid cell holding the awake or the
+// resting colliders of a category
+static int bucket_index(int cols, int x, int y, collision_mask category,
+    bool resting)
+{
+  return ((y * cols + x) * NUM_COLLISION_CATEGORIES + bucket_of(category)) *
+    2 + resting;
+}
+
+// true if a collision between two colliders could do anything: either
+// reacts to the other's category and they are not on the same team
+static bool may_collide(collider_filter f1, collider_filter f2) {
+  return ((f1.mask & f2.category) || (f2.mask & f1.category)) &&
+    !(f1.team & f2.team);
+}
+
+static void prepare_range(void *ctx, int begin, int end) {
+  grid_prep *prep = ctx;
+  collision_system_state *state = prep->state;
+  cell_span *spans = (cell_span*)state->spans->data;
+  collider_filter *filters = (collider_filter*)state->filters->data;
+  vector *motions = (vector*)state->motions->data;
+  aabb *paths = (aabb*)state->paths->data;
+  for (int i = begin; i < end; i++) {
+    ecs_query_row *row = ecs_query_get(prep->query, i);
+    Collider *collider = &row->components[prep->collider_col]->collider;
+    Body *body = &row->components[prep->body_col]->body;
     if (collider->keep_inside_level) {
-      try_boundary_collision(entity, collider);
-    }
-    // check collision against other colliders
-    list_node *other = node->next;
-    while(other) {
-      ecs_component *other_comp = other->value;
-      if (!other_comp->active) { other = other->next; continue; }
-      ecs_entity *other_entity = other_comp->owner_entity;
-      Collider *other_col = &other_comp->collider;
-      other_col->rect.x = other_entity->position.x - other_col->rect.w / 2.0;
-      other_col->rect.y = other_entity->position.y - other_col->rect.h / 2.0;
-      if (!(ecs_same_team(entity, other_entity))) {
-        try_entity_collision(entity, collider, other_entity, other_col, time);
+      try_boundary_collision(row->entity, body);
+    }
+    // a body falls asleep once it has been still for the sleep delay and
+    // wakes as soon as it moves
+    bool still = vector_len(body->velocity) <= sleep_speed;
+    collider->_idle_time = still ? collider->_idle_time + prep->time : 0;
+    filters[i] = (collider_filter){ .category = collider->category,
+      .mask = collider->mask, .team = row->entity->team,
+      .resting = collider->stationary ||
+        collider->_idle_time >= state->sleep_delay };
+    cell_span *span = &spans[i];
+    if (!collider->category) { // collides with nothing, covers no cells
+      *span = (cell_span){ .right = -1, .bottom = -1 };
+      continue;
+    }
+    // cover the hit box at the start of the update as well as now
+    motions[i] = vector_scale(body->velocity, prep->time);
+    aabb hit = ecs_entity_bounds(row->entity)->hit;
+    aabb path = paths[i] =
+      aabb_union(hit, aabb_offset(hit, vector_neg(motions[i])));
+    *span = (cell_span){
+      .left = cell_of(path.left, state->cell_size, state->cols),
+      .top = cell_of(path.top, state->cell_size, state->rows),
+      .right = cell_of(path.right, state->cell_size, state->cols),
+      .bottom = cell_of(path.bottom, state->cell_size, state->rows)
+    };
+  }
+}
+
+static void build_grid(collision_system_state *state, int count) {
+  int num_buckets = state->cols * state->rows * CELL_BUCKETS;
+  cell_span *spans = (cell_span*)state->spans->data;
+  collider_filter *filters = (collider_filter*)state->filters->data;
+  aabb *paths = (aabb*)state->paths->data;
+  int *cell_start = reserve_ints(state->cell_start, num_buckets + 1);
+  memset(cell_start, 0, (num_buckets + 1) * sizeof(int));
+  memset(state->bucket_masks, 0, sizeof(state->bucket_masks));
+  // count the colliders in each bucket of each cell
+  int entries = 0, resting = 0;
+  for (int i = 0; i < count; i++) {
+    collider_filter filter = filters[i];
+    resting += filter.resting;
+    if (!filter.category) { continue; }
+    state->bucket_masks[bucket_of(filter.category)] |= filter.mask;
+    cell_span *span = &spans[i];
+    for (int y = span->top; y <= span->bottom; y++) {
+      for (int x = span->left; x <= span->right; x++) {
+        ++cell_start[bucket_index(state->cols, x, y, filter.category,
+            filter.resting)];
+        ++entries;
       }
-      other = other->next;
     }
-    node = node->next;
   }
+  // turn the counts into the end of each bucket, then fill the buckets back
+  // to front so each ends up at its start with its rows in ascending order.
+  // copy the path of each entry alongside, packed for the batch tests
+  for (int b = 1; b <= num_buckets; b++) {
+    cell_start[b] += cell_start[b - 1];
+  }
+  int *cell_rows = reserve_ints(state->cell_rows, entries);
+  if (4 * entries > state->cell_paths->capacity) {
+    array_reserve(state->cell_paths, 8 * entries);
+  }
+  state->stats.cell_entries = entries;
+  state->stats.resting = resting;
+  aabb_soa cell_paths = cell_paths_of(state);
+  for (int i = count - 1; i >= 0; i--) {
+    if (!filters[i].category) { continue; }
+    cell_span *span = &spans[i];
+    for (int y = span->top; y <= span->bottom; y++) {
+      for (int x = span->left; x <= span->right; x++) {
+        int k = --cell_start[bucket_index(state->cols, x, y,
+            filters[i].category, filters[i].resting)];
+        cell_rows[k] = i;
+        cell_paths.left[k] = paths[i].left;
+        cell_paths.top[k] = paths[i].top;
+        cell_paths.right[k] = paths[i].right;
+        cell_paths.bottom[k] = paths[i].bottom;
+      }
+    }
+  }
+}
+
+// test a row of a pair search against the colliders in one bucket of the
+// grid cell at (x, y), adding those it touched to found
+static void search_bucket(pair_search *search, int i, int x, int y,
+    int bucket, bool resting, array *found, int *tests)
+{
+  cell_span span = search->spans[i];
+  int last = search->cell_start[bucket + 1];
+  // only entries whose paths cross this row's path can touch it
+  for (int k = search->cell_start[bucket]; k < last; k += AABB_BATCH) {
+    int n = last - k < AABB_BATCH ? last - k : AABB_BATCH;
+    uint32_t near =
+      aabb_intersect_batch(search->paths[i], search->cell_paths, k, n);
+    for (int e = 0; near && e < n; e++) {
+      if (!(near & (1u << e))) { continue; }
+      near &= ~(1u << e);
+      int j = search->cell_rows[k + e];
+      cell_span other = search->spans[j];
+      // a pair of awake colliders is found by the earlier row, and a pair
+      // sharing several cells only in the first
+      if ((!resting && j <= i) ||
+          x != (span.left > other.left ? span.left : other.left) ||
+          y != (span.top > other.top ? span.top : other.top) ||
+          !may_collide(search->filters[i], search->filters[j]))
+      {
+        continue;
+      }
+      ++*tests;
+      // events list the earlier row first
+      int first = j < i ? j : i, second = j < i ? i : j;
+      ecs_entity *e1 = ecs_query_get(search->query, first)->entity;
+      ecs_entity *e2 = ecs_query_get(search->query, second)->entity;
+      vector normal;
+      double t = touch_time(ecs_entity_bounds(e1)->hit, search->motions[first],
+          ecs_entity_bounds(e2)->hit, search->motions[second], &normal);
+      if (t <= 1) {
+        *(found_pair*)array_push(found) = (found_pair){ .row = i,
+          .other = j, .event = { .entity1 = e1, .entity2 = e2,
+            .normal = normal, .time = t } };
+      }
+    }
+  }
+}
+
+static void search_cells(void *ctx, int begin, int end) {
+  pair_search *search = ctx;
+  // a thread runs its search jobs one after another, as they start no
+  // jobs of their own, so each may add to the thread's list unguarded
+  array *found = search->found[job_thread_index()];
+  int tests = 0;
+  for (int c = begin; c < end; c++) {
+    int x = c % search->cols, y = c / search->cols;
+    // awake colliders find the resting ones they touched, so resting ones
+    // look for nothing, and pairs of resting colliders are never tested
+    for (int b = 0; b < NUM_COLLISION_CATEGORIES; b++) {
+      int awake = bucket_index(search->cols, x, y, 1u << b, false);
+      for (int k = search->cell_start[awake];
+          k < search->cell_start[awake + 1]; k++)
+      {
+        int i = search->cell_rows[k];
+        collider_filter filter = search->filters[i];
+        // buckets of the categories this row reacts to or that react to it
+        collision_mask wanted = filter.mask;
+        for (int o = 0; o < NUM_COLLISION_CATEGORIES; o++) {
+          if (search->bucket_masks[o] & filter.category) { wanted |= 1u << o; }
+        }
+        for (int o = 0; o < NUM_COLLISION_CATEGORIES; o++) {
+          for (int resting = 0; resting < 2 && (wanted & (1u << o));
+              resting++)
+          {
+            search_bucket(search, i, x, y,
+                bucket_index(search->cols, x, y, 1u << o, resting), resting,
+                found, &tests);
+          }
+        }
+      }
+    }
+  }
+  atomic_fetch_add(&search->tests, tests);
+}
+
+static int merge_found(collision_system_state *state, int count) {
+  // count the pairs each row found, then turn the counts into the end of
+  // each row's pairs and place the pairs back to front
+  int *start = reserve_ints(state->pair_start, count + 1);
+  memset(start, 0, (count + 1) * sizeof(int));
+  int num_pairs = 0;
+  for (int t = 0; t < JOB_MAX_THREADS; t++) {
+    found_pair *pair;
+    if (!state->found[t]) { continue; }
+    ARRAY_FOREACH(pair, state->found[t]) {
+      ++start[pair->row];
+      ++num_pairs;
+    }
+  }
+  for (int i = 1; i <= count; i++) { start[i] += start[i - 1]; }
+  int *pairs = reserve_ints(state->pairs, num_pairs);
+  if (num_pairs > state->events->capacity) {
+    array_reserve(state->events, 2 * num_pairs);
+  }
+  state->events->length = num_pairs;
+  collision_event *events = (collision_event*)state->events->data;
+  for (int t = 0; t < JOB_MAX_THREADS; t++) {
+    found_pair *pair;
+    if (!state->found[t]) { continue; }
+    ARRAY_FOREACH(pair, state->found[t]) {
+      int k = --start[pair->row];
+      pairs[k] = pair->other;
+      events[k] = pair->event;
+    }
+  }
+  // which thread found a pair depends on timing, so order each row's pairs
+  // by the other row. respond in order of row, as without the grid
+  for (int i = 0; i < count; i++) {
+    for (int a = start[i] + 1; a < start[i + 1]; a++) {
+      int j = pairs[a], b = a;
+      collision_event event = events[a];
+      for (; b > start[i] && pairs[b - 1] > j; b--) {
+        pairs[b] = pairs[b - 1];
+        events[b] = events[b - 1];
+      }
+      pairs[b] = j;
+      events[b] = event;
+    }
+  }
+  return num_pairs;
+}
+
+static void reset_contacts(array *table, int count) {
+  int slots = min_contact_slots;
+  while (slots < 2 * count) { slots *= 2; } // keep at most half full
+  array_reserve(table, slots);
+  table->length = slots;
+  memset(table->data, 0, slots * sizeof(contact));
+}
+
+static contact* find_contact(array *table, ecs_handle a, ecs_handle b,
+    bool add)
+{
+  if (table->length == 0) { return NULL; }
+  // the pair's key does not depend on which entity comes first
+  ecs_handle lo = a < b ? a : b, hi = a < b ? b : a;
+  uint64_t hash = (lo * 0x9e3779b97f4a7c15ull) ^ (hi + (hi << 29));
+  hash ^= hash >> 32;
+  contact *slots = (contact*)table->data;
+  int mask = table->length - 1;
+  for (int s = (int)(hash & mask); ; s = (s + 1) & mask) {
+    contact *c = &slots[s];
+    if (c->entity1 == ECS_NULL_HANDLE) { return add ? c : NULL; }
+    if ((c->entity1 == a && c->entity2 == b) ||
+        (c->entity1 == b && c->entity2 == a))
+    {
+      return c;
+    }
+  }
+}
+
+// true if two boxes are exactly the same
+static bool same_box(aabb b1, aabb b2) {
+  return b1.left == b2.left && b1.top == b2.top && b1.right == b2.right &&
+    b1.bottom == b2.bottom;
+}
+
+// an entity that can still collide, or NULL if it has been destroyed or
+// lost its collider or body
+static ecs_entity* live_collider(ecs_world *world, ecs_handle handle) {
+  ecs_entity *entity = ecs_entity_get(world, handle);
+  return entity && !entity->destroyed &&
+    entity->components[ECS_COMPONENT_COLLIDER] &&
+    entity->components[ECS_COMPONENT_BODY] ? entity : NULL;
+}
+
+// run the handlers two colliders have for a change in their contact. both
+// always run: destruction by the first waits for the sync point, so each
+// entity stays valid for the second
+static void run_handlers(ecs_entity *e1, ecs_collision_handler handler1,
+    ecs_entity *e2, ecs_collision_handler handler2)
+{
+  if (handler1) { handler1(e1, e2); }
+  if (handler2) { handler2(e2, e1); }
+}
+
+static int end_contacts(ecs_world *world) {
+  collision_system_state *state = world->_collision;
+  contact *last = (contact*)state->contacts->data;
+  int carried = 0;
+  // the table's slots depend only on the handles, so contacts end in the
+  // same order however detection ran
+  for (int s = 0; s < state->contacts->length; s++) {
+    contact *c = &last[s];
+    if (c->entity1 == ECS_NULL_HANDLE ||
+        find_contact(state->next_contacts, c->entity1, c->entity2, false))
+    {
+      continue;
+    }
+    ecs_entity *e1 = live_collider(world, c->entity1);
+    ecs_entity *e2 = live_collider(world, c->entity2);
+    if (!e1 || !e2) { continue; } // destroyed, so nothing left to tell
+    Collider *c1 = &e1->components[ECS_COMPONENT_COLLIDER]->collider;
+    Collider *c2 = &e2->components[ECS_COMPONENT_COLLIDER]->collider;
+    // pairs of resting colliders are never tested. if neither has moved
+    // since they last touched, they still do
+    bool rest1 = c1->stationary || c1->_idle_time >= state->sleep_delay;
+    bool rest2 = c2->stationary || c2->_idle_time >= state->sleep_delay;
+    if (rest1 && rest2 && !ecs_same_team(e1, e2) &&
+        same_box(c->hit1, ecs_entity_bounds(e1)->hit) &&
+        same_box(c->hit2, ecs_entity_bounds(e2)->hit))
+    {
+      *find_contact(state->next_contacts, c->entity1, c->entity2, true) = *c;
+      ++carried;
+      run_handlers(e1, c1->on_collision_stay, e2, c2->on_collision_stay);
+    }
+    else {
+      run_handlers(e1, c1->on_collision_exit, e2, c2->on_collision_exit);
+    }
+  }
+  return carried;
 }
 
 rectangle hitrect_from_sprite(sprite *sprite) {
@@ -54,66 +669,75 @@ rectangle hitrect_from_sprite(sprite *sprite) {
   return (rectangle) { .w = sprite_width(sprite), .h = sprite_height(sprite) };
 }
 
-static void try_boundary_collision(ecs_entity *entity, Collider *collider) {
-  ecs_component *body_comp = entity->components[ECS_COMPONENT_BODY];
-  assert(body_comp != NULL && body_comp->type == ECS_COMPONENT_BODY);
-  Body *body = &body_comp->body;
+static void try_boundary_collision(ecs_entity *entity, Body *body) {
   vector* center = &entity->position;
-  rectangle hitrect = collider->rect;
-  int left   = center->x - hitrect.w / 2;
-  int right  = center->x + hitrect.w / 2;
-  int top    = center->y - hitrect.h / 2;
-  int bottom = center->y + hitrect.h / 2;
-  if (left <= 0) {
-    center->x -= left;
+  aabb hit = ecs_entity_bounds(entity)->hit;
+  if (hit.left <= 0) {
+    center->x -= hit.left;
     body->velocity.x = 0;
   }
-  if (right >= SCREEN_W) {
-    center->x -= right - SCREEN_W;
+  if (hit.right >= SCREEN_W) {
+    center->x -= hit.right - SCREEN_W;
     body->velocity.x = 0;
   }
-  if (top <= 0) {
-    center->y -= top;
+  if (hit.top <= 0) {
+    center->y -= hit.top;
     body->velocity.y = 0;
   }
-  if (bottom >= SCREEN_H) {
-    center->y -= bottom - SCREEN_H;
+  if (hit.bottom >= SCREEN_H) {
+    center->y -= hit.bottom - SCREEN_H;
     body->velocity.y = 0;
   }
+  ecs_refresh_bounds(entity);
 }
 
-static void try_entity_collision(ecs_entity *e1, Collider *c1, ecs_entity *e2,
-    Collider *c2, double time)
+static void handle_entity_collision(const collision_event *event,
+    double time, bool enter)
 {
-  if (rect_intersect(c1->rect, c2->rect)) {
-    if (c1->elastic_collision && c2->elastic_collision) {
-      ecs_component *body_comp1 = e1->components[ECS_COMPONENT_BODY];
-      ecs_component *body_comp2 = e2->components[ECS_COMPONENT_BODY];
-      assert(body_comp1 && body_comp2);
-      Body *bod1 = &body_comp1->body;
-      Body *bod2 = &body_comp2->body;
-      double t_left = roll_back_collision(e1, bod1, c1, e2, bod2, c2, time);
-      elastic_collision(bod1, bod2);
-      e1->position = vector_add(e1->position, vector_scale(bod1->velocity, t_left));
-      e2->position = vector_add(e2->position, vector_scale(bod2->velocity, t_left));
-      // play particle effects if they exist
-      if (c1->collide_particle_effect.data != NULL) {
-        c1->collide_particle_effect.position = e1->position;
-        spawn_particles(&c1->collide_particle_effect, time, 1, ZEROVEC);
-      }
-      if (c2->collide_particle_effect.data != NULL) {
-        c2->collide_particle_effect.position = e2->position;
-        spawn_particles(&c2->collide_particle_effect, time, 1, ZEROVEC);
-      }
+  ecs_entity *e1 = event->entity1, *e2 = event->entity2;
+  Collider *c1 = &e1->components[ECS_COMPONENT_COLLIDER]->collider;
+  Collider *c2 = &e2->components[ECS_COMPONENT_COLLIDER]->collider;
+  Body *bod1 = &e1->components[ECS_COMPONENT_BODY]->body;
+  Body *bod2 = &e2->components[ECS_COMPONENT_BODY]->body;
+  // an earlier bounce this update may have moved either body, so find when
+  // they touched as they are now, and skip the bounce if they no longer do
+  vector motion1 = vector_scale(bod1->velocity, time);
+  vector motion2 = vector_scale(bod2->velocity, time);
+  double t = touch_time(ecs_entity_bounds(e1)->hit, motion1,
+      ecs_entity_bounds(e2)->hit, motion2, NULL);
+  if (c1->elastic_collision && c2->elastic_collision && t <= 1) {
+    // move both back to where they first touched, bounce, then move on
+    // for the rest of the update
+    double t_left = (1 - t) * time;
+    e1->position =
+      vector_sub(e1->position, vector_scale(bod1->velocity, t_left));
+    e2->position =
+      vector_sub(e2->position, vector_scale(bod2->velocity, t_left));
+    elastic_collision(bod1, bod2);
+    e1->position =
+      vector_add(e1->position, vector_scale(bod1->velocity, t_left));
+    e2->position =
+      vector_add(e2->position, vector_scale(bod2->velocity, t_left));
+    ecs_refresh_bounds(e1);
+    ecs_refresh_bounds(e2);
+    // play particle effects if they exist, only as the pair starts touching
+    // rather than in every update it stays in contact
+    if (enter && c1->collide_particle_effect.data != NULL) {
+      c1->collide_particle_effect.position = e1->position;
+      ecs_emit_particles(e1, &c1->collide_particle_effect, time, 1, ZEROVEC);
     }
-      // run collision handlers if they exist
-    if (c1->on_collision) {
-      c1->on_collision(e1, e2);
-    }
-    if (c2->on_collision) {
-      c2->on_collision(e2, e1);
+    if (enter && c2->collide_particle_effect.data != NULL) {
+      c2->collide_particle_effect.position = e2->position;
+      ecs_emit_particles(e2, &c2->collide_particle_effect, time, 1, ZEROVEC);
     }
   }
+  // run collision handlers if they exist
+  if (enter) {
+    run_handlers(e1, c1->on_collision, e2, c2->on_collision);
+  }
+  else {
+    run_handlers(e1, c1->on_collision_stay, e2, c2->on_collision_stay);
+  }
 }
 
 static void elastic_collision(Body *bod1, Body *bod2) {
@@ -129,30 +753,11 @@ static void elastic_collision(Body *bod1, Body *bod2) {
         vector_scale(v1, 2 * m1)), 1 / (m1 + m2));
 }
 
-static double roll_back_collision(ecs_entity *e1, Body *b1, Collider *c1,
-    ecs_entity *e2, Body *b2, Collider *c2, double elapsed_time)
+static double touch_time(aabb hit1, vector motion1, aabb hit2,
+    vector motion2, vector *normal)
 {
-  double time_left = 0; // accumulate time "regained" by rollback
-  vector v1 = b1->velocity;
-  vector v2 = b2->velocity;
-  double r1x = c1->rect.x;
-  double r1y = c1->rect.y;
-  double r2x = c2->rect.x;
-  double r2y = c2->rect.y;
-  double step = elapsed_time / rollback_granularity;
-  while (rect_intersect(c1->rect, c2->rect)) {
-    // TODO: may loop infinitely
-    time_left += step;
-    r1x -= v1.x * step;
-    r1y -= v1.y * step;
-    r2x -= v2.x * step;
-    r2y -= v2.y * step;
-    c1->rect.x = r1x;
-    c1->rect.y = r1y;
-    c2->rect.x = r2x;
-    c2->rect.y = r2y;
-  }
-  e1->position = (vector){r1x + c1->rect.w / 2, r1y + c1->rect.h / 2};
-  e2->position = (vector){r2x + c2->rect.w / 2, r2y + c2->rect.h / 2};
-  return elapsed_time;
+  // sweep the first box from where both started, relative to the second
+  return aabb_sweep(aabb_offset(hit1, vector_neg(motion1)),
+      aabb_offset(hit2, vector_neg(motion2)), vector_sub(motion1, motion2),
+      normal);
 }
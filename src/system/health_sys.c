@@ -1,44 +1,43 @@
 #include "system/health_sys.h"
 
-static double elapsed_time;
-
-static void update_health(ecs_component *health_comp) {
+// disable an entity whose hp has run out
+static void check_disabled(ecs_component *health_comp) {
   Health *health = &health_comp->health;
   if (health->hp <= 0 && health->on_disable) { // invoke disable delegate
     health->on_disable(health_comp->owner_entity);
     // set delegate to null so it is only called once
     health->on_disable = NULL;
   }
+}
+
+// emit smoke from a damaged entity
+static void update_health(ecs_component *health_comp, double elapsed_time) {
+  Health *health = &health_comp->health;
   particle_generator *gen = &health->particle_effect;
-  if (gen->data) { // update health particle effect
+  // undamaged entities emit no particles
+  if (gen->data && health->hp < health->max_hp) { // update particle effect
     ecs_entity *ent = health_comp->owner_entity;
     gen->position = ent->position;
     ecs_component *body_comp = ent->components[ECS_COMPONENT_BODY];
     vector src_vel = body_comp ? body_comp->body.velocity : ZEROVEC;
     double density = 1 - health->hp / health->max_hp;
-    spawn_particles(gen, elapsed_time, density, src_vel);
+    ecs_emit_particles(ent, gen, elapsed_time, density, src_vel);
   }
 }
 
-void health_system_fn(double time) {
-  elapsed_time = time;
-  list *components = ecs_component_store[ECS_COMPONENT_HEALTH];
-  list_node *node = components->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
-      update_health(comp);
-      node = node->next;
-    }
-    else {
-      node = list_remove(components, node, free);
-    }
+void health_system_fn(ecs_world *world, double time) {
+  ecs_component *comp;
+  // hp only drops through deal_damage, so only recheck damaged components
+  ECS_FOREACH_CHANGED(comp, world, ECS_COMPONENT_HEALTH) {
+    check_disabled(comp);
+  }
+  ECS_FOREACH(comp, world, ECS_COMPONENT_HEALTH) {
+    update_health(comp, time);
   }
-  list_each(components, (list_lambda)update_health);
 }
 
 void deal_damage(struct ecs_entity *entity, double amount) {
-  ecs_component *comp = entity->components[ECS_COMPONENT_HEALTH];
+  ecs_component *comp = ecs_write_component(entity, ECS_COMPONENT_HEALTH);
   if (comp) {  // make sure entity has a health component
     Health *health = &comp->health;
     health->hp -= amount;
@@ -1,6 +1,6 @@
 #include "system/keyboard_sys.h"
 
-void ecs_handle_keypress(ALLEGRO_EVENT ev) {
+void ecs_handle_keypress(ecs_world *world, ALLEGRO_EVENT ev) {
   bool down;
   switch (ev.type) {
     case ALLEGRO_EVENT_KEY_DOWN:
@@ -12,19 +12,16 @@ void ecs_handle_keypress(ALLEGRO_EVENT ev) {
     default:
       return;
   }
-  list *components = ecs_component_store[(int)ECS_COMPONENT_KEYBOARD_LISTENER];
-  list_node *node = components->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
-      assert(comp->type == ECS_COMPONENT_KEYBOARD_LISTENER);
-      ecs_keyboard_handler handler = comp->keyboard_listener.handler;
-      assert(handler != NULL);
-      handler(comp->owner_entity, ev.keyboard.keycode, down);
-      node = node->next;
-    }
-    else {
-      node = list_remove(components, node, free);
-    }
+  array *components =
+    world->component_store[(int)ECS_COMPONENT_KEYBOARD_LISTENER];
+  ecs_defer_begin(world); // handlers may destroy listeners yet to be visited
+  int count = components->length;
+  for (int i = 0; i < count; i++) {
+    ecs_component *comp = array_get(components, i);
+    assert(comp->type == ECS_COMPONENT_KEYBOARD_LISTENER);
+    ecs_keyboard_handler handler = comp->keyboard_listener.handler;
+    assert(handler != NULL);
+    handler(comp->owner_entity, ev.keyboard.keycode, down);
   }
+  ecs_defer_end(world);
 }
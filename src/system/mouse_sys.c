@@ -1,11 +1,11 @@
 #include "system/mouse_sys.h"
 
 static bool lmb_down, rmb_down;
-static point prev_mouse_pos = {-1, -1};
+static vector prev_mouse_pos = {-1, -1};
 
-void ecs_handle_mouse(ALLEGRO_EVENT ev) {
+void ecs_handle_mouse(ecs_world *world, ALLEGRO_EVENT ev) {
   ALLEGRO_MOUSE_EVENT mouse = ev.mouse;
-  point mousepos = {mouse.x, mouse.y};
+  vector mousepos = {mouse.x, mouse.y};
   switch (ev.type) {
     case ALLEGRO_EVENT_MOUSE_AXES:
       break;
@@ -20,35 +20,40 @@ void ecs_handle_mouse(ALLEGRO_EVENT ev) {
     default:
       return;
   }
-  list *components = ecs_component_store[(int)ECS_COMPONENT_MOUSE_LISTENER];
-  list_node *node = components->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
+  ecs_defer_begin(world); // handlers may destroy listeners yet to be visited
+  array *store = world->component_store[ECS_COMPONENT_MOUSE_LISTENER];
+  // test the mouse against the hit boxes of a batch of listeners at once.
+  // a point is inside a box when the box touches a box around just it
+  float edges[4][AABB_BATCH];
+  aabb_soa hits = { edges[0], edges[1], edges[2], edges[3] };
+  aabb cursor = aabb_around(mousepos, 0, 0);
+  aabb prev_cursor = aabb_around(prev_mouse_pos, 0, 0);
+  for (int first = 0; first < store->length; first += AABB_BATCH) {
+    int count = store->length - first;
+    if (count > AABB_BATCH) { count = AABB_BATCH; }
+    for (int i = 0; i < count; i++) {
+      ecs_component *comp = array_get(store, first + i);
+      assert(comp->type == ECS_COMPONENT_MOUSE_LISTENER);
+      aabb hit = ecs_entity_bounds(comp->owner_entity)->hit;
+      hits.left[i] = hit.left, hits.top[i] = hit.top;
+      hits.right[i] = hit.right, hits.bottom[i] = hit.bottom;
+    }
+    uint32_t inside = aabb_intersect_batch(cursor, hits, 0, count);
+    uint32_t was_inside = aabb_intersect_batch(prev_cursor, hits, 0, count);
+    for (int i = 0; i < count; i++) {
+      ecs_component *comp = array_get(store, first + i);
       MouseListener *listener = &comp->mouse_listener;
       struct ecs_entity *ent = comp->owner_entity;
-      assert(comp->type == ECS_COMPONENT_MOUSE_LISTENER);
-      // set mouse detection rect
-      listener->click_rect.x = ent->position.x - listener->click_rect.w / 2;
-      listener->click_rect.y = ent->position.y - listener->click_rect.h / 2;
+      uint32_t bit = 1u << i;
       // check if mouse just entered listener
-      if (listener->on_enter != NULL &&
-          rect_contains_point(listener->click_rect, mousepos) &&
-          !rect_contains_point(listener->click_rect, prev_mouse_pos))
-      {
+      if (listener->on_enter != NULL && (inside & ~was_inside & bit)) {
         listener->on_enter(ent);
       }
-      else if (listener->on_leave != NULL &&
-          !rect_contains_point(listener->click_rect, mousepos) &&
-          rect_contains_point(listener->click_rect, prev_mouse_pos))
-      {
+      else if (listener->on_leave != NULL && (was_inside & ~inside & bit)) {
         listener->on_leave(ent);
       }
-      node = node->next;
-    }
-    else {
-      node = list_remove(components, node, free);
     }
   }
+  ecs_defer_end(world);
   prev_mouse_pos = mousepos;
 }
@@ -1,44 +1,41 @@
 #include "system/propulsion_sys.h"
 
-static void propulsion_update(ecs_component *comp);
+static void propulsion_update(ecs_entity *ent, Propulsion *prop, Body *b,
+    double elapsed_time);
 
-static double elapsed_time;
+// every entity with both a propulsion and a body
+static const ecs_signature signature = ECS_SIGNATURE(ECS_COMPONENT_BODY) |
+  ECS_SIGNATURE(ECS_COMPONENT_PROPULSION);
 
-void propulsion_system_fn(double time) {
-  elapsed_time = time;
-  list *propulsion_list = ecs_component_store[ECS_COMPONENT_PROPULSION];
-  list_node *node = propulsion_list->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
-      propulsion_update(comp);
-      node = node->next;
-    }
-    else {
-      node = list_remove(propulsion_list, node, free);
-    }
+void propulsion_system_fn(ecs_world *world, double time) {
+  ecs_query *query = ecs_query_find(world, signature);
+  int body_col = ecs_query_column(query, ECS_COMPONENT_BODY);
+  int prop_col = ecs_query_column(query, ECS_COMPONENT_PROPULSION);
+  ecs_query_row *row;
+  ECS_QUERY_FOREACH(row, query) {
+    propulsion_update(row->entity, &row->components[prop_col]->propulsion,
+        &row->components[body_col]->body, time);
   }
 }
 
-static void propulsion_update(ecs_component *comp) {
-  assert(comp->type == ECS_COMPONENT_PROPULSION);
-  assert(comp->owner_entity != NULL);
-  assert(comp->owner_entity->components[ECS_COMPONENT_BODY] != NULL);
-  Propulsion p = comp->propulsion;
-  Body *b = &comp->owner_entity->components[ECS_COMPONENT_BODY]->body;
+static void propulsion_update(ecs_entity *ent, Propulsion *prop, Body *b,
+    double elapsed_time)
+{
+  Propulsion p = *prop;
   vector dxy = vector_scale(p.linear_throttle, p.linear_accel * elapsed_time);
   if (p.directed) {
-    dxy = vector_rotate(dxy, comp->owner_entity->angle);
+    dxy = vector_rotate(dxy, ent->angle);
   }
   b->velocity = vector_add(b->velocity, dxy);
-  comp->owner_entity->angle += p.turn_rate * p.angular_throttle * elapsed_time;
-  comp->owner_entity->angle = normalize_angle(comp->owner_entity->angle);
+  ent->angle += p.turn_rate * p.angular_throttle * elapsed_time;
+  ent->angle = normalize_angle(ent->angle);
   // handle particle effect
   if (p.particle_effect.data != NULL) {
     //spawn in opposite direction of entity
-    p.particle_effect.angle = comp->owner_entity->angle + PI;
-    p.particle_effect.position = comp->owner_entity->position;
-    spawn_particles(&p.particle_effect, elapsed_time, 1.0, b->velocity);
+    p.particle_effect.angle = ent->angle + PI;
+    p.particle_effect.position = ent->position;
+    ecs_emit_particles(ent, &p.particle_effect, elapsed_time, 1.0,
+        b->velocity);
   }
 }
 
@@ -2,6 +2,8 @@
 
 #include "system/scenery_sys.h"
 #include "util/al_helper.h"
+#include "prefab.h"
+#include "snapshot.h"
 
 const static vector cloud_min_scale = {1, 0.5};
 const static vector cloud_max_scale = {45, 15};
@@ -12,108 +14,146 @@ const static int cloud_max_depth = 3;
 const static double cloud_min_opacity = 0.1;
 const static double cloud_max_opacity = 0.8;
 
-// spawn a cloud every cloud_delay seconds
-static double cloud_delay = 0.5;
-static double cloud_timer;
+// initial number of seconds between cloud spawns
+const static double default_cloud_delay = 0.5;
 
 // mountain settings
 enum { NUM_MOUNTAIN_SPAWNERS = 2 };
 
 struct mountain_spawner {
   const vector min_scale, max_scale;
-  const int depth;
   const double speed;
   const double density;
-  const char *sprite_name;
-  double timer;
+  const char *prefab_name; // section of sprite.cfg describing the mountain
 };
 
-static struct mountain_spawner mountain_spawners[NUM_MOUNTAIN_SPAWNERS] = {
+static const struct mountain_spawner
+mountain_spawners[NUM_MOUNTAIN_SPAWNERS] = {
   {
     .min_scale = { 0.5, 0.8 },
     .max_scale = { 2.0, 3.0 },
-    .depth = -4,
     .speed = 50,
     .density = 2.5,
-    .sprite_name = "mountain"
+    .prefab_name = "mountain"
   },
   {
     .min_scale = { 0.5, 0.7 },
     .max_scale = { 1.8, 2.4 },
-    .depth = -3,
     .speed = 60,
     .density = 3,
-    .sprite_name = "mountain-fg"
+    .prefab_name = "mountain-fg"
   }
 };
 
-static void make_cloud();
-static ecs_entity* make_mountain(struct mountain_spawner *spawner);
+// spawn timers of one world, and the blueprints it spawns from
+typedef struct scenery_system_state {
+  double cloud_delay; // spawn a cloud every cloud_delay seconds
+  double cloud_timer;
+  double mountain_timers[NUM_MOUNTAIN_SPAWNERS];
+  prefab *cloud_prefab;
+  prefab *mountain_prefabs[NUM_MOUNTAIN_SPAWNERS];
+} scenery_system_state;
 
-void scenery_system_fn(double time) {
-  cloud_timer -= time;
-  if (cloud_timer <= 0) {
-    make_cloud();
-    cloud_timer = cloud_delay;
+// arguments of scenery_make_explosion, copied by ecs_call_synced
+typedef struct explosion_args {
+  vector pos, size;
+  double anim_rate;
+  ALLEGRO_COLOR tint;
+  const char *sound_name;
+} explosion_args;
+
+static void make_cloud(ecs_world *world);
+// create the explosion described by an explosion_args
+static void make_explosion(ecs_world *world, const void *args);
+// spawn a mountain from the spawner at index idx
+static ecs_entity* make_mountain(ecs_world *world, int idx);
+
+void scenery_system_init(ecs_world *world) {
+  scenery_system_state *state = calloc(1, sizeof(scenery_system_state));
+  state->cloud_delay = default_cloud_delay;
+  // found up front, so updates only read the prefabs
+  state->cloud_prefab = prefab_get("cloud");
+  assert(state->cloud_prefab != NULL);
+  for (int i = 0; i < NUM_MOUNTAIN_SPAWNERS; i++) {
+    state->mountain_prefabs[i] = prefab_get(mountain_spawners[i].prefab_name);
+    assert(state->mountain_prefabs[i] != NULL);
+  }
+  world->_scenery = state;
+}
+
+void scenery_system_shutdown(ecs_world *world) {
+  free(world->_scenery);
+  world->_scenery = NULL;
+}
+
+void scenery_system_fn(ecs_world *world, double time) {
+  scenery_system_state *state = world->_scenery;
+  state->cloud_timer -= time;
+  if (state->cloud_timer <= 0) {
+    make_cloud(world);
+    state->cloud_timer = state->cloud_delay;
   }
   for (int i = 0; i < NUM_MOUNTAIN_SPAWNERS; i++) {
-    if ((mountain_spawners[i].timer -= time) < 0) {
-      make_mountain(&mountain_spawners[i]);
+    if ((state->mountain_timers[i] -= time) < 0) {
+      make_mountain(world, i);
     }
   }
 }
 
-void scenery_pre_populate() {
+void scenery_pre_populate(ecs_world *world) {
   for (int i = 0; i < NUM_MOUNTAIN_SPAWNERS; i++) {
-    struct mountain_spawner *spawner = &mountain_spawners[i];
+    const struct mountain_spawner *spawner = &mountain_spawners[i];
     int x = 0;
     while (x < SCREEN_W) {
-      ecs_entity *mountain = make_mountain(spawner);
+      ecs_entity *mountain = make_mountain(world, i);
       mountain->position.x = x;
       x += sprite_width(mountain->sprite) / 2 / spawner->density;
-      spawner->timer = 0;
+      world->_scenery->mountain_timers[i] = 0;
     }
   }
 }
 
 /** set frequency at which clouds spawn */
-void scenery_sys_set_cloud_frequency(double clouds_per_sec) {
+void scenery_sys_set_cloud_frequency(ecs_world *world, double clouds_per_sec)
+{
   assert(clouds_per_sec != 0);
-  cloud_delay = 1 / cloud_max_depth;
+  world->_scenery->cloud_delay = 1 / cloud_max_depth;
 }
 
-void scenery_add_background(const char *name, int depth, double speed, int
-    offset)
+void scenery_add_background(ecs_world *world, const char *name, int depth,
+    double speed, int offset)
 {
-  ecs_entity *bg = ecs_entity_new((vector){SCREEN_W / 2 + offset, SCREEN_H / 2},
-      ENTITY_SCENIC);
+  ecs_entity *bg = ecs_entity_new(world,
+      (vector){SCREEN_W / 2 + offset, SCREEN_H / 2}, ENTITY_SCENIC);
   ecs_attach_sprite(bg, name, depth);
   Body *body = &ecs_add_component(bg, ECS_COMPONENT_BODY)->body;
   make_constant_vel_body(body, (vector){-speed, 0});
 }
 
-static void make_cloud() {
+static void make_cloud(ecs_world *world) {
   double start_y = randd(0, SCREEN_H);
   double start_x = SCREEN_W + 200;
   int depth = randi(cloud_min_depth, cloud_max_depth);
   double speed = -randd(cloud_min_speed, cloud_max_speed);
   double alpha = randd(cloud_min_opacity, cloud_max_opacity);
-  ecs_entity *cloud = ecs_entity_new((vector){.x = start_x, .y = start_y},
-      ENTITY_SCENIC);
-  sprite* s = ecs_attach_sprite(cloud, "cloud", depth);
+  ecs_entity *cloud = prefab_spawn(world, world->_scenery->cloud_prefab,
+      (vector){.x = start_x, .y = start_y});
+  sprite* s = cloud->sprite;
+  sprite_set_depth(s, depth);
   s->scale = (vector){
     randd(cloud_min_scale.x, cloud_max_scale.y),
     randd(cloud_min_scale.x, cloud_max_scale.y)
   };
   s->tint.a = alpha;
-  Body *body = &ecs_add_component(cloud, ECS_COMPONENT_BODY)->body;
+  Body *body = &cloud->components[ECS_COMPONENT_BODY]->body;
   make_constant_vel_body(body, (vector){speed, 0});
-  body->destroy_on_exit = WEST;
 }
 
-static ecs_entity* make_mountain(struct mountain_spawner *spawner) {
-  ecs_entity *mountain = ecs_entity_new(ZEROVEC, ENTITY_SCENIC);
-  sprite* s = ecs_attach_sprite(mountain, spawner->sprite_name, spawner->depth);
+static ecs_entity* make_mountain(ecs_world *world, int idx) {
+  const struct mountain_spawner *spawner = &mountain_spawners[idx];
+  ecs_entity *mountain =
+    prefab_spawn(world, world->_scenery->mountain_prefabs[idx], ZEROVEC);
+  sprite* s = mountain->sprite;
   s->scale = (vector){
     randd(spawner->min_scale.x, spawner->max_scale.x),
     randd(spawner->min_scale.y, spawner->max_scale.y)
@@ -122,23 +162,38 @@ static ecs_entity* make_mountain(struct mountain_spawner *spawner) {
     SCREEN_W + sprite_width(s) / 2,
     SCREEN_H - sprite_height(s) / 2
   };
-  Body *body = &ecs_add_component(mountain, ECS_COMPONENT_BODY)->body;
+  Body *body = &mountain->components[ECS_COMPONENT_BODY]->body;
   make_constant_vel_body(body, (vector){-spawner->speed, 0});
-  body->destroy_on_exit = WEST;
-  spawner->timer = sprite_width(s) / spawner->speed / spawner->density;
+  world->_scenery->mountain_timers[idx] =
+    sprite_width(s) / spawner->speed / spawner->density;
   return mountain;
 }
 
-void scenery_make_explosion(vector pos, vector size, double anim_rate,
-    ALLEGRO_COLOR tint, const char *sound_name)
+void scenery_make_explosion(ecs_world *world, vector pos, vector size,
+    double anim_rate, ALLEGRO_COLOR tint, const char *sound_name)
 {
-  ecs_entity *boom = ecs_entity_new(pos, ENTITY_EXPLOSION);
+  explosion_args args = { .pos = pos, .size = size, .anim_rate = anim_rate,
+    .tint = tint, .sound_name = sound_name };
+  ecs_call_synced(world, NULL, make_explosion, &args, sizeof(args));
+}
+
+static void make_explosion(ecs_world *world, const void *args) {
+  const explosion_args *ex = args;
+  ecs_entity *boom = ecs_entity_new(world, ex->pos, ENTITY_EXPLOSION);
   sprite *anim = ecs_attach_animation(boom, "explosion", 1, 32, 32,
-      anim_rate, ANIMATE_ONCE);
-  anim->scale = size;
-  anim->tint = tint;
-  al_game_play_sound(sound_name, false); // false: dont loop
+      ex->anim_rate, ANIMATE_ONCE);
+  anim->scale = ex->size;
+  anim->tint = ex->tint;
+  ecs_play_sound(world, boom, ex->sound_name);
   Timer *t = &ecs_add_component(boom, ECS_COMPONENT_TIMER)->timer;
-  t->time_left =  sprite_num_frames(anim) / anim_rate;
+  t->time_left =  sprite_num_frames(anim) / ex->anim_rate;
   t->timer_action = ecs_entity_free;
 }
+
+void scenery_system_save(ecs_world *world, snapshot *snap) {
+  snapshot_write(snap, world->_scenery, sizeof(scenery_system_state));
+}
+
+void scenery_system_load(ecs_world *world, snapshot *snap) {
+  snapshot_read(snap, world->_scenery, sizeof(scenery_system_state));
+}
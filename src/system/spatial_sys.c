@@ -0,0 +1,120 @@
+#include <assert.h>
+#include "system/spatial_sys.h"
+#include "util/point_grid.h"
+
+// positions of a world's entities as of the start of the update
+typedef struct spatial_system_state {
+  point_grid *grid;
+  array *handles; // ecs_handle of the entity with each id in the grid
+  array *points;  // vector position of each entity when it was listed
+} spatial_system_state;
+
+// what a query's filter checks an id against
+typedef struct spatial_search {
+  ecs_world *world;
+  const ecs_handle *handles;
+  ecs_spatial_filter filter;
+  ecs_entity **out; // where ecs_query_radius writes what it finds
+  int max, found;
+} spatial_search;
+
+void spatial_system_init(ecs_world *world) {
+  spatial_system_state *state = malloc(sizeof(spatial_system_state));
+  *state = (spatial_system_state){
+    .grid = point_grid_new((aabb){ 0, 0, SCREEN_W, SCREEN_H },
+        SPATIAL_CELL_SIZE, world->_entity_capacity),
+    .handles = array_new(sizeof(ecs_handle), world->_entity_capacity),
+    .points = array_new(sizeof(vector), world->_entity_capacity)
+  };
+  world->_spatial = state;
+}
+
+void spatial_system_shutdown(ecs_world *world) {
+  spatial_system_state *state = world->_spatial;
+  point_grid_free(state->grid);
+  array_free(state->handles);
+  array_free(state->points);
+  free(state);
+  world->_spatial = NULL;
+}
+
+void spatial_system_fn(ecs_world *world, double time) {
+  spatial_system_state *state = world->_spatial;
+  // the tag sets hold every live entity once
+  int count = 0;
+  for (int t = 0; t < NUM_ENTITY_TAGS; t++) {
+    count += ecs_tag_count(world, t);
+  }
+  if (count > state->handles->capacity) {
+    array_reserve(state->handles, 2 * count);
+    array_reserve(state->points, 2 * count);
+  }
+  ecs_handle *handles = (ecs_handle*)state->handles->data;
+  vector *points = (vector*)state->points->data;
+  int id = 0;
+  for (int t = 0; t < NUM_ENTITY_TAGS; t++) {
+    for (int i = 0; i < ecs_tag_count(world, t); i++, id++) {
+      ecs_entity *entity = ecs_tag_get(world, t, i);
+      handles[id] = entity->handle;
+      points[id] = entity->position;
+    }
+  }
+  state->handles->length = state->points->length = count;
+  point_grid_build(state->grid, points, count);
+}
+
+// true if the entity listed with an id may be found by a query
+static bool accept(void *ctx, int id) {
+  spatial_search *search = ctx;
+  ecs_entity *entity = ecs_entity_get(search->world, search->handles[id]);
+  ecs_spatial_filter *filter = &search->filter;
+  return entity && !entity->destroyed && entity != filter->exclude &&
+    (!filter->tags || (filter->tags & ECS_TAG_BIT(entity->tag))) &&
+    (!filter->teams || (filter->teams & ECS_TEAM_BIT(entity->team)));
+}
+
+// write out an entity within range if the query accepts it and there is
+// room
+static void collect(void *ctx, int id) {
+  spatial_search *search = ctx;
+  if (!accept(ctx, id)) { return; }
+  if (search->found < search->max) {
+    search->out[search->found] =
+      ecs_entity_get(search->world, search->handles[id]);
+  }
+  ++search->found;
+}
+
+int ecs_query_radius(ecs_world *world, vector center, double radius,
+    ecs_spatial_filter filter, ecs_entity **out, int max)
+{
+  spatial_system_state *state = world->_spatial;
+  spatial_search search = { .world = world, .filter = filter, .out = out,
+    .max = max, .handles = (ecs_handle*)state->handles->data };
+  point_grid_visit_radius(state->grid, center, radius, collect, &search);
+  return search.found;
+}
+
+ecs_entity* ecs_query_nearest(ecs_world *world, vector center,
+    double radius, ecs_spatial_filter filter)
+{
+  ecs_entity *nearest;
+  return ecs_query_knn(world, center, radius, 1, filter, &nearest) ?
+    nearest : NULL;
+}
+
+int ecs_query_knn(ecs_world *world, vector center, double radius, int k,
+    ecs_spatial_filter filter, ecs_entity **out)
+{
+  assert(k <= ECS_QUERY_MAX_K);
+  spatial_system_state *state = world->_spatial;
+  spatial_search search = { .world = world, .filter = filter,
+    .handles = (ecs_handle*)state->handles->data };
+  int ids[ECS_QUERY_MAX_K];
+  int found = point_grid_nearest(state->grid, center, radius, k, accept,
+      &search, ids);
+  for (int i = 0; i < found; i++) {
+    out[i] = ecs_entity_get(world, search.handles[ids[i]]);
+  }
+  return found;
+}
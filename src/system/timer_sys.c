@@ -1,8 +1,6 @@
 #include "system/timer_sys.h"
 
-static double elapsed_time;
-
-static void update_timer(ecs_component *timer_comp) {
+static void update_timer(ecs_component *timer_comp, double elapsed_time) {
   Timer *timer = &timer_comp->timer;
   ecs_entity *ent = timer_comp->owner_entity;
   timer->time_left -= elapsed_time;
@@ -11,18 +9,10 @@ static void update_timer(ecs_component *timer_comp) {
   }
 }
 
-void timer_system_fn(double time) {
-  elapsed_time = time;
-  list *timers = ecs_component_store[ECS_COMPONENT_TIMER];
-  list_node *node = timers->head;
-  while (node) {
-    ecs_component *comp = node->value;
-    if (comp->active) {
-      update_timer(comp);
-      node = node->next;
-    }
-    else {
-      node = list_remove(timers, node, free);
-    }
+void timer_system_fn(ecs_world *world, double time) {
+  // timer actions may add timers - those wait until the next update
+  ecs_component *comp;
+  ECS_FOREACH(comp, world, ECS_COMPONENT_TIMER) {
+    update_timer(comp, time);
   }
 }
@@ -1,127 +1,233 @@
 #include "system/weapon_sys.h"
+#include "prefab.h"
+#include "snapshot.h"
 
 // lockon constants
 static const float indicator_radius = 18;
 static const float indicator_thickness = 5;
 // grace period after launching during which a projectile cannot hit friendlies
 static const double friendly_fire_time = 2;
-// flare's effect area
-static const double flare_radius = 250;
+// distance from a flare within which missiles chase it
+static const double flare_radius = 125;
 #define PRIMARY_LOCK_COLOR al_map_rgba(0, 128, 0, 200)
 #define SECONDARY_LOCK_COLOR al_map_rgba(0, 0, 128, 128)
 
 // explosion constants
 static const double explosion_animate_rate = 50; // frames/sec
 
-static struct ecs_entity *current_target;
-static struct ecs_entity *player_entity;
-static double current_lockon_time;
-static list *lockon_list;
-static Weapon *current_weapon, *alternate_weapon;
-static WeaponState current_weapon_state = WEAPON_READY;
-static double till_next_fire;
+// arguments of fire_at_target, copied by ecs_call_synced
+typedef struct fire_args {
+  ecs_handle fired_by, target;
+  double firing_angle;
+} fire_args;
 
+// targeting and firing state of one world
+typedef struct weapon_system_state {
+  ecs_handle current_target;
+  ecs_handle player_entity;
+  double current_lockon_time;
+  array *lockon_list; // handles of locked targets, fired at from the end
+  Weapon *current_weapon, *alternate_weapon;
+  WeaponState current_weapon_state;
+  double till_next_fire;
+} weapon_system_state;
+
+// blueprint for a weapon's projectiles, built on its first launch
+static prefab* projectile_prefab(Weapon *weapon);
+// fire a projectile, or queue the launch (see ecs_call_synced)
 static void fire_at_target(struct ecs_entity *fired_by,
     struct ecs_entity *target, double firing_angle);
+// launch the projectile described by a fire_args
+static void launch_projectile(ecs_world *world, const void *args);
 static void draw_lockon(struct ecs_entity *target, int lockon_count);
+// remove and return the most recent lockon that still exists, or NULL
+static struct ecs_entity* pop_lockon(ecs_world *world);
 // collision handler for projectile
 static void hit_target(struct ecs_entity *projectile, struct ecs_entity *target);
 // blow up a projectile
 static void explode(struct ecs_entity *projectile);
+// send missiles after the nearest flare within reach
+static void distract_missiles(ecs_world *world);
 // timer trigger to swich projectile team to neutral
 static void friendly_fire_timer_fn(struct ecs_entity *projectile);
 
-void weapon_system_fn(double time) {
-  if (current_target) {
-    current_lockon_time += time;
-    if (current_lockon_time > current_weapon->lockon_time) {
-      list_push(lockon_list, current_target);
-      weapon_clear_target(current_target);
+void weapon_system_init(ecs_world *world) {
+  weapon_system_state *state = malloc(sizeof(weapon_system_state));
+  *state = (weapon_system_state){
+    .lockon_list = array_new(sizeof(ecs_handle), 0),
+    .current_weapon_state = WEAPON_READY
+  };
+  world->_weapons = state;
+}
+
+void weapon_system_shutdown(ecs_world *world) {
+  array_free(world->_weapons->lockon_list);
+  free(world->_weapons);
+  world->_weapons = NULL;
+}
+
+void weapon_system_fn(ecs_world *world, double time) {
+  weapon_system_state *state = world->_weapons;
+  if (state->current_target) {
+    if (!ecs_entity_get(world, state->current_target)) {
+      state->current_target = ECS_NULL_HANDLE; // target destroyed mid-lockon
+    }
+    else if ((state->current_lockon_time += time) >
+        state->current_weapon->lockon_time)
+    {
+      *(ecs_handle*)array_push(state->lockon_list) = state->current_target;
+      state->current_lockon_time = 0;
+      state->current_target = ECS_NULL_HANDLE;
     }
   }
-  
-  if (current_weapon_state == WEAPON_FIRING) {
-    till_next_fire -= time;
-    if (till_next_fire < 0 && lockon_list->length > 0) {
-      till_next_fire = current_weapon->fire_delay;
-      struct ecs_entity *target = list_popfront(lockon_list);
-      fire_at_target(player_entity, target, -PI / 2);
-      if (lockon_list->length == 0) { // fired at last lockon
-        current_weapon_state = WEAPON_READY;
+
+  if (state->current_weapon_state == WEAPON_FIRING) {
+    state->till_next_fire -= time;
+    if (state->till_next_fire < 0 && state->lockon_list->length > 0) {
+      struct ecs_entity *target = pop_lockon(world);
+      struct ecs_entity *player = ecs_entity_get(world, state->player_entity);
+      if (target && player) {
+        state->till_next_fire = state->current_weapon->fire_delay;
+        fire_at_target(player, target, -PI / 2);
+      }
+      if (state->lockon_list->length == 0) { // fired at last lockon
+        state->current_weapon_state = WEAPON_READY;
       }
     }
   }
+  distract_missiles(world);
 }
 
-void weapon_system_draw() {
-  if (current_target) {
-    al_draw_arc(current_target->position.x, current_target->position.y,
+void weapon_system_draw(ecs_world *world) {
+  weapon_system_state *state = world->_weapons;
+  ecs_entity *target = ecs_entity_get(world, state->current_target);
+  if (target) {
+    al_draw_arc(target->position.x, target->position.y,
         indicator_radius, 0,
-        2 * PI * current_lockon_time / current_weapon->lockon_time,
+        2 * PI * state->current_lockon_time /
+        state->current_weapon->lockon_time,
         PRIMARY_LOCK_COLOR, indicator_thickness);
   }
-  if (lockon_list) {
-    list *already_drawn = list_new();
-    for (list_node *node = lockon_list->head; node; node = node->next) {
-      ecs_entity *target = node->value;
-      if (list_find(already_drawn, target)) { continue; }
-      list_push(already_drawn, target);
-      draw_lockon(target, list_count(lockon_list, target));
+  array *lockon_list = state->lockon_list;
+  ecs_handle *lockons = (ecs_handle*)lockon_list->data;
+  for (int i = 0; i < lockon_list->length; i++) {
+    // draw each target once, at the first of its lockons
+    int count = 1, j = 0;
+    for (; j < i && lockons[j] != lockons[i]; j++);
+    if (j < i) { continue; }
+    for (j = i + 1; j < lockon_list->length; j++) {
+      if (lockons[j] == lockons[i]) { ++count; }
+    }
+    if ((target = ecs_entity_get(world, lockons[i]))) {
+      draw_lockon(target, count);
     }
-    list_free(already_drawn, NULL);
   }
 }
 
 void weapon_set_target(struct ecs_entity *target) {
-  if (current_target == NULL) {
-    current_lockon_time = 0;  // new target
-    current_target = target;
+  weapon_system_state *state = target->world->_weapons;
+  if (!ecs_entity_get(target->world, state->current_target)) {
+    state->current_lockon_time = 0;  // new target
+    state->current_target = target->handle;
   }
 }
 
 void weapon_clear_target(struct ecs_entity *target) {
-  if (current_target == target) {
-    current_lockon_time = 0;  // new target
-    current_target = NULL;
+  weapon_system_state *state = target->world->_weapons;
+  if (state->current_target == target->handle) {
+    state->current_lockon_time = 0;  // new target
+    state->current_target = ECS_NULL_HANDLE;
   }
 }
 
-void weapon_system_set_weapons(struct ecs_entity *player, Weapon *wep1, Weapon *wep2) {
-  if (!lockon_list) { lockon_list = list_new(); }
-  player_entity = player;
-  current_weapon = wep1;
-  alternate_weapon = wep2;
+void weapon_system_set_weapons(struct ecs_entity *player, Weapon *wep1,
+    Weapon *wep2)
+{
+  weapon_system_state *state = player->world->_weapons;
+  int max_lockons = wep1->max_lockons;
+  if (wep2 && wep2->max_lockons > max_lockons) {
+    max_lockons = wep2->max_lockons;
+  }
+  array_reserve(state->lockon_list, max_lockons);
+  state->player_entity = player->handle;
+  state->current_weapon = wep1;
+  state->alternate_weapon = wep2;
+  // build blueprints now rather than on first launch
+  projectile_prefab(wep1);
+  if (wep2) { projectile_prefab(wep2); }
 }
 
-void weapon_fire_player() {
-  if (current_weapon_state == WEAPON_READY) {
-    if (current_weapon->fire_fn) { // special firing function
-      current_weapon->fire_fn(player_entity);
+void weapon_system_save(ecs_world *world, snapshot *snap) {
+  weapon_system_state *state = world->_weapons;
+  array *lockon_list = state->lockon_list;
+  snapshot_write(snap, &state->current_target, sizeof(ecs_handle));
+  snapshot_write(snap, &state->player_entity, sizeof(ecs_handle));
+  snapshot_write(snap, &state->current_lockon_time, sizeof(double));
+  snapshot_write(snap, &lockon_list->length, sizeof(lockon_list->length));
+  snapshot_write(snap, lockon_list->data,
+      lockon_list->length * sizeof(ecs_handle));
+  snapshot_write(snap, &state->current_weapon, sizeof(Weapon*));
+  snapshot_write(snap, &state->alternate_weapon, sizeof(Weapon*));
+  snapshot_write(snap, &state->current_weapon_state, sizeof(WeaponState));
+  snapshot_write(snap, &state->till_next_fire, sizeof(double));
+}
+
+void weapon_system_load(ecs_world *world, snapshot *snap) {
+  weapon_system_state *state = world->_weapons;
+  int num_lockons;
+  snapshot_read(snap, &state->current_target, sizeof(ecs_handle));
+  snapshot_read(snap, &state->player_entity, sizeof(ecs_handle));
+  snapshot_read(snap, &state->current_lockon_time, sizeof(double));
+  snapshot_read(snap, &num_lockons, sizeof(num_lockons));
+  array_clear(state->lockon_list);
+  for (int i = 0; i < num_lockons; i++) {
+    snapshot_read(snap, array_push(state->lockon_list), sizeof(ecs_handle));
+  }
+  snapshot_read(snap, &state->current_weapon, sizeof(Weapon*));
+  snapshot_read(snap, &state->alternate_weapon, sizeof(Weapon*));
+  snapshot_read(snap, &state->current_weapon_state, sizeof(WeaponState));
+  snapshot_read(snap, &state->till_next_fire, sizeof(double));
+}
+
+void weapon_fire_player(ecs_world *world) {
+  weapon_system_state *state = world->_weapons;
+  ecs_entity *player = ecs_entity_get(world, state->player_entity);
+  if (player && state->current_weapon_state == WEAPON_READY) {
+    if (state->current_weapon->fire_fn) { // special firing function
+      state->current_weapon->fire_fn(player);
     }
     else { // standard firing function
-      current_weapon_state = WEAPON_FIRING;
+      state->current_weapon_state = WEAPON_FIRING;
     }
   }
 }
 
 static void swarmer_burst_fn(struct ecs_entity *pod) {
-  ecs_entity *target;
-  while ((target = list_popfront(lockon_list))) {
-    fire_at_target(pod, target, randd(0, 2 * PI));
+  ecs_world *world = pod->world;
+  array *lockon_list = world->_weapons->lockon_list;
+  // grow storage once for the whole burst
+  prefab *projectile = projectile_prefab(world->_weapons->current_weapon);
+  ecs_reserve(world, projectile->signature, lockon_list->length);
+  while (lockon_list->length > 0) {
+    ecs_entity *target = pop_lockon(world);
+    if (target) { fire_at_target(pod, target, randd(0, 2 * PI)); }
   }
   explode(pod);
 }
 
 void fire_swarmer_pod(struct ecs_entity *firing_entity) {
-  vector fire_pos = vector_add(firing_entity->position, current_weapon->offset);
-  struct ecs_entity *pod = ecs_entity_new(firing_entity->position, ENTITY_MISSILE);
+  ecs_world *world = firing_entity->world;
+  vector fire_pos = vector_add(firing_entity->position,
+      world->_weapons->current_weapon->offset);
+  struct ecs_entity *pod = ecs_entity_new(world, firing_entity->position,
+      ENTITY_MISSILE);
   pod->position = fire_pos;
   ecs_attach_sprite(pod, "swarmer-pod", 0);
   Body *b = &ecs_add_component(pod, ECS_COMPONENT_BODY)->body;
   b->velocity = (vector){-100, 0};
   b->max_linear_velocity = 100;
   b->deceleration_factor = 0.5;
-  pod->team = firing_entity->team;
+  ecs_set_team(pod, firing_entity->team);
   Timer *timer = &ecs_add_component(pod, ECS_COMPONENT_TIMER)->timer;
   timer->time_left = 1.2;
   timer->timer_action = swarmer_burst_fn;
@@ -131,94 +237,137 @@ void weapon_fire_enemy(struct ecs_entity *enemy, void *player) {
   fire_at_target(enemy, (struct ecs_entity*)player, -PI / 2);
 }
 
-void weapon_swap() {
-  if (alternate_weapon) {
-    Weapon *temp = current_weapon;
-    current_weapon = alternate_weapon;
-    alternate_weapon = temp;
-    list_clear(lockon_list, NULL);
-    weapon_clear_target(current_target);
+void weapon_swap(ecs_world *world) {
+  weapon_system_state *state = world->_weapons;
+  if (state->alternate_weapon) {
+    Weapon *temp = state->current_weapon;
+    state->current_weapon = state->alternate_weapon;
+    state->alternate_weapon = temp;
+    array_clear(state->lockon_list);
+    state->current_lockon_time = 0;
+    state->current_target = ECS_NULL_HANDLE;
   }
 }
 
-static void fire_at_target(struct ecs_entity *firing_entity,
-    struct ecs_entity *target, double firing_angle)
-{
-  vector fire_pos = vector_add(firing_entity->position, current_weapon->offset);
-  struct ecs_entity *projectile = ecs_entity_new(firing_entity->position, ENTITY_MISSILE);
-  projectile->position = fire_pos;
-  projectile->angle = firing_angle;
-  ecs_attach_sprite(projectile, current_weapon->name, 0);
-  Body *b = &ecs_add_component(projectile, ECS_COMPONENT_BODY)->body;
-  b->velocity = current_weapon->initial_velocity;
-  b->max_linear_velocity = current_weapon->max_speed;
-  b->deceleration_factor = current_weapon->deceleration_factor;
-  Propulsion *p =
-    &ecs_add_component(projectile, ECS_COMPONENT_PROPULSION)->propulsion;
-  p->linear_accel = current_weapon->acceleration;
-  p->turn_rate = current_weapon->turn_rate;
-  p->particle_effect =
-    get_particle_generator((char*)current_weapon->particle_effect);
-  p->directed = true;
-  Behavior *behavior = &ecs_add_component(projectile,
+static prefab* projectile_prefab(Weapon *weapon) {
+  if (weapon->_projectile != NULL) { return weapon->_projectile; }
+  prefab *p = weapon->_projectile = prefab_new(weapon->name, ENTITY_MISSILE);
+  prefab_set_sprite(p, weapon->name, 0);
+  Body *b = &prefab_add_component(p, ECS_COMPONENT_BODY)->body;
+  b->velocity = weapon->initial_velocity;
+  b->max_linear_velocity = weapon->max_speed;
+  b->deceleration_factor = weapon->deceleration_factor;
+  Propulsion *prop =
+    &prefab_add_component(p, ECS_COMPONENT_PROPULSION)->propulsion;
+  prop->linear_accel = weapon->acceleration;
+  prop->turn_rate = weapon->turn_rate;
+  prop->particle_effect =
+    get_particle_generator((char*)weapon->particle_effect);
+  prop->directed = true;
+  Behavior *behavior = &prefab_add_component(p,
       ECS_COMPONENT_BEHAVIOR)->behavior;
-  behavior->target = target;
   behavior->type = BEHAVIOR_FOLLOW;
-  Collider *collider = &ecs_add_component(projectile,
+  Collider *collider = &prefab_add_component(p,
       ECS_COMPONENT_COLLIDER)->collider;
-  collider->rect = hitrect_from_sprite(projectile->sprite);
+  collider->rect = hitrect_from_sprite(&p->sprite);
   collider->on_collision = hit_target;
-  projectile->team = firing_entity->team;
-  Timer *timer = &ecs_add_component(projectile, ECS_COMPONENT_TIMER)->timer;
+  collider->category = COLLIDE_MISSILE;
+  collider->mask = COLLIDE_ALL; // hit anything
+  Timer *timer = &prefab_add_component(p, ECS_COMPONENT_TIMER)->timer;
   timer->time_left = friendly_fire_time;
   timer->timer_action = friendly_fire_timer_fn;
   // mouse listener (for weapon lockon)
   MouseListener *listener =
-    &ecs_add_component(projectile, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
-  listener->click_rect = collider->rect;
+    &prefab_add_component(p, ECS_COMPONENT_MOUSE_LISTENER)->mouse_listener;
   listener->on_enter = weapon_set_target;
-  listener->on_leave = weapon_clear_target; // make small explosion for launch
-  scenery_make_explosion(fire_pos, (vector){1,2}, 50, al_map_rgb_f(1,1,1), "launch");
+  listener->on_leave = weapon_clear_target;
+  return p;
+}
+
+static void fire_at_target(struct ecs_entity *fired_by,
+    struct ecs_entity *target, double firing_angle)
+{
+  fire_args args = { .fired_by = fired_by->handle, .target = target->handle,
+    .firing_angle = firing_angle };
+  ecs_call_synced(fired_by->world, fired_by, launch_projectile, &args,
+      sizeof(args));
+}
+
+static void launch_projectile(ecs_world *world, const void *args) {
+  const fire_args *fire = args;
+  ecs_entity *firing_entity = ecs_entity_get(world, fire->fired_by);
+  if (!firing_entity || !ecs_entity_get(world, fire->target)) { return; }
+  Weapon *weapon = world->_weapons->current_weapon;
+  vector fire_pos = vector_add(firing_entity->position, weapon->offset);
+  struct ecs_entity *projectile =
+    prefab_spawn(world, projectile_prefab(weapon), fire_pos);
+  projectile->angle = fire->firing_angle;
+  projectile->components[ECS_COMPONENT_BEHAVIOR]->behavior.target =
+    fire->target;
+  ecs_set_team(projectile, firing_entity->team);
+  // make small explosion for launch
+  scenery_make_explosion(world, fire_pos, (vector){1,2}, 50,
+      al_map_rgb_f(1,1,1), "launch");
+}
+
+static struct ecs_entity* pop_lockon(ecs_world *world) {
+  array *lockon_list = world->_weapons->lockon_list;
+  ecs_handle target = *(ecs_handle*)array_get(lockon_list,
+      lockon_list->length - 1);
+  array_swap_remove(lockon_list, lockon_list->length - 1);
+  return ecs_entity_get(world, target);
 }
 
 static void draw_lockon(struct ecs_entity *target, int lockon_count) {
-  Collider *collider = &target->components[ECS_COMPONENT_COLLIDER]->collider;
   // draw lockon rect
-  if (collider) {
-    rectangle r = collider->rect;
-    al_draw_rounded_rectangle(r.x, r.y, r.x + r.w, r.y + r.h, 1, 1, PRIMARY_LOCK_COLOR, 3);
+  if (target->components[ECS_COMPONENT_COLLIDER]) {
+    aabb r = ecs_entity_bounds(target)->hit;
+    al_draw_rounded_rectangle(r.left, r.top, r.right, r.bottom, 1, 1,
+        PRIMARY_LOCK_COLOR, 3);
     // draw lock count
-    al_draw_textf(main_font, PRIMARY_LOCK_COLOR, r.x + r.w, r.y, 0, "%d", lockon_count);
+    al_draw_textf(main_font, PRIMARY_LOCK_COLOR, r.right, r.top, 0, "%d",
+        lockon_count);
   }
 }
 
 static void hit_target(struct ecs_entity *projectile, struct ecs_entity *target)
 {
-  if (target->tag == ENTITY_FLARE) {
-    // get distracted by flare
-    projectile->components[ECS_COMPONENT_BEHAVIOR]->behavior.target = target;
-  }
-  else {
-    deal_damage(target, 10);
-    explode(projectile);
+  deal_damage(target, 10);
+  explode(projectile);
+}
+
+static void distract_missiles(ecs_world *world) {
+  if (ecs_tag_count(world, ENTITY_FLARE) == 0) { return; }
+  // flares have no collider, so they never enter the collision pass. each
+  // missile asks the spatial index for the nearest flare instead
+  ecs_spatial_filter flares = { .tags = ECS_TAG_BIT(ENTITY_FLARE) };
+  for (int i = 0; i < ecs_tag_count(world, ENTITY_MISSILE); i++) {
+    ecs_entity *missile = ecs_tag_get(world, ENTITY_MISSILE, i);
+    ecs_entity *flare =
+      ecs_query_nearest(world, missile->position, flare_radius, flares);
+    if (flare && missile->components[ECS_COMPONENT_BEHAVIOR]) {
+      missile->components[ECS_COMPONENT_BEHAVIOR]->behavior.target =
+        flare->handle;
+    }
   }
 }
 
 static void explode(struct ecs_entity *projectile) {
-  scenery_make_explosion(projectile->position, (vector){3,3},
-      explosion_animate_rate, al_map_rgb(255,255,255), "explosion1");
+  scenery_make_explosion(projectile->world, projectile->position,
+      (vector){3,3}, explosion_animate_rate, al_map_rgb(255,255,255),
+      "explosion1");
   ecs_entity_free(projectile);
 }
 
 static void friendly_fire_timer_fn(struct ecs_entity *projectile) {
-  projectile->team = TEAM_NEUTRAL;
+  ecs_set_team(projectile, TEAM_NEUTRAL);
   Timer *t = &projectile->components[ECS_COMPONENT_TIMER]->timer;
   t->time_left = 5.0;  // TODO: use projectile duration time
   t->timer_action = explode;
 }
 
-void launch_flare(vector pos) {
-  struct ecs_entity *flare = ecs_entity_new(pos, ENTITY_FLARE);
+void launch_flare(ecs_world *world, vector pos) {
+  struct ecs_entity *flare = ecs_entity_new(world, pos, ENTITY_FLARE);
   flare->angle = -PI / 2;
   Body *b = &ecs_add_component(flare, ECS_COMPONENT_BODY)->body;
   b->max_linear_velocity = 600;
@@ -232,12 +381,11 @@ void launch_flare(vector pos) {
   p->particle_effect =
     get_particle_generator("flare");
   p->directed = true;
-  Collider *col = &ecs_add_component(flare, ECS_COMPONENT_COLLIDER)->collider;
-  col->rect = (rectangle){.w = flare_radius, .h = flare_radius};
   // timer to destroy flare after 6 seconds
   Timer *t = &ecs_add_component(flare, ECS_COMPONENT_TIMER)->timer;
   t->time_left = 6;
   t->timer_action = ecs_entity_free;
   // make small explosion for launch
-  scenery_make_explosion(pos, (vector){1,2}, 50, al_map_rgb_f(1,0,0), "launch");
+  scenery_make_explosion(world, pos, (vector){1,2}, 50, al_map_rgb_f(1,0,0),
+      "launch");
 }
@@ -1,11 +1,38 @@
 #include "util/al_helper.h"
 
+// xorshift64* generator state, one per thread. never 0
+static _Thread_local uint64_t rand_state = 0x2545F4914F6CDD1Dull;
+
+// advance the generator and return 64 random bits
+static uint64_t next_rand() {
+  rand_state ^= rand_state >> 12;
+  rand_state ^= rand_state << 25;
+  rand_state ^= rand_state >> 27;
+  return rand_state * 0x2545F4914F6CDD1Dull;
+}
+
+void rand_seed(uint64_t seed) {
+  rand_state = seed ? seed : 0x2545F4914F6CDD1Dull;
+}
+
+uint64_t rand_get_state() {
+  return rand_state;
+}
+
+void rand_set_state(uint64_t state) {
+  rand_seed(state);
+}
+
+uint64_t rand_bits() {
+  return next_rand();
+}
+
 int randi(int min, int max) {
-  return min + (rand() % (max + 1));
+  return min + (int)(next_rand() >> 33) % (max + 1);
 }
 
 double randd(double min, double max) {
-  double factor = (double)rand()/(double)RAND_MAX;
+  double factor = (next_rand() >> 11) * (1.0 / 9007199254740991.0);
   return min + (max - min) * factor;
 }
 
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "util/alloc_guard.h"
+
+#ifdef ALLOC_GUARD
+// allocations counted since alloc_guard_begin. atomic as jobs on any worker
+// thread may allocate while counting
+static atomic_int count;
+// true between alloc_guard_begin and alloc_guard_end
+static atomic_bool counting;
+// true if the first counted allocation aborts
+static atomic_bool should_abort;
+
+// the linker sends calls to malloc, calloc and realloc here and makes the
+// real functions available as __real_*
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t num, size_t size);
+void* __real_realloc(void *ptr, size_t size);
+
+static void note_alloc(const char *fn, size_t size) {
+  if (!atomic_load(&counting)) { return; }
+  atomic_fetch_add(&count, 1);
+  if (atomic_load(&should_abort)) {
+    fprintf(stderr, "%s of %zu bytes inside an allocation-free section\n",
+        fn, size);
+    abort();
+  }
+}
+
+void* __wrap_malloc(size_t size) {
+  note_alloc("malloc", size);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t num, size_t size) {
+  note_alloc("calloc", num * size);
+  return __real_calloc(num, size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size) {
+  note_alloc("realloc", size);
+  return __real_realloc(ptr, size);
+}
+
+bool alloc_guard_enabled() {
+  return true;
+}
+
+void alloc_guard_begin(bool abort_on_alloc) {
+  atomic_store(&count, 0);
+  atomic_store(&should_abort, abort_on_alloc);
+  atomic_store(&counting, true);
+}
+
+int alloc_guard_end() {
+  atomic_store(&counting, false);
+  return atomic_load(&count);
+}
+#else
+bool alloc_guard_enabled() {
+  return false;
+}
+
+void alloc_guard_begin(bool abort_on_alloc) {
+  (void)abort_on_alloc;
+}
+
+int alloc_guard_end() {
+  return 0;
+}
+#endif
@@ -0,0 +1,64 @@
+#include <string.h>
+#include <assert.h>
+#include "util/array.h"
+
+// capacity to use when growing an array that had none reserved
+static const int min_capacity = 16;
+
+array* array_new(size_t elem_size, int capacity) {
+  assert(elem_size > 0);
+  array *arr = calloc(1, sizeof(array));
+  arr->elem_size = elem_size;
+  arr->capacity = capacity;
+  if (capacity > 0) {
+    arr->data = malloc(elem_size * capacity);
+  }
+  return arr;
+}
+
+void array_free(array *array) {
+  free(array->data);
+  free(array);
+}
+
+void* array_push(array *array) {
+  if (array->length == array->capacity) { // out of room, double capacity
+    array->capacity = array->capacity ? array->capacity * 2 : min_capacity;
+    array->data = realloc(array->data, array->elem_size * array->capacity);
+  }
+  void *elem = array->data + array->elem_size * array->length++;
+  memset(elem, 0, array->elem_size);
+  return elem;
+}
+
+bool array_reserve(array *array, int capacity) {
+  if (capacity <= array->capacity) { return false; } // already fits
+  char *old_data = array->data;
+  array->capacity = capacity;
+  array->data = realloc(array->data, array->elem_size * array->capacity);
+  return array->data != old_data;
+}
+
+void* array_get(array *array, int idx) {
+  assert(idx >= 0 && idx < array->length);
+  return array->data + array->elem_size * idx;
+}
+
+int array_index_of(array *array, void *elem) {
+  int idx = ((char*)elem - array->data) / array->elem_size;
+  assert(idx >= 0 && idx < array->length);
+  return idx;
+}
+
+bool array_swap_remove(array *array, int idx) {
+  assert(idx >= 0 && idx < array->length);
+  int last = --array->length;
+  if (idx == last) { return false; } // removed tail, nothing to move
+  memcpy(array->data + array->elem_size * idx,
+      array->data + array->elem_size * last, array->elem_size);
+  return true;
+}
+
+void array_clear(array *array) {
+  array->length = 0;
+}
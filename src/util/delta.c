@@ -0,0 +1,96 @@
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "util/delta.h"
+
+// an encoding is the length of the encoded buffer followed by runs. each run
+// is a count of bytes equal to base, then a count of literal bytes which are
+// stored xor base so decoding is the same operation as encoding
+
+// byte of a buffer, treating bytes past its end as zero
+static char byte_at(const char *buf, size_t len, size_t i) {
+  return i < len ? buf[i] : 0;
+}
+
+void delta_append(array *bytes, const void *src, size_t size) {
+  assert(bytes->elem_size == 1);
+  if (size == 0) { return; }
+  int needed = bytes->length + (int)size;
+  if (needed > bytes->capacity) {
+    array_reserve(bytes, needed > 2 * bytes->capacity ?
+        needed : 2 * bytes->capacity);
+  }
+  memcpy(bytes->data + bytes->length, src, size);
+  bytes->length = needed;
+}
+
+void delta_encode(const char *base, size_t base_len, const char *cur,
+    size_t cur_len, array *out)
+{
+  array_clear(out);
+  uint32_t len = cur_len;
+  delta_append(out, &len, sizeof(len));
+  size_t i = 0;
+  while (i < cur_len) {
+    // skip bytes unchanged from base
+    uint32_t same = 0;
+    // long unchanged stretches are common, so compare a word at a time first
+    while (i + same + sizeof(uint64_t) <= cur_len &&
+        i + same + sizeof(uint64_t) <= base_len)
+    {
+      uint64_t a, b;
+      memcpy(&a, cur + i + same, sizeof(a));
+      memcpy(&b, base + i + same, sizeof(b));
+      if (a != b) { break; }
+      same += sizeof(uint64_t);
+    }
+    while (i + same < cur_len &&
+        cur[i + same] == byte_at(base, base_len, i + same))
+    {
+      ++same;
+    }
+    i += same;
+    // collect changed bytes
+    uint32_t changed = 0;
+    while (i + changed < cur_len &&
+        cur[i + changed] != byte_at(base, base_len, i + changed))
+    {
+      ++changed;
+    }
+    delta_append(out, &same, sizeof(same));
+    delta_append(out, &changed, sizeof(changed));
+    delta_append(out, cur + i, changed); // copy literals, then xor in place
+    char *literals = out->data + out->length - changed;
+    for (uint32_t j = 0; j < changed; j++, i++) {
+      literals[j] ^= byte_at(base, base_len, i);
+    }
+  }
+}
+
+void delta_decode(const char *base, size_t base_len, const char *delta,
+    size_t delta_len, array *out)
+{
+  array_clear(out);
+  uint32_t len;
+  assert(delta_len >= sizeof(len));
+  memcpy(&len, delta, sizeof(len));
+  const char *pos = delta + sizeof(len), *end = delta + delta_len;
+  // start from base, then patch the changed runs
+  array_reserve(out, len);
+  for (size_t i = 0; i < len; i++) {
+    out->data[i] = byte_at(base, base_len, i);
+  }
+  out->length = len;
+  size_t i = 0;
+  while (pos < end) {
+    uint32_t same, changed;
+    memcpy(&same, pos, sizeof(same));
+    memcpy(&changed, pos + sizeof(same), sizeof(changed));
+    pos += sizeof(same) + sizeof(changed);
+    i += same;
+    assert(i + changed <= len && pos + changed <= end);
+    for (uint32_t j = 0; j < changed; j++, i++) {
+      out->data[i] ^= *pos++;
+    }
+  }
+}
@@ -1,5 +1,17 @@
+#include <assert.h>
+#include <stdatomic.h>
 #include "util/geometry.h"
 
+// SSE2 is used when the compiler targets it. AVX2 code is compiled for
+// x86 whatever the target and only run on processors that have it
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_PATH
+#include <immintrin.h>
+#endif
+
 vector vector_scale(vector vec, double factor) {
   vec.x *= factor;
   vec.y *= factor;
@@ -67,6 +79,197 @@ bool rect_intersect(rectangle r1, rectangle r2) {
           rect_contains_point(r1, r2topleft));
 }
 
+aabb aabb_around(vector center, double w, double h) {
+  return (aabb) {
+    .left  = center.x - w / 2, .top    = center.y - h / 2,
+    .right = center.x + w / 2, .bottom = center.y + h / 2
+  };
+}
+
+aabb aabb_offset(aabb box, vector offset) {
+  return (aabb) {
+    .left  = box.left + offset.x,  .top    = box.top + offset.y,
+    .right = box.right + offset.x, .bottom = box.bottom + offset.y
+  };
+}
+
+aabb aabb_union(aabb b1, aabb b2) {
+  return (aabb) {
+    .left  = fminf(b1.left, b2.left),   .top    = fminf(b1.top, b2.top),
+    .right = fmaxf(b1.right, b2.right), .bottom = fmaxf(b1.bottom, b2.bottom)
+  };
+}
+
+bool aabb_intersect(aabb b1, aabb b2) {
+  return b1.left <= b2.right && b2.left <= b1.right &&
+    b1.top <= b2.bottom && b2.top <= b1.bottom;
+}
+
+uint32_t aabb_intersect_batch_scalar(aabb box, aabb_soa boxes, int first,
+    int count)
+{
+  assert(count <= AABB_BATCH);
+  uint32_t hits = 0;
+  for (int i = 0; i < count; i++) {
+    int k = first + i;
+    bool hit = box.left <= boxes.right[k] && boxes.left[k] <= box.right &&
+      box.top <= boxes.bottom[k] && boxes.top[k] <= box.bottom;
+    hits |= (uint32_t)hit << i;
+  }
+  return hits;
+}
+
+#if defined(HAVE_AVX2_PATH)
+__attribute__((target("avx2")))
+static uint32_t intersect_batch_avx2(aabb box, aabb_soa boxes, int first,
+    int count)
+{
+  __m256 left = _mm256_set1_ps(box.left), top = _mm256_set1_ps(box.top);
+  __m256 right = _mm256_set1_ps(box.right);
+  __m256 bottom = _mm256_set1_ps(box.bottom);
+  uint32_t hits = 0;
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int k = first + i;
+    __m256 hit = _mm256_and_ps(
+        _mm256_and_ps(
+          _mm256_cmp_ps(left, _mm256_loadu_ps(boxes.right + k), _CMP_LE_OQ),
+          _mm256_cmp_ps(_mm256_loadu_ps(boxes.left + k), right, _CMP_LE_OQ)),
+        _mm256_and_ps(
+          _mm256_cmp_ps(top, _mm256_loadu_ps(boxes.bottom + k), _CMP_LE_OQ),
+          _mm256_cmp_ps(_mm256_loadu_ps(boxes.top + k), bottom, _CMP_LE_OQ)));
+    hits |= (uint32_t)_mm256_movemask_ps(hit) << i;
+  }
+  if (i < count) { // fewer than a vector left
+    hits |= aabb_intersect_batch_scalar(box, boxes, first + i, count - i) << i;
+  }
+  return hits;
+}
+#endif
+
+#if defined(__SSE2__)
+static uint32_t intersect_batch_sse2(aabb box, aabb_soa boxes, int first,
+    int count)
+{
+  __m128 left = _mm_set1_ps(box.left), top = _mm_set1_ps(box.top);
+  __m128 right = _mm_set1_ps(box.right), bottom = _mm_set1_ps(box.bottom);
+  uint32_t hits = 0;
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int k = first + i;
+    __m128 hit = _mm_and_ps(
+        _mm_and_ps(_mm_cmple_ps(left, _mm_loadu_ps(boxes.right + k)),
+          _mm_cmple_ps(_mm_loadu_ps(boxes.left + k), right)),
+        _mm_and_ps(_mm_cmple_ps(top, _mm_loadu_ps(boxes.bottom + k)),
+          _mm_cmple_ps(_mm_loadu_ps(boxes.top + k), bottom)));
+    hits |= (uint32_t)_mm_movemask_ps(hit) << i;
+  }
+  if (i < count) { // fewer than a vector left
+    hits |= aabb_intersect_batch_scalar(box, boxes, first + i, count - i) << i;
+  }
+  return hits;
+}
+#endif
+
+bool aabb_batch_supported(aabb_batch_path path) {
+  switch (path) {
+    case AABB_BATCH_SCALAR:
+      return true;
+    case AABB_BATCH_SSE2:
+#if defined(__SSE2__)
+      return true;
+#else
+      return false;
+#endif
+    case AABB_BATCH_AVX2:
+#if defined(HAVE_AVX2_PATH)
+      return __builtin_cpu_supports("avx2");
+#else
+      return false;
+#endif
+    default:
+      return false;
+  }
+}
+
+// test boxes along a path known to be supported
+static uint32_t intersect_batch(aabb_batch_path path, aabb box,
+    aabb_soa boxes, int first, int count)
+{
+  assert(count <= AABB_BATCH);
+  switch (path) {
+#if defined(HAVE_AVX2_PATH)
+    case AABB_BATCH_AVX2:
+      return intersect_batch_avx2(box, boxes, first, count);
+#endif
+#if defined(__SSE2__)
+    case AABB_BATCH_SSE2:
+      return intersect_batch_sse2(box, boxes, first, count);
+#endif
+    default:
+      return aabb_intersect_batch_scalar(box, boxes, first, count);
+  }
+}
+
+uint32_t aabb_intersect_batch_path(aabb_batch_path path, aabb box,
+    aabb_soa boxes, int first, int count)
+{
+  assert(aabb_batch_supported(path));
+  return intersect_batch(path, box, boxes, first, count);
+}
+
+// fastest path of aabb_intersect_batch, -1 until first asked for. the
+// processor does not change, so threads racing to set it agree
+static atomic_int best_path = -1;
+
+uint32_t aabb_intersect_batch(aabb box, aabb_soa boxes, int first,
+    int count)
+{
+  int path = atomic_load_explicit(&best_path, memory_order_relaxed);
+  if (path < 0) {
+    path = NUM_AABB_BATCH_PATHS - 1;
+    while (!aabb_batch_supported(path)) { --path; }
+    atomic_store_explicit(&best_path, path, memory_order_relaxed);
+  }
+  return intersect_batch(path, box, boxes, first, count);
+}
+
+// narrow [*enter, *leave] to the times at which the span [a_min, a_max],
+// moving by d, touches [b_min, b_max]. false if that leaves no time.
+// *axis_enter is set to when they start to touch along this axis, even if
+// before 0, or -INFINITY if they do not move along it
+static bool sweep_axis(double a_min, double a_max, double b_min,
+    double b_max, double d, double *enter, double *leave, double *axis_enter)
+{
+  *axis_enter = -INFINITY;
+  if (d == 0) { return a_min <= b_max && b_min <= a_max; }
+  double t0 = *axis_enter = (d > 0 ? b_min - a_max : b_max - a_min) / d;
+  double t1 = (d > 0 ? b_max - a_min : b_min - a_max) / d;
+  if (t0 > *enter) { *enter = t0; }
+  if (t1 < *leave) { *leave = t1; }
+  return *enter <= *leave;
+}
+
+double aabb_sweep(aabb a, aabb b, vector motion, vector *normal) {
+  double enter = 0, leave = 1; // while the boxes touch along both axes
+  double enter_x, enter_y;
+  bool hit = sweep_axis(a.left, a.right, b.left, b.right, motion.x, &enter,
+      &leave, &enter_x) && sweep_axis(a.top, a.bottom, b.top, b.bottom,
+      motion.y, &enter, &leave, &enter_y);
+  if (hit && normal) { // the face of b met along the axis entered last
+    *normal = ZEROVEC;
+    if (enter_x == -INFINITY && enter_y == -INFINITY) { } // not moving
+    else if (enter_x >= enter_y) { normal->x = motion.x > 0 ? -1 : 1; }
+    else { normal->y = motion.y > 0 ? -1 : 1; }
+  }
+  return hit ? enter : INFINITY;
+}
+
+bool aabb_contains_point(aabb box, vector p) {
+  return box.left <= p.x && p.x <= box.right &&
+    box.top <= p.y && p.y <= box.bottom;
+}
+
 double normalize_angle(double angle) {
   while (angle < 0) { angle += 2 * PI; }
   while (angle >= 2 * PI) { angle -= 2 * PI; }
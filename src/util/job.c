@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <threads.h>
+#include <unistd.h>
+#include "util/job.h"
+
+#define QUEUE_CAPACITY 1024 // jobs per worker. more run on the submitter
+
+typedef struct job {
+  job_fn fn;
+  void *ctx;
+  int begin, end;
+  int tag; // tag of the thread that submitted the job
+  job_wait_group *wg;
+} job;
+
+// ring of jobs. the owner pushes and pops at the bottom, thieves take from
+// the top
+typedef struct job_queue {
+  mtx_t lock;
+  job jobs[QUEUE_CAPACITY];
+  int top, bottom; // bottom - top jobs are queued
+} job_queue;
+
+static job_queue *queues;
+static thrd_t threads[JOB_MAX_THREADS];
+static int num_workers; // 0 while the system is not started
+static atomic_bool quit;
+// idle workers sleep until the number of queued jobs becomes nonzero
+static atomic_int queued;
+static mtx_t sleep_lock;
+static cnd_t wake;
+// worker index of the current thread, -1 for threads outside the system
+static thread_local int worker = -1;
+// jobs the current thread is running, nested in one another
+static thread_local int depth;
+// tag of the current thread, see job_set_tag
+static thread_local int tag;
+// begin of the range the current thread is running, 0 outside of any job
+static thread_local int range_begin;
+
+static bool queue_push(job_queue *q, job j) {
+  mtx_lock(&q->lock);
+  bool pushed = q->bottom - q->top < QUEUE_CAPACITY;
+  if (pushed) {
+    q->jobs[q->bottom++ % QUEUE_CAPACITY] = j;
+    atomic_fetch_add(&queued, 1);
+  }
+  mtx_unlock(&q->lock);
+  return pushed;
+}
+
+static bool queue_take(job_queue *q, job *j, bool steal) {
+  mtx_lock(&q->lock);
+  bool taken = q->bottom > q->top;
+  if (taken) {
+    *j = steal ? q->jobs[q->top++ % QUEUE_CAPACITY] :
+      q->jobs[--q->bottom % QUEUE_CAPACITY];
+    atomic_fetch_sub(&queued, 1);
+    if (q->top == q->bottom) { q->top = q->bottom = 0; }
+  }
+  mtx_unlock(&q->lock);
+  return taken;
+}
+
+// take a job from this thread's queue, or else from another worker's
+static bool find_job(job *j) {
+  if (atomic_load(&queued) == 0) { return false; }
+  int self = worker < 0 ? 0 : worker;
+  if (queue_take(&queues[self], j, false)) { return true; }
+  for (int i = 1; i < num_workers; i++) {
+    if (queue_take(&queues[(self + i) % num_workers], j, true)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void run_job(job *j) {
+  int outer_tag = tag, outer_begin = range_begin;
+  tag = j->tag;
+  range_begin = j->begin;
+  ++depth;
+  j->fn(j->ctx, j->begin, j->end);
+  --depth;
+  tag = outer_tag;
+  range_begin = outer_begin;
+  atomic_fetch_sub(&j->wg->_pending, 1);
+}
+
+static void wake_workers() {
+  // take the lock so a worker cannot miss the wakeup between checking the
+  // queued count and starting to wait
+  mtx_lock(&sleep_lock);
+  cnd_broadcast(&wake);
+  mtx_unlock(&sleep_lock);
+}
+
+static int worker_main(void *arg) {
+  worker = (int)(intptr_t)arg;
+  while (true) {
+    job j;
+    if (find_job(&j)) {
+      run_job(&j);
+      continue;
+    }
+    mtx_lock(&sleep_lock);
+    while (atomic_load(&queued) == 0 && !atomic_load(&quit)) {
+      cnd_wait(&wake, &sleep_lock);
+    }
+    mtx_unlock(&sleep_lock);
+    if (atomic_load(&quit) && atomic_load(&queued) == 0) { return 0; }
+  }
+}
+
+// queue a job without waking anyone
+static void submit(job_wait_group *wg, job_fn fn, void *ctx, int begin,
+    int end)
+{
+  job j = { .fn = fn, .ctx = ctx, .begin = begin, .end = end, .tag = tag,
+    .wg = wg };
+  atomic_fetch_add(&wg->_pending, 1);
+  if (num_workers == 0 ||
+      !queue_push(&queues[worker < 0 ? 0 : worker], j))
+  {
+    run_job(&j); // not started or queue full: run it here
+  }
+}
+
+void job_system_init(int num_threads) {
+  assert(num_workers == 0);
+  if (num_threads <= 0) { num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN); }
+  if (num_threads > JOB_MAX_THREADS) { num_threads = JOB_MAX_THREADS; }
+  if (num_threads <= 1) { return; } // nothing to gain, run jobs inline
+  queues = calloc(num_threads, sizeof(job_queue));
+  for (int i = 0; i < num_threads; i++) {
+    mtx_init(&queues[i].lock, mtx_plain);
+  }
+  mtx_init(&sleep_lock, mtx_plain);
+  cnd_init(&wake);
+  atomic_store(&quit, false);
+  worker = 0;
+  num_workers = 1;
+  for (int i = 1; i < num_threads; i++) {
+    if (thrd_create(&threads[i], worker_main, (void*)(intptr_t)i) !=
+        thrd_success)
+    {
+      break;
+    }
+    ++num_workers;
+  }
+}
+
+void job_system_shutdown() {
+  if (num_workers == 0) { return; }
+  assert(worker == 0);
+  atomic_store(&quit, true);
+  wake_workers();
+  for (int i = 1; i < num_workers; i++) {
+    thrd_join(threads[i], NULL);
+  }
+  job j;
+  while (find_job(&j)) { run_job(&j); } // queued after the workers stopped
+  for (int i = 0; i < num_workers; i++) {
+    mtx_destroy(&queues[i].lock);
+  }
+  mtx_destroy(&sleep_lock);
+  cnd_destroy(&wake);
+  free(queues);
+  queues = NULL;
+  num_workers = 0;
+  worker = -1;
+}
+
+int job_thread_count() {
+  return num_workers > 0 ? num_workers : 1;
+}
+
+int job_thread_index() {
+  return worker < 0 ? 0 : worker;
+}
+
+int job_depth() {
+  return depth;
+}
+
+void job_set_tag(int new_tag) {
+  tag = new_tag;
+}
+
+int job_tag() {
+  return tag;
+}
+
+int job_range_begin() {
+  return range_begin;
+}
+
+// run a range on the calling thread, counted as a job
+static void run_inline(job_fn fn, void *ctx, int begin, int end) {
+  int outer_begin = range_begin;
+  range_begin = begin;
+  ++depth;
+  fn(ctx, begin, end);
+  --depth;
+  range_begin = outer_begin;
+}
+
+void job_submit(job_wait_group *wg, job_fn fn, void *ctx, int begin,
+    int end)
+{
+  submit(wg, fn, ctx, begin, end);
+  if (num_workers > 0) { wake_workers(); }
+}
+
+void job_wait(job_wait_group *wg) {
+  while (atomic_load(&wg->_pending) > 0) {
+    job j;
+    if (find_job(&j)) { run_job(&j); }
+    else { thrd_yield(); } // remaining jobs are running on other workers
+  }
+}
+
+void job_parallel_for(int count, int grain, job_fn fn, void *ctx) {
+  if (grain < 1) { grain = 1; }
+  if (num_workers == 0 || count <= grain) {
+    if (count > 0) { run_inline(fn, ctx, 0, count); }
+    return;
+  }
+  job_wait_group wg = {0};
+  // queue the last range first, so the owner takes the early ranges and
+  // thieves the late ones
+  int last = (count - 1) / grain * grain;
+  for (int begin = last; begin > 0; begin -= grain) {
+    submit(&wg, fn, ctx, begin, begin + grain < count ? begin + grain : count);
+  }
+  wake_workers();
+  run_inline(fn, ctx, 0, grain);
+  job_wait(&wg);
+}
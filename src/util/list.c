@@ -1,23 +1,40 @@
 #include <string.h>
+#include <assert.h>
 #include "util/list.h"
 
 list* list_new() {
   return (list*)calloc(1, sizeof(list));
 }
 
+list* list_new_pooled(pool *nodes) {
+  assert(nodes->elem_size >= sizeof(list_node));
+  list *list = list_new();
+  list->_nodes = nodes;
+  return list;
+}
+
 void list_free(list *list, list_lambda fn) {
   list_clear(list, fn);
   free(list);
 }
 
 void list_clear(list *list, list_lambda fn) {
-  while (list->head != NULL) {
-    list_remove(list, list->head, fn);
+  // every node goes, so skip relinking the neighbours of each one
+  list_node *node = list->head;
+  while (node != NULL) {
+    list_node *next = node->next;
+    if (fn != NULL) { fn(node->value); }
+    if (list->_nodes) { pool_release(list->_nodes, node); }
+    else { free(node); }
+    node = next;
   }
+  list->head = list->tail = NULL;
+  list->length = 0;
 }
 
 list_node* list_push(list *list, void *value) {
-  list_node *new = (list_node*)malloc(sizeof(list_node)); 
+  list_node *new = list->_nodes ? pool_alloc(list->_nodes) :
+    malloc(sizeof(list_node));
   new->value = value;        // store the value
   new->next = list->head;   // point new at previous head
   new->prev = NULL;
@@ -59,7 +76,12 @@ list_node* list_remove(list *list, list_node *node, list_lambda fn) {
   if (fn != NULL) {     // was a free function given?
     fn(node->value);    // call free function on value
   }
-  free(node);           // destroy node
+  if (list->_nodes) {   // destroy node
+    pool_release(list->_nodes, node);
+  }
+  else {
+    free(node);
+  }
   list->length--;
   return next;          // return pointer to next node
 }
@@ -0,0 +1,190 @@
+#include <string.h>
+#include <assert.h>
+#include "util/point_grid.h"
+
+// a listed point and its index among the points given to point_grid_build
+typedef struct grid_entry {
+  vector point;
+  int id;
+} grid_entry;
+
+point_grid* point_grid_new(aabb area, float cell_size, int capacity) {
+  assert(cell_size > 0);
+  point_grid *grid = malloc(sizeof(point_grid));
+  *grid = (point_grid){
+    .area = area,
+    .cell_size = cell_size,
+    .cols = (int)ceilf((area.right - area.left) / cell_size),
+    .rows = (int)ceilf((area.bottom - area.top) / cell_size),
+    ._entries = array_new(sizeof(grid_entry), capacity),
+    ._points = array_new(sizeof(vector), capacity)
+  };
+  if (grid->cols < 1) { grid->cols = 1; }
+  if (grid->rows < 1) { grid->rows = 1; }
+  int num_cells = grid->cols * grid->rows;
+  grid->_cell_start = array_new(sizeof(int), num_cells + 1);
+  grid->_cell_start->length = num_cells + 1;
+  memset(grid->_cell_start->data, 0, (num_cells + 1) * sizeof(int));
+  return grid;
+}
+
+void point_grid_free(point_grid *grid) {
+  array_free(grid->_cell_start);
+  array_free(grid->_entries);
+  array_free(grid->_points);
+  free(grid);
+}
+
+// index of the cell containing a coordinate, clamped to the grid. infinite
+// and NaN coordinates are clamped too
+static int cell_of(double coord, double origin, float cell_size,
+    int num_cells)
+{
+  double cell = floor((coord - origin) / cell_size);
+  return !(cell >= 0) ? 0 : (cell >= num_cells ? num_cells - 1 : (int)cell);
+}
+
+static double distance_sq(vector a, vector b) {
+  double dx = a.x - b.x, dy = a.y - b.y;
+  return dx * dx + dy * dy;
+}
+
+void point_grid_build(point_grid *grid, const vector *points, int count) {
+  int num_cells = grid->cols * grid->rows;
+  int *cell_start = (int*)grid->_cell_start->data;
+  memset(cell_start, 0, (num_cells + 1) * sizeof(int));
+  if (count > grid->_entries->capacity) {
+    array_reserve(grid->_entries, 2 * count);
+    array_reserve(grid->_points, 2 * count);
+  }
+  grid->_entries->length = grid->_points->length = grid->count = count;
+  memcpy(grid->_points->data, points, count * sizeof(vector));
+  // count the points in each cell, turn the counts into the end of each
+  // cell, then fill the cells back to front so each ends up at its start
+  // with its ids in ascending order
+  for (int i = 0; i < count; i++) {
+    ++cell_start[
+      cell_of(points[i].y, grid->area.top, grid->cell_size, grid->rows) *
+      grid->cols +
+      cell_of(points[i].x, grid->area.left, grid->cell_size, grid->cols)];
+  }
+  for (int c = 1; c <= num_cells; c++) { cell_start[c] += cell_start[c - 1]; }
+  grid_entry *entries = (grid_entry*)grid->_entries->data;
+  for (int i = count - 1; i >= 0; i--) {
+    int c =
+      cell_of(points[i].y, grid->area.top, grid->cell_size, grid->rows) *
+      grid->cols +
+      cell_of(points[i].x, grid->area.left, grid->cell_size, grid->cols);
+    entries[--cell_start[c]] = (grid_entry){ .point = points[i], .id = i };
+  }
+}
+
+int point_grid_visit_radius(point_grid *grid, vector center, double radius,
+    point_grid_visitor visit, void *ctx)
+{
+  if (!(radius >= 0)) { return 0; }
+  const int *cell_start = (int*)grid->_cell_start->data;
+  const grid_entry *entries = (grid_entry*)grid->_entries->data;
+  // points beyond the area are in the edge cells, so the clamped cells of
+  // the box around the circle hold every point that may be in it
+  int left = cell_of(center.x - radius, grid->area.left, grid->cell_size,
+      grid->cols);
+  int right = cell_of(center.x + radius, grid->area.left, grid->cell_size,
+      grid->cols);
+  int top = cell_of(center.y - radius, grid->area.top, grid->cell_size,
+      grid->rows);
+  int bottom = cell_of(center.y + radius, grid->area.top, grid->cell_size,
+      grid->rows);
+  double radius_sq = radius * radius;
+  int visited = 0;
+  for (int y = top; y <= bottom; y++) {
+    for (int x = left; x <= right; x++) {
+      int c = y * grid->cols + x;
+      for (int e = cell_start[c]; e < cell_start[c + 1]; e++) {
+        if (distance_sq(entries[e].point, center) <= radius_sq) {
+          visit(ctx, entries[e].id);
+          ++visited;
+        }
+      }
+    }
+  }
+  return visited;
+}
+
+// ids accepted by the filter of a radius query and where they go
+typedef struct radius_collect {
+  point_grid_filter filter;
+  void *ctx;
+  int *out;
+  int max, found;
+} radius_collect;
+
+static void collect(void *ctx, int id) {
+  radius_collect *found = ctx;
+  if (found->filter && !found->filter(found->ctx, id)) { return; }
+  if (found->found < found->max) { found->out[found->found] = id; }
+  ++found->found;
+}
+
+int point_grid_radius(point_grid *grid, vector center, double radius,
+    point_grid_filter filter, void *ctx, int *out, int max)
+{
+  radius_collect found = { .filter = filter, .ctx = ctx, .out = out,
+    .max = max };
+  point_grid_visit_radius(grid, center, radius, collect, &found);
+  return found.found;
+}
+
+int point_grid_nearest(point_grid *grid, vector center, double radius, int k,
+    point_grid_filter filter, void *ctx, int *out)
+{
+  if (k <= 0 || !(radius >= 0)) { return 0; }
+  const int *cell_start = (int*)grid->_cell_start->data;
+  const grid_entry *entries = (grid_entry*)grid->_entries->data;
+  const vector *points = (vector*)grid->_points->data;
+  int cx = cell_of(center.x, grid->area.left, grid->cell_size, grid->cols);
+  int cy = cell_of(center.y, grid->area.top, grid->cell_size, grid->rows);
+  int last_ring = grid->cols > grid->rows ? grid->cols : grid->rows;
+  double radius_sq = radius * radius;
+  int found = 0;
+  for (int r = 0; r <= last_ring; r++) {
+    // the cells r rings out from the spot's cell are over (r - 1) cells
+    // away from it. clamping only moves points outward, away from the spot
+    double bound = (r - 1) * (double)grid->cell_size;
+    if (r > 0 && (bound > radius || (found == k &&
+            distance_sq(points[out[k - 1]], center) <= bound * bound)))
+    {
+      break;
+    }
+    for (int y = cy - r; y <= cy + r; y++) {
+      if (y < 0 || y >= grid->rows) { continue; }
+      // whole rows at the top and bottom of the ring, its ends elsewhere
+      int step = (y == cy - r || y == cy + r) ? 1 : 2 * r;
+      for (int x = cx - r; x <= cx + r; x += step) {
+        if (x < 0 || x >= grid->cols) { continue; }
+        int c = y * grid->cols + x;
+        for (int e = cell_start[c]; e < cell_start[c + 1]; e++) {
+          int id = entries[e].id;
+          double d = distance_sq(entries[e].point, center);
+          bool full = found == k;
+          double worst = full ? distance_sq(points[out[k - 1]], center) : 0;
+          if (d > radius_sq || (full && d > worst) ||
+              (full && d == worst && id > out[k - 1]) ||
+              (filter && !filter(ctx, id)))
+          {
+            continue;
+          }
+          // insert in order of distance, then id, dropping the farthest
+          int i = found < k ? found++ : k - 1;
+          for (; i > 0; i--) {
+            double prev = distance_sq(points[out[i - 1]], center);
+            if (prev < d || (prev == d && out[i - 1] < id)) { break; }
+            out[i] = out[i - 1];
+          }
+          out[i] = id;
+        }
+      }
+    }
+  }
+  return found;
+}
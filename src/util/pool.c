@@ -0,0 +1,75 @@
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "util/pool.h"
+
+// alignment guaranteed for every object handed out by a pool
+#define POOL_ALIGN _Alignof(max_align_t)
+// round size up to a multiple of POOL_ALIGN
+#define POOL_ROUND(size) (((size) + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN)
+
+// released objects store a pointer to the next free object in their memory
+typedef struct free_obj {
+  struct free_obj *next;
+} free_obj;
+
+// each slab starts with a pointer to the previously allocated slab
+typedef struct slab_header {
+  struct slab_header *next;
+} slab_header;
+
+// allocate a new slab and thread all of its objects onto the free list
+static void pool_grow(pool *pool) {
+  size_t header_size = POOL_ROUND(sizeof(slab_header));
+  slab_header *slab = malloc(header_size + pool->elem_size * pool->slab_size);
+  slab->next = pool->_slabs;
+  pool->_slabs = slab;
+  char *objs = (char*)slab + header_size;
+  // push in reverse so objects are handed out in address order
+  for (int i = pool->slab_size - 1; i >= 0; i--) {
+    free_obj *obj = (free_obj*)(objs + pool->elem_size * i);
+    obj->next = pool->_free_list;
+    pool->_free_list = obj;
+  }
+  ++pool->stats.slabs;
+}
+
+pool* pool_new(size_t elem_size, int slab_size) {
+  assert(elem_size > 0 && slab_size > 0);
+  pool *p = calloc(1, sizeof(pool));
+  // every object must be able to hold a free list link
+  p->elem_size = POOL_ROUND(elem_size > sizeof(free_obj) ?
+      elem_size : sizeof(free_obj));
+  p->slab_size = slab_size;
+  pool_grow(p);
+  return p;
+}
+
+void pool_free(pool *pool) {
+  slab_header *slab = pool->_slabs;
+  while (slab) {
+    slab_header *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  free(pool);
+}
+
+void* pool_alloc(pool *pool) {
+  if (pool->_free_list == NULL) { pool_grow(pool); }
+  free_obj *obj = pool->_free_list;
+  pool->_free_list = obj->next;
+  if (++pool->stats.live > pool->stats.peak) {
+    pool->stats.peak = pool->stats.live;
+  }
+  memset(obj, 0, pool->elem_size);
+  return obj;
+}
+
+void pool_release(pool *pool, void *obj) {
+  assert(obj != NULL && pool->stats.live > 0);
+  free_obj *f = obj;
+  f->next = pool->_free_list;
+  pool->_free_list = f;
+  --pool->stats.live;
+}
@@ -2,12 +2,13 @@
 #include "entity/enemies.h"
 
 static list *waves;
-static ecs_entity *player_entity;
+static ecs_world *player_world;
+static ecs_handle player_entity;
 static void wave_spawn_enemies(EnemyWave *wave);
 
 //TODO: load from cfg file
 static EnemyWave wave1 = {
-  .spawn_fn = spawn_enemy,
+  .spawn_fn = spawn_enemies,
   .quantity = 4,
   .spawn_side = NORTH,
   .exit_side = WEST,
@@ -16,7 +17,8 @@ static EnemyWave wave1 = {
 };
 
 void start_enemy_waves(struct ecs_entity *player) {
-  player_entity = player;
+  player_world = player->world;
+  player_entity = player->handle;
   waves = list_new();
   EnemyWave *wave = malloc(sizeof(EnemyWave));
   memcpy(wave, &wave1, sizeof(EnemyWave));
@@ -46,6 +48,7 @@ void stop_enemy_waves() {
 
 static void wave_spawn_enemies(EnemyWave *wave) {
   if (wave->spawn_side & (NORTH | SOUTH)) {
+    EnemySpawnData data[wave->quantity]; // on the stack, waves are small
     for (int i = 0; i < wave->quantity; i++) {
       // start coordinates
       int sx = (i + 1) * SCREEN_W / (wave->quantity + 1);
@@ -53,14 +56,15 @@ static void wave_spawn_enemies(EnemyWave *wave) {
       // destination coordinates
       int dx = sx;
       int dy = 60;
-      EnemySpawnData data = {
+      data[i] = (EnemySpawnData){
         .start = (vector){sx, sy},
         .target = (vector){dx, dy},
         .exit = (vector){sx, sy},
         .duration = wave->duration,
         .player = player_entity
       };
-      wave->spawn_fn(data);
     }
+    // spawn the wave as one batch
+    wave->spawn_fn(player_world, data, wave->quantity);
   }
 }
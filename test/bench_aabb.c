@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "util/geometry.h"
+
+// compare the cost per box of testing one box against many with
+// aabb_intersect, the scalar batch kernel and the vectorized batch kernel
+
+#define NUM_BOXES 4096
+#define NUM_PASSES 2000
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, long hits) {
+  double ns = (now() - start) * 1e9 / ((double)NUM_BOXES * NUM_PASSES);
+  printf("%-28s %6.2f ns/box (%ld hits)\n", name, ns, hits);
+}
+
+// the box tested against the packed ones on a given pass
+static aabb probe(int pass) {
+  return aabb_around((vector){ pass % 640, pass % 360 }, 64, 64);
+}
+
+int main(int argc, char *argv[]) {
+  aabb *packed = malloc(NUM_BOXES * sizeof(aabb));
+  float *edges = malloc(4 * NUM_BOXES * sizeof(float));
+  aabb_soa soa = { edges, edges + NUM_BOXES, edges + 2 * NUM_BOXES,
+    edges + 3 * NUM_BOXES };
+  srand(1);
+  for (int i = 0; i < NUM_BOXES; i++) {
+    vector center = { rand() % 1280, rand() % 720 };
+    packed[i] = aabb_around(center, 8 + rand() % 56, 8 + rand() % 56);
+    soa.left[i] = packed[i].left, soa.top[i] = packed[i].top;
+    soa.right[i] = packed[i].right, soa.bottom[i] = packed[i].bottom;
+  }
+
+  long hits = 0;
+  double start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    aabb box = probe(pass);
+    for (int i = 0; i < NUM_BOXES; i++) {
+      hits += aabb_intersect(box, packed[i]);
+    }
+  }
+  report("aabb_intersect", start, hits);
+
+  hits = 0;
+  start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    aabb box = probe(pass);
+    for (int i = 0; i < NUM_BOXES; i += AABB_BATCH) {
+      hits += __builtin_popcount(
+          aabb_intersect_batch_scalar(box, soa, i, AABB_BATCH));
+    }
+  }
+  report("aabb_intersect_batch_scalar", start, hits);
+
+  hits = 0;
+  start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    aabb box = probe(pass);
+    for (int i = 0; i < NUM_BOXES; i += AABB_BATCH) {
+      hits += __builtin_popcount(
+          aabb_intersect_batch(box, soa, i, AABB_BATCH));
+    }
+  }
+  report("aabb_intersect_batch", start, hits);
+
+  free(packed);
+  free(edges);
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "util/list.h"
+#include "util/array.h"
+
+// compare the cost per element of iterating through callbacks and
+// array_get with the inlined LIST_FOREACH and ARRAY_FOREACH loops
+
+#define NUM_ELEMENTS 100000
+#define NUM_PASSES 200
+
+// stands in for a body: the loop body integrates position
+typedef struct mover {
+  double x, y, vx, vy;
+} mover;
+
+static const double dt = 1.0 / 60;
+
+static void move(void *value) {
+  mover *m = value;
+  m->x += m->vx * dt;
+  m->y += m->vy * dt;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start) {
+  double ns = (now() - start) * 1e9 / ((double)NUM_ELEMENTS * NUM_PASSES);
+  printf("%-24s %6.2f ns/element\n", name, ns);
+}
+
+int main(int argc, char *argv[]) {
+  pool *nodes = pool_new(sizeof(list_node), NUM_ELEMENTS);
+  list *movers = list_new_pooled(nodes);
+  array *packed = array_new(sizeof(mover), NUM_ELEMENTS);
+  mover *storage = calloc(NUM_ELEMENTS, sizeof(mover));
+  for (int i = 0; i < NUM_ELEMENTS; i++) {
+    storage[i] = (mover){ .vx = i % 7, .vy = i % 13 };
+    list_push(movers, &storage[i]);
+    *(mover*)array_push(packed) = storage[i];
+  }
+
+  double start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    list_each(movers, move);
+  }
+  report("list_each", start);
+
+  start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    mover *m;
+    LIST_FOREACH(m, movers) {
+      m->x += m->vx * dt;
+      m->y += m->vy * dt;
+    }
+  }
+  report("LIST_FOREACH", start);
+
+  start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    for (int i = 0; i < packed->length; i++) {
+      move(array_get(packed, i));
+    }
+  }
+  report("array_get", start);
+
+  start = now();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    mover *m;
+    ARRAY_FOREACH(m, packed) {
+      m->x += m->vx * dt;
+      m->y += m->vy * dt;
+    }
+  }
+  report("ARRAY_FOREACH", start);
+
+  // keep the results live so the loops are not optimized away
+  double sum = 0;
+  for (int i = 0; i < NUM_ELEMENTS; i++) {
+    sum += storage[i].x + ((mover*)array_get(packed, i))->y;
+  }
+  printf("checksum %g\n", sum);
+
+  list_free(movers, NULL);
+  pool_free(nodes);
+  array_free(packed);
+  free(storage);
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "util/array.h"
+
+typedef struct simple_data {
+  int x, y;
+} simple_data;
+
+// test array functionality
+int main(int argc, char *argv[]) {
+  array *arr = array_new(sizeof(simple_data), 0);
+  assert(arr != NULL);
+  assert(arr->length == 0);
+  // push enough elements to force several reallocations
+  for (int i = 0; i < 100; i++) {
+    simple_data *d = array_push(arr);
+    assert(d->x == 0 && d->y == 0); // pushed elements start zeroed
+    d->x = i;
+    d->y = -i;
+  }
+  assert(arr->length == 100);
+  assert(arr->capacity >= 100);
+  for (int i = 0; i < 100; i++) {
+    simple_data *d = array_get(arr, i);
+    assert(d->x == i && d->y == -i);
+    assert(array_index_of(arr, d) == i);
+  }
+  // removing from the middle moves the tail element into the hole
+  assert(array_swap_remove(arr, 10));
+  assert(arr->length == 99);
+  assert(((simple_data*)array_get(arr, 10))->x == 99);
+  // removing the tail moves nothing
+  assert(!array_swap_remove(arr, arr->length - 1));
+  assert(arr->length == 98);
+  assert(((simple_data*)array_get(arr, 97))->x == 97);
+  // clearing keeps storage around for reuse
+  int capacity = arr->capacity;
+  array_clear(arr);
+  assert(arr->length == 0);
+  assert(arr->capacity == capacity);
+  // reserving never shrinks, and pushes within the reservation never move
+  assert(!array_reserve(arr, 1));
+  array_reserve(arr, capacity + 50);
+  assert(arr->capacity == capacity + 50);
+  char *data = arr->data;
+  for (int i = 0; i < capacity + 50; i++) { array_push(arr); }
+  assert(arr->data == data);
+  array_free(arr);
+}
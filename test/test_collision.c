@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "al_game.h"
+#include "ecs.h"
+#include "util/al_helper.h"
+#include "util/job.h"
+
+#define NUM_COLLIDERS 400
+#define NUM_SEEDS 8
+#define MAX_PAIRS 4096
+#define STEP (1 / 60.0)
+#define MAX_CALLS 256
+
+// a pair of colliders, the entity with the lower handle first
+typedef struct pair {
+  ecs_handle a, b;
+} pair;
+
+static int compare_pairs(const void *p1, const void *p2) {
+  const pair *q1 = p1, *q2 = p2;
+  if (q1->a != q2->a) { return q1->a < q2->a ? -1 : 1; }
+  if (q1->b != q2->b) { return q1->b < q2->b ? -1 : 1; }
+  return 0;
+}
+
+static pair pair_of(ecs_entity *e1, ecs_entity *e2) {
+  return e1->handle < e2->handle ? (pair){ e1->handle, e2->handle } :
+    (pair){ e2->handle, e1->handle };
+}
+
+// a world running only the systems that move bodies and collide them
+static ecs_world* world_new() {
+  ecs_world *world = ecs_world_new();
+  array_clear(world->systems);
+  ecs_add_system(world, body_system_fn, 0, 0);
+  ecs_add_system(world, bounds_system_fn, 0, 0);
+  ecs_add_system(world, collision_system_fn, 0, 0);
+  return world;
+}
+
+// a collider with a body moving at a constant velocity
+static ecs_entity* collider_new(ecs_world *world, vector position,
+    vector size, vector velocity)
+{
+  ecs_entity *entity = ecs_entity_new(world, position, ENTITY_SHIP);
+  Collider *collider =
+    &ecs_add_component(entity, ECS_COMPONENT_COLLIDER)->collider;
+  collider->rect = (rectangle){ .w = size.x, .h = size.y };
+  Body *body = &ecs_add_component(entity, ECS_COMPONENT_BODY)->body;
+  body->velocity = velocity;
+  body->max_linear_velocity = 1e6;
+  return entity;
+}
+
+// colliders of every size, speed, category, mask and team, some beyond the
+// screen and some stationary
+static ecs_world* random_world(int seed) {
+  rand_seed(seed);
+  ecs_world *world = world_new();
+  // keep every collider awake unless it is stationary
+  collision_system_set_sleep_delay(world, INFINITY);
+  for (int i = 0; i < NUM_COLLIDERS; i++) {
+    vector position = { randd(-100, SCREEN_W + 100),
+      randd(-100, SCREEN_H + 100) };
+    vector size = { randd(2, 90), randd(2, 90) };
+    bool stationary = randi(0, 9) == 0;
+    vector velocity = stationary ? ZEROVEC :
+      (vector){ randd(-1500, 1500), randd(-1500, 1500) };
+    ecs_entity *entity = collider_new(world, position, size, velocity);
+    Collider *collider =
+      &entity->components[ECS_COMPONENT_COLLIDER]->collider;
+    int category = randi(0, NUM_COLLISION_CATEGORIES); // 0 for none
+    collider->category = category ? 1u << (category - 1) : 0;
+    collider->mask = randi(0, COLLIDE_ALL);
+    collider->stationary = stationary;
+    ecs_set_team(entity, randi(TEAM_NEUTRAL, NUM_ENTITY_TEAMS - 1));
+  }
+  return world;
+}
+
+// the pairs that touched in the last update, found by testing every pair of
+// colliders as the collision system would
+static int brute_force_pairs(ecs_world *world, pair *out) {
+  int found = 0;
+  array *store = world->component_store[ECS_COMPONENT_COLLIDER];
+  int count = store->length;
+  for (int i = 0; i < count; i++) {
+    ecs_component *comp1 = array_get(store, i);
+    for (int j = i + 1; j < count; j++) {
+      ecs_component *comp2 = array_get(store, j);
+      Collider *c1 = &comp1->collider, *c2 = &comp2->collider;
+      ecs_entity *e1 = comp1->owner_entity, *e2 = comp2->owner_entity;
+      if (!c1->category || !c2->category ||
+          !((c1->mask & c2->category) || (c2->mask & c1->category)) ||
+          ecs_same_team(e1, e2) || (c1->stationary && c2->stationary))
+      {
+        continue;
+      }
+      vector motion1 = vector_scale(
+          e1->components[ECS_COMPONENT_BODY]->body.velocity, STEP);
+      vector motion2 = vector_scale(
+          e2->components[ECS_COMPONENT_BODY]->body.velocity, STEP);
+      aabb start1 = aabb_offset(ecs_entity_bounds(e1)->hit,
+          vector_neg(motion1));
+      aabb start2 = aabb_offset(ecs_entity_bounds(e2)->hit,
+          vector_neg(motion2));
+      if (aabb_sweep(start1, start2, vector_sub(motion1, motion2), NULL) <=
+          1)
+      {
+        assert(found < MAX_PAIRS);
+        out[found++] = pair_of(e1, e2);
+      }
+    }
+  }
+  return found;
+}
+
+// the pairs the collision system found in the last update
+static int system_pairs(ecs_world *world, pair *out) {
+  int count = collision_system_event_count(world);
+  assert(count <= MAX_PAIRS);
+  for (int i = 0; i < count; i++) {
+    const collision_event *event = collision_system_event(world, i);
+    out[i] = pair_of(event->entity1, event->entity2);
+  }
+  return count;
+}
+
+// pairs found in each world by the first check, in the order found
+static pair first_found[NUM_SEEDS][MAX_PAIRS];
+static int first_count[NUM_SEEDS];
+
+// step a random world once and check the grid found the same pairs as
+// testing every pair, each once. later checks of a world must find them in
+// the same order as the first, however many threads searched
+static void check_equivalence(int seed) {
+  static pair expected[MAX_PAIRS], found[MAX_PAIRS];
+  ecs_world *world = random_world(seed);
+  ecs_update_systems(world, STEP);
+  int num_expected = brute_force_pairs(world, expected);
+  int num_found = system_pairs(world, found);
+  if (first_count[seed] == 0) {
+    first_count[seed] = num_found;
+    memcpy(first_found[seed], found, num_found * sizeof(pair));
+  }
+  assert(num_found == first_count[seed]);
+  assert(memcmp(found, first_found[seed], num_found * sizeof(pair)) == 0);
+  qsort(expected, num_expected, sizeof(pair), compare_pairs);
+  qsort(found, num_found, sizeof(pair), compare_pairs);
+  assert(num_found == num_expected);
+  assert(memcmp(found, expected, num_found * sizeof(pair)) == 0);
+  assert(num_found > 0);
+  ecs_world_free(world);
+}
+
+// kinds of collision handler call
+enum { ENTER, STAY, EXIT };
+
+// the entity whose contacts are counted by the handlers below, apart from
+// the resting partner it starts against
+static ecs_handle partner;
+// calls of each kind, against the partner and against anything else
+static int calls[2][3];
+// every call in order, with the update it came in
+static struct { int kind, update; } call_log[MAX_CALLS];
+static int num_logged, num_updates;
+
+static void count_call(ecs_entity *other, int kind) {
+  ++calls[other->handle != partner][kind];
+  assert(num_logged < MAX_CALLS);
+  call_log[num_logged].kind = kind;
+  call_log[num_logged++].update = num_updates;
+}
+
+static void count_enter(ecs_entity *ent, ecs_entity *other) {
+  count_call(other, ENTER);
+}
+
+static void count_stay(ecs_entity *ent, ecs_entity *other) {
+  count_call(other, STAY);
+}
+
+static void count_exit(ecs_entity *ent, ecs_entity *other) {
+  count_call(other, EXIT);
+}
+
+static void step(ecs_world *world, int updates) {
+  for (int i = 0; i < updates; i++) {
+    ecs_update_systems(world, STEP);
+    ++num_updates;
+  }
+}
+
+// test that a collider crossing another is told once as it enters, once
+// in each update it stays in contact and once as it leaves, in that order
+static void test_contacts() {
+  ecs_world *world = world_new();
+  ecs_entity *wall = collider_new(world, (vector){ 200, 100 },
+      (vector){ 16, 16 }, ZEROVEC);
+  Collider *collider = &wall->components[ECS_COMPONENT_COLLIDER]->collider;
+  collider->category = COLLIDE_HAZARD;
+  collider->stationary = true;
+  ecs_entity *mover = collider_new(world, (vector){ 150, 100 },
+      (vector){ 16, 16 }, (vector){ 120, 0 });
+  collider = &mover->components[ECS_COMPONENT_COLLIDER]->collider;
+  collider->category = COLLIDE_ENEMY;
+  collider->mask = COLLIDE_HAZARD;
+  collider->on_collision = count_enter;
+  collider->on_collision_stay = count_stay;
+  collider->on_collision_exit = count_exit;
+  partner = wall->handle;
+  memset(calls, 0, sizeof(calls));
+  num_logged = num_updates = 0;
+  // 2 pixels an update, so the mover is in contact for about 16 updates
+  step(world, 60);
+  assert(calls[1][ENTER] + calls[1][STAY] + calls[1][EXIT] == 0);
+  assert(calls[0][ENTER] == 1 && calls[0][EXIT] == 1);
+  assert(calls[0][STAY] > 10);
+  assert(num_logged == calls[0][STAY] + 2);
+  assert(call_log[0].kind == ENTER);
+  assert(call_log[num_logged - 1].kind == EXIT);
+  for (int i = 1; i < num_logged; i++) {
+    assert(i == num_logged - 1 || call_log[i].kind == STAY);
+    assert(call_log[i].update == call_log[i - 1].update + 1);
+  }
+  ecs_world_free(world);
+}
+
+// test that a pair falls asleep while touching, stays in contact untested,
+// is still hit by moving colliders, and wakes once one of it moves away
+static void test_sleep() {
+  ecs_world *world = world_new();
+  ecs_entity *a = collider_new(world, (vector){ 100, 100 },
+      (vector){ 16, 16 }, ZEROVEC);
+  ecs_entity *b = collider_new(world, (vector){ 110, 100 },
+      (vector){ 16, 16 }, ZEROVEC);
+  ecs_entity *entities[] = { a, b };
+  for (int i = 0; i < 2; i++) {
+    Collider *collider =
+      &entities[i]->components[ECS_COMPONENT_COLLIDER]->collider;
+    collider->category = COLLIDE_ENEMY;
+    collider->mask = COLLIDE_ALL;
+  }
+  Collider *collider = &a->components[ECS_COMPONENT_COLLIDER]->collider;
+  collider->on_collision = count_enter;
+  collider->on_collision_stay = count_stay;
+  collider->on_collision_exit = count_exit;
+  partner = b->handle;
+  memset(calls, 0, sizeof(calls));
+  // the pair touches as soon as it is tested, then stays awake until it
+  // has been still for the sleep delay
+  step(world, 1);
+  assert(calls[0][ENTER] == 1);
+  assert(collision_system_event_count(world) == 1);
+  step(world, 20);
+  assert(collision_system_stats(world).resting == 0);
+  assert(calls[0][STAY] == 20);
+  // asleep, the pair is no longer tested but stays in contact
+  step(world, 20);
+  assert(collision_system_stats(world).resting == 2);
+  assert(collision_system_stats(world).pair_tests == 0);
+  assert(collision_system_event_count(world) == 0);
+  assert(calls[0][STAY] == 40);
+  assert(calls[0][EXIT] == 0);
+  // a moving collider still hits a sleeping one, without waking it
+  ecs_entity *c = collider_new(world, (vector){ 40, 100 },
+      (vector){ 16, 16 }, (vector){ 600, 0 });
+  c->components[ECS_COMPONENT_COLLIDER]->collider.category = COLLIDE_HAZARD;
+  step(world, 10);
+  assert(calls[1][ENTER] == 1);
+  assert(collision_system_stats(world).resting == 2);
+  assert(calls[0][EXIT] == 0);
+  ecs_entity_free(c);
+  // the partner wakes as soon as it moves, and the pair is tested again
+  // until it separates
+  b->components[ECS_COMPONENT_BODY]->body.velocity = (vector){ 0, 600 };
+  step(world, 1);
+  assert(collision_system_stats(world).resting == 1);
+  assert(b->components[ECS_COMPONENT_COLLIDER]->collider._idle_time == 0);
+  step(world, 10);
+  assert(calls[0][EXIT] == 1);
+  assert(calls[0][ENTER] == 1);
+  ecs_world_free(world);
+}
+
+// test the collision system against testing every pair of colliders
+// run from the top directory, where the game's resources are found
+int main(int argc, char *argv[]) {
+  // a world's sprite layers need the game's fonts
+  assert(al_game_init() == 0);
+  test_contacts();
+  test_sleep();
+  // on the calling thread alone, then searching cells on several
+  for (int seed = 0; seed < NUM_SEEDS; seed++) { check_equivalence(seed); }
+  job_system_init(4);
+  for (int seed = 0; seed < NUM_SEEDS; seed++) { check_equivalence(seed); }
+  job_system_shutdown();
+  al_game_shutdown();
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util/delta.h"
+
+// encode cur against base, decode it again and check the round trip
+static size_t round_trip(const char *base, size_t base_len, const char *cur,
+    size_t cur_len)
+{
+  array *enc = array_new(1, 0), *dec = array_new(1, 0);
+  delta_encode(base, base_len, cur, cur_len, enc);
+  delta_decode(base, base_len, enc->data, enc->length, dec);
+  assert(dec->length == (int)cur_len);
+  assert(cur_len == 0 || memcmp(dec->data, cur, cur_len) == 0);
+  size_t size = enc->length;
+  array_free(enc);
+  array_free(dec);
+  return size;
+}
+
+// test delta encoding functionality
+int main(int argc, char *argv[]) {
+  char base[1000], cur[1200];
+  for (int i = 0; i < 1000; i++) { base[i] = (char)(i * 7); }
+  // identical buffers encode to little more than their length
+  memcpy(cur, base, 1000);
+  assert(round_trip(base, 1000, cur, 1000) <= 16);
+  // a few changed bytes stay small
+  cur[10] ^= 1;
+  cur[500] = 0;
+  cur[999] = 42;
+  assert(round_trip(base, 1000, cur, 1000) < 64);
+  // growing and shrinking relative to base
+  for (int i = 1000; i < 1200; i++) { cur[i] = (char)i; }
+  round_trip(base, 1000, cur, 1200);
+  round_trip(base, 1000, cur, 300);
+  // empty base and empty buffer
+  round_trip(NULL, 0, cur, 1200);
+  round_trip(base, 1000, cur, 0);
+  // appending to a byte array keeps what was there
+  array *bytes = array_new(1, 0);
+  for (int i = 0; i < 100; i++) { delta_append(bytes, &i, sizeof(i)); }
+  assert(bytes->length == 100 * (int)sizeof(int));
+  for (int i = 0; i < 100; i++) { assert(((int*)bytes->data)[i] == i); }
+  array_free(bytes);
+}
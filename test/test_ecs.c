@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "al_game.h"
+#include "ecs.h"
+#include "prefab.h"
+
+// a world running no systems, so only the calls below change it
+static ecs_world* world_new() {
+  ecs_world *world = ecs_world_new();
+  array_clear(world->systems);
+  return world;
+}
+
+// test that a handle to a freed entity stays stale once its slot is reused
+static void test_handles() {
+  ecs_world *world = world_new();
+  assert(ecs_entity_get(world, ECS_NULL_HANDLE) == NULL);
+  ecs_entity *first = ecs_entity_new(world, ZEROVEC, ENTITY_SHIP);
+  ecs_handle old = first->handle;
+  assert(old != ECS_NULL_HANDLE);
+  assert(ecs_entity_get(world, old) == first);
+  ecs_entity_free(first);
+  assert(ecs_entity_get(world, old) == NULL);
+  // the next entity takes the freed slot, and maybe the freed memory too,
+  // under a new generation
+  ecs_entity *second = ecs_entity_new(world, ZEROVEC, ENTITY_SHIP);
+  assert(second->handle != old);
+  assert((uint32_t)second->handle == (uint32_t)old);
+  assert(ecs_entity_get(world, second->handle) == second);
+  assert(ecs_entity_get(world, old) == NULL);
+  // freeing and reusing the slot again never brings the first handle back
+  for (int i = 0; i < 100; i++) {
+    ecs_entity_free(second);
+    second = ecs_entity_new(world, ZEROVEC, ENTITY_SHIP);
+    assert(ecs_entity_get(world, old) == NULL);
+  }
+  ecs_world_free(world);
+}
+
+// an entity with a body and health
+static ecs_entity* body_new(ecs_world *world) {
+  ecs_entity *entity = ecs_entity_new(world, ZEROVEC, ENTITY_SHIP);
+  ecs_add_component(entity, ECS_COMPONENT_BODY);
+  ecs_add_component(entity, ECS_COMPONENT_HEALTH);
+  return entity;
+}
+
+static int store_length(ecs_world *world, ecs_component_type type) {
+  return world->component_store[(int)type]->length;
+}
+
+// test that destruction and removal in a deferred section are seen only
+// once the outermost section ends, and that commands wait for playback
+static void test_deferred() {
+  ecs_world *world = world_new();
+  ecs_entity *doomed = body_new(world), *kept = body_new(world);
+  ecs_handle handle = doomed->handle;
+  ecs_defer_begin(world);
+  ecs_entity_free(doomed);
+  ecs_remove_component(kept, ECS_COMPONENT_HEALTH);
+  // marked, but still alive and attached until the sync point
+  assert(doomed->destroyed && !kept->destroyed);
+  assert(ecs_entity_get(world, handle) == doomed);
+  assert(ecs_tag_count(world, ENTITY_SHIP) == 2);
+  assert(store_length(world, ECS_COMPONENT_BODY) == 2);
+  assert(kept->components[ECS_COMPONENT_HEALTH] != NULL);
+  // ending a nested section is not a sync point
+  ecs_defer_begin(world);
+  ecs_defer_end(world);
+  assert(ecs_entity_get(world, handle) == doomed);
+  ecs_defer_end(world);
+  assert(ecs_entity_get(world, handle) == NULL);
+  assert(ecs_tag_count(world, ENTITY_SHIP) == 1);
+  assert(store_length(world, ECS_COMPONENT_BODY) == 1);
+  assert(store_length(world, ECS_COMPONENT_HEALTH) == 0);
+  assert(kept->components[ECS_COMPONENT_HEALTH] == NULL);
+  // commands change nothing until played back, and skip the changes to
+  // entities destroyed before them
+  ecs_entity *other = body_new(world);
+  handle = other->handle;
+  ecs_commands *cmds = ecs_commands_new(world);
+  ecs_commands_add_component(cmds, kept,
+      ECS_COMPONENT_TIMER)->timer.time_left = 3;
+  ecs_commands_destroy(cmds, other);
+  ecs_commands_add_component(cmds, other, ECS_COMPONENT_TIMER);
+  assert(other->destroyed);
+  assert(kept->components[ECS_COMPONENT_TIMER] == NULL);
+  assert(ecs_entity_get(world, handle) == other);
+  ecs_commands_playback(cmds);
+  assert(kept->components[ECS_COMPONENT_TIMER]->timer.time_left == 3);
+  assert(ecs_entity_get(world, handle) == NULL);
+  assert(store_length(world, ECS_COMPONENT_TIMER) == 1);
+  ecs_commands_free(cmds);
+  ecs_world_free(world);
+}
+
+// check that a query holds exactly the matching entities, each knowing its
+// row, with rows pointing at the components where they are stored now
+static void check_query(ecs_world *world, ecs_query *query) {
+  int matching = 0;
+  for (list_node *node = world->entities->head; node; node = node->next) {
+    ecs_entity *entity = node->value;
+    bool match = (entity->signature & query->signature) == query->signature;
+    matching += match;
+    assert((entity->_query_rows[query->_id] >= 0) == match);
+  }
+  assert(ecs_query_count(query) == matching);
+  for (int i = 0; i < ecs_query_count(query); i++) {
+    ecs_query_row *row = ecs_query_get(query, i);
+    assert(row->entity->_query_rows[query->_id] == i);
+    for (int t = 0; t < NUM_COMPONENT_TYPES; t++) {
+      if (query->signature & ECS_SIGNATURE(t)) {
+        assert(row->components[ecs_query_column(query, t)] ==
+            row->entity->components[t]);
+      }
+    }
+  }
+}
+
+// test that queries keep their rows right as components and entities are
+// swap-removed from the middle of the stores
+static void test_queries() {
+  ecs_world *world = world_new();
+  ecs_entity *entities[20];
+  for (int i = 0; i < 20; i++) {
+    entities[i] = body_new(world);
+    if (i % 3 == 0) { ecs_add_component(entities[i], ECS_COMPONENT_TIMER); }
+  }
+  // a query made after the entities still finds them
+  ecs_query *query = ecs_query_new(world,
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_SIGNATURE(ECS_COMPONENT_HEALTH));
+  ecs_query *timed = ecs_query_new(world,
+      ECS_SIGNATURE(ECS_COMPONENT_HEALTH) | ECS_SIGNATURE(ECS_COMPONENT_TIMER));
+  assert(ecs_query_find(world, query->signature) == query);
+  assert(ecs_query_count(query) == 20 && ecs_query_count(timed) == 7);
+  check_query(world, query);
+  check_query(world, timed);
+  // removing from the first row moves the last into it
+  ecs_entity *last = ecs_query_get(query, 19)->entity;
+  ecs_entity *first = ecs_query_get(query, 0)->entity;
+  ecs_remove_component(first, ECS_COMPONENT_HEALTH);
+  assert(ecs_query_get(query, 0)->entity == last);
+  check_query(world, query);
+  check_query(world, timed);
+  // removing a component the query does not need keeps the row
+  ecs_remove_component(entities[6], ECS_COMPONENT_TIMER);
+  assert(entities[6]->_query_rows[query->_id] >= 0);
+  check_query(world, query);
+  check_query(world, timed);
+  // freeing entities drops their rows from every query
+  for (int i = 1; i < 20; i += 4) { ecs_entity_free(entities[i]); }
+  check_query(world, query);
+  check_query(world, timed);
+  // adding the component back makes the entity match again, in a new row
+  ecs_add_component(first, ECS_COMPONENT_HEALTH);
+  assert(ecs_query_get(query, ecs_query_count(query) - 1)->entity == first);
+  check_query(world, query);
+  check_query(world, timed);
+  ecs_world_free(world);
+}
+
+// check that every entity is listed once in the set of its tag and of its
+// team, and knows where
+static void check_sets(ecs_world *world) {
+  int tags[NUM_ENTITY_TAGS] = {0}, teams[NUM_ENTITY_TEAMS] = {0};
+  for (list_node *node = world->entities->head; node; node = node->next) {
+    ecs_entity *entity = node->value;
+    ++tags[entity->tag];
+    ++teams[entity->team];
+    assert(ecs_tag_get(world, entity->tag, entity->_tag_index) == entity);
+    assert(ecs_team_get(world, entity->team, entity->_team_index) ==
+        entity);
+  }
+  for (int t = 0; t < NUM_ENTITY_TAGS; t++) {
+    assert(ecs_tag_count(world, t) == tags[t]);
+  }
+  for (int t = 0; t < NUM_ENTITY_TEAMS; t++) {
+    assert(ecs_team_count(world, t) == teams[t]);
+  }
+}
+
+// test that the tag and team sets follow team changes and frees
+static void test_sets() {
+  ecs_world *world = world_new();
+  ecs_entity *entities[30];
+  for (int i = 0; i < 30; i++) {
+    entities[i] = ecs_entity_new(world, ZEROVEC, i % NUM_ENTITY_TAGS);
+    ecs_set_team(entities[i], i % NUM_ENTITY_TEAMS);
+  }
+  check_sets(world);
+  assert(ecs_team_count(world, TEAM_ENEMY) == 10);
+  // moving the first of a team moves the last into its place
+  ecs_entity *first = ecs_team_get(world, TEAM_ENEMY, 0);
+  ecs_set_team(first, TEAM_FRIENDLY);
+  assert(ecs_team_count(world, TEAM_ENEMY) == 9);
+  assert(ecs_team_count(world, TEAM_FRIENDLY) == 11);
+  check_sets(world);
+  // setting the team an entity is already on changes nothing
+  int index = first->_team_index;
+  ecs_set_team(first, TEAM_FRIENDLY);
+  assert(first->_team_index == index);
+  check_sets(world);
+  // a deferred free leaves the entity listed until the sync point
+  ecs_defer_begin(world);
+  ecs_entity_free(entities[4]);
+  check_sets(world);
+  ecs_defer_end(world);
+  assert(ecs_tag_count(world, ENTITY_HAZARD) == 4);
+  check_sets(world);
+  for (int i = 0; i < 30; i += 7) { ecs_entity_free(entities[i]); }
+  check_sets(world);
+  ecs_free_all_entities(world);
+  check_sets(world);
+  assert(ecs_tag_count(world, ENTITY_SHIP) == 0);
+  assert(ecs_team_count(world, TEAM_NEUTRAL) == 0);
+  ecs_world_free(world);
+}
+
+// test that instances of a prefab start as copies of it, independent of
+// the prefab and of each other
+static void test_prefabs() {
+  ecs_world *world = world_new();
+  prefab *p = prefab_new("test-drone", ENTITY_HAZARD);
+  p->team = TEAM_ENEMY;
+  prefab_set_sprite(p, "mine", 3);
+  prefab_add_component(p, ECS_COMPONENT_BODY)->body.mass = 2;
+  prefab_add_component(p, ECS_COMPONENT_HEALTH)->health.hp = 5;
+  assert(prefab_get("test-drone") == p);
+  vector positions[40];
+  ecs_entity *entities[40];
+  for (int i = 0; i < 40; i++) { positions[i] = (vector){ i, 2 * i }; }
+  prefab_instantiate(world, p, positions, 40, entities);
+  ecs_entity *single = prefab_spawn(world, p, (vector){ 1, 1 });
+  assert(ecs_tag_count(world, ENTITY_HAZARD) == 41);
+  assert(ecs_team_count(world, TEAM_ENEMY) == 41);
+  assert(store_length(world, ECS_COMPONENT_BODY) == 41);
+  assert(store_length(world, ECS_COMPONENT_HEALTH) == 41);
+  for (int i = 0; i < 40; i++) {
+    ecs_entity *entity = entities[i];
+    assert(entity->position.x == i && entity->position.y == 2 * i);
+    assert(entity->tag == ENTITY_HAZARD && entity->team == TEAM_ENEMY);
+    assert(entity->signature == p->signature);
+    assert(entity->sprite && entity->sprite != &p->sprite);
+    assert(entity->sprite->bitmap == p->sprite.bitmap);
+    assert(entity->sprite->owner == entity->handle);
+    assert(entity->sprite->_depth == 3);
+    ecs_component *body = entity->components[ECS_COMPONENT_BODY];
+    assert(body->owner_entity == entity);
+    assert(body->body.mass == 2);
+    assert(entity->components[ECS_COMPONENT_HEALTH]->health.hp == 5);
+    assert(entity->components[ECS_COMPONENT_TIMER] == NULL);
+  }
+  // instances are copies, so changing one changes nothing else
+  entities[0]->components[ECS_COMPONENT_HEALTH]->health.hp = 1;
+  assert(entities[1]->components[ECS_COMPONENT_HEALTH]->health.hp == 5);
+  assert(single->components[ECS_COMPONENT_HEALTH]->health.hp == 5);
+  assert(p->components[ECS_COMPONENT_HEALTH].health.hp == 5);
+  ecs_world_free(world);
+  prefab_shutdown();
+}
+
+// test the entity, component and query bookkeeping of a world
+// run from the top directory, where the game's resources are found
+int main(int argc, char *argv[]) {
+  // a world's sprite layers need the game's fonts
+  assert(al_game_init() == 0);
+  test_handles();
+  test_deferred();
+  test_queries();
+  test_sets();
+  test_prefabs();
+  al_game_shutdown();
+}
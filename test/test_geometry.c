@@ -1,17 +1,66 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <assert.h>
 
 #include "util/geometry.h"
 
 static bool almost_equal(double d1, double d2) {
-  return abs(d1 - d2) < 1E-6;
+  return fabs(d1 - d2) < 1E-6;
 }
 
 static bool vec_equal(vector v1, vector v2) {
   return almost_equal(v1.x, v2.x) && almost_equal(v1.y, v2.y);
 }
 
+// edge coordinates covering boxes that are apart, touching, overlapping,
+// inverted and undefined
+static const float edges[] = { -1, 0, 0.5f, 1, NAN };
+#define NUM_EDGES (sizeof(edges) / sizeof(edges[0]))
+#define NUM_BOXES (NUM_EDGES * NUM_EDGES * NUM_EDGES * NUM_EDGES)
+
+// the nth box made of the edges above
+static aabb box_of(int n) {
+  return (aabb) {
+    .left = edges[n % NUM_EDGES], .top = edges[n / NUM_EDGES % NUM_EDGES],
+    .right = edges[n / NUM_EDGES / NUM_EDGES % NUM_EDGES],
+    .bottom = edges[n / NUM_EDGES / NUM_EDGES / NUM_EDGES]
+  };
+}
+
+// test every pair of boxes with the batch kernel, in batches of every size
+// and alignment, against aabb_intersect and the scalar kernel
+static void check_batch() {
+  static float left[NUM_BOXES], top[NUM_BOXES], right[NUM_BOXES],
+               bottom[NUM_BOXES];
+  aabb_soa boxes = { left, top, right, bottom };
+  for (int n = 0; n < NUM_BOXES; n++) {
+    aabb box = box_of(n);
+    left[n] = box.left, top[n] = box.top;
+    right[n] = box.right, bottom[n] = box.bottom;
+  }
+  for (int n = 0; n < NUM_BOXES; n++) {
+    aabb box = box_of(n);
+    int count = 1 + n % AABB_BATCH;
+    for (int first = 0; first < NUM_BOXES; first += count) {
+      if (first + count > NUM_BOXES) { count = NUM_BOXES - first; }
+      uint32_t hits = aabb_intersect_batch_scalar(box, boxes, first, count);
+      for (int i = 0; i < AABB_BATCH; i++) {
+        bool hit = i < count && aabb_intersect(box, box_of(first + i));
+        assert(hit == ((hits >> i) & 1));
+      }
+      assert(aabb_intersect_batch(box, boxes, first, count) == hits);
+      // counts from 1 to AABB_BATCH leave every length of tail after the
+      // last full vector of each path
+      for (int p = 0; p < NUM_AABB_BATCH_PATHS; p++) {
+        if (!aabb_batch_supported(p)) { continue; }
+        assert(aabb_intersect_batch_path(p, box, boxes, first, count) ==
+            hits);
+      }
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   // add, subtract
   vector ux = {1, 0};
@@ -74,4 +123,52 @@ int main(int argc, char *argv[]) {
   assert(almost_equal(angle_between(-PI, PI), 0));
   assert(almost_equal(angle_between(PI, -PI), 0));
   assert(almost_equal(angle_between(-2*PI/3, 2*PI/3), -2*PI/3));
+
+  // boxes
+  aabb box = aabb_around((vector){10, 20}, 4, 6);
+  assert(box.left == 8 && box.right == 12 && box.top == 17 && box.bottom == 23);
+  aabb moved = aabb_offset(box, (vector){4, -6});
+  assert(moved.left == 12 && moved.right == 16);
+  assert(moved.top == 11 && moved.bottom == 17);
+  assert(aabb_intersect(box, moved)); // shared corner
+  assert(!aabb_intersect(box, aabb_offset(box, (vector){4.5, 0})));
+  // overlapping in a cross, no corner of either inside the other
+  aabb wide = aabb_around((vector){10, 20}, 20, 2);
+  assert(aabb_intersect(box, wide) && aabb_intersect(wide, box));
+  assert(aabb_contains_point(box, (vector){10, 20}));
+  assert(aabb_contains_point(box, (vector){12, 23}));
+  assert(!aabb_contains_point(box, (vector){12.5, 20}));
+  aabb both = aabb_union(box, moved);
+  assert(both.left == 8 && both.right == 16);
+  assert(both.top == 11 && both.bottom == 23);
+
+  // sweeps
+  aabb wall = aabb_around((vector){50, 20}, 2, 100);
+  assert(almost_equal(aabb_sweep(box, wall, (vector){100, 0}, NULL), 0.37));
+  assert(aabb_sweep(box, wall, (vector){-100, 0}, NULL) == INFINITY);
+  // falls short, just reaches it and touches from the start
+  assert(aabb_sweep(box, wall, (vector){10, 0}, NULL) == INFINITY);
+  assert(aabb_sweep(box, wall, (vector){37, 0}, NULL) == 1);
+  assert(aabb_sweep(box, box, (vector){5, 5}, NULL) == 0);
+  // passes through in one step, as a fast missile would
+  aabb post = aabb_around((vector){50, 20}, 2, 2);
+  assert(!aabb_intersect(aabb_offset(box, (vector){100, 0}), post));
+  assert(almost_equal(aabb_sweep(box, post, (vector){100, 0}, NULL), 0.37));
+  // overlaps along x only after it has passed along y
+  assert(aabb_sweep(box, post, (vector){100, 100}, NULL) == INFINITY);
+  assert(almost_equal(aabb_sweep(box, post, (vector){100, 1}, NULL), 0.37));
+  // faces met
+  vector normal;
+  aabb_sweep(box, post, (vector){100, 1}, &normal);
+  assert(normal.x == -1 && normal.y == 0);
+  aabb_sweep(post, box, (vector){-100, 1}, &normal);
+  assert(normal.x == 1 && normal.y == 0);
+  aabb_sweep(box, aabb_offset(box, (vector){1, -20}), (vector){0, -30},
+      &normal);
+  assert(normal.x == 0 && normal.y == 1);
+  aabb_sweep(box, box, ZEROVEC, &normal);
+  assert(normal.x == 0 && normal.y == 0);
+
+  // batches
+  check_batch();
 }
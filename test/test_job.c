@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include "util/job.h"
+
+#define NUM_ELEMENTS 100000
+
+// each element is written once by whichever range covers it
+static void square_range(void *ctx, int begin, int end) {
+  int *values = ctx;
+  for (int i = begin; i < end; i++) { values[i] = i * 2 + 1; }
+}
+
+static void check_squares(int *values, int count) {
+  for (int i = 0; i < count; i++) {
+    assert(values[i] == i * 2 + 1);
+    values[i] = 0;
+  }
+}
+
+// a job that runs a parallel for of its own, as a world update does
+static void nested_range(void *ctx, int begin, int end) {
+  int **rows = ctx;
+  for (int i = begin; i < end; i++) {
+    job_parallel_for(1000, 10, square_range, rows[i]);
+  }
+}
+
+static void count_job(void *ctx, int begin, int end) {
+  atomic_fetch_add((atomic_int*)ctx, end - begin);
+}
+
+// run every kind of work the job system does, checking the results
+static void run_all(int *values) {
+  // ranges of every size, including one element and uneven splits
+  for (int grain = 1; grain <= NUM_ELEMENTS * 2; grain *= 7) {
+    job_parallel_for(NUM_ELEMENTS, grain, square_range, values);
+    check_squares(values, NUM_ELEMENTS);
+  }
+  job_parallel_for(0, 10, square_range, values); // nothing to do
+  // jobs waiting for jobs
+  int *rows[16];
+  for (int i = 0; i < 16; i++) { rows[i] = values + i * 1000; }
+  job_parallel_for(16, 1, nested_range, rows);
+  for (int i = 0; i < 16; i++) { check_squares(rows[i], 1000); }
+  // more jobs than fit in a queue at once
+  atomic_int total = 0;
+  job_wait_group wg = {0};
+  for (int i = 0; i < 5000; i++) {
+    job_submit(&wg, count_job, &total, i, i + 3);
+  }
+  job_wait(&wg);
+  assert(total == 5000 * 3);
+}
+
+// test job system functionality
+int main(int argc, char *argv[]) {
+  int *values = calloc(NUM_ELEMENTS, sizeof(int));
+  // before starting, every job runs on the calling thread
+  assert(job_thread_count() == 1);
+  run_all(values);
+  job_system_init(4);
+  assert(job_thread_count() >= 1 && job_thread_count() <= 4);
+  run_all(values);
+  job_system_shutdown();
+  assert(job_thread_count() == 1);
+  // the system may be started again
+  job_system_init(0);
+  run_all(values);
+  job_system_shutdown();
+  free(values);
+}
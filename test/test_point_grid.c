@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "util/point_grid.h"
+
+#define NUM_POINTS 500
+#define MAX_FOUND NUM_POINTS
+
+static double distance_sq(vector a, vector b) {
+  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+}
+
+// accept points with even ids
+static bool even_id(void *ctx, int id) {
+  ++*(int*)ctx;
+  return id % 2 == 0;
+}
+
+// ids visited by a query, in order
+typedef struct visited_ids {
+  int ids[MAX_FOUND];
+  int count;
+} visited_ids;
+
+static void record_id(void *ctx, int id) {
+  visited_ids *visited = ctx;
+  assert(visited->count < MAX_FOUND);
+  visited->ids[visited->count++] = id;
+}
+
+// compare a radius query against testing every point
+static void check_radius(point_grid *grid, const vector *points,
+    vector center, double radius)
+{
+  int out[MAX_FOUND];
+  bool found[NUM_POINTS] = {false};
+  int count = point_grid_radius(grid, center, radius, NULL, NULL, out,
+      MAX_FOUND);
+  for (int i = 0; i < count; i++) {
+    assert(!found[out[i]]); // no point is found twice
+    found[out[i]] = true;
+  }
+  for (int i = 0; i < NUM_POINTS; i++) {
+    assert(found[i] == (distance_sq(points[i], center) <= radius * radius));
+  }
+  // a short buffer still counts every point, writing the first ones
+  int few[3];
+  assert(point_grid_radius(grid, center, radius, NULL, NULL, few, 3) == count);
+  for (int i = 0; i < 3 && i < count; i++) { assert(few[i] == out[i]); }
+  // visiting finds the same points in the same order
+  visited_ids visited = { .count = 0 };
+  assert(point_grid_visit_radius(grid, center, radius, record_id, &visited) ==
+      count);
+  assert(visited.count == count);
+  for (int i = 0; i < count; i++) { assert(visited.ids[i] == out[i]); }
+  // the filter sees only points in range and rejects the odd ones
+  int calls = 0;
+  int even = point_grid_radius(grid, center, radius, even_id, &calls, out,
+      MAX_FOUND);
+  assert(calls == count);
+  int expected = 0;
+  for (int i = 0; i < NUM_POINTS; i += 2) { expected += found[i]; }
+  assert(even == expected);
+  for (int i = 0; i < even; i++) { assert(out[i] % 2 == 0); }
+}
+
+// compare a nearest query against sorting every point
+static void check_nearest(point_grid *grid, const vector *points,
+    vector center, double radius, int k)
+{
+  int out[MAX_FOUND];
+  int count = point_grid_nearest(grid, center, radius, k, NULL, NULL, out);
+  // nearest first, ties by id
+  for (int i = 1; i < count; i++) {
+    double d0 = distance_sq(points[out[i - 1]], center);
+    double d1 = distance_sq(points[out[i]], center);
+    assert(d0 < d1 || (d0 == d1 && out[i - 1] < out[i]));
+  }
+  // every point left out is farther than the last found, or out of range
+  int in_range = 0;
+  for (int i = 0; i < NUM_POINTS; i++) {
+    double d = distance_sq(points[i], center);
+    if (d > radius * radius) { continue; }
+    ++in_range;
+    bool listed = false;
+    for (int j = 0; j < count; j++) { listed |= out[j] == i; }
+    if (!listed) {
+      double last = distance_sq(points[out[count - 1]], center);
+      assert(d > last || (d == last && i > out[count - 1]));
+    }
+  }
+  assert(count == (in_range < k ? in_range : k));
+}
+
+// test point grid functionality
+int main(int argc, char *argv[]) {
+  point_grid *grid = point_grid_new((aabb){ 0, 0, 640, 360 }, 64, 0);
+  assert(grid->cols == 10 && grid->rows == 6);
+  // an empty grid finds nothing
+  int out[MAX_FOUND];
+  assert(point_grid_radius(grid, (vector){ 5, 5 }, 1000, NULL, NULL, out,
+        MAX_FOUND) == 0);
+  assert(point_grid_nearest(grid, (vector){ 5, 5 }, INFINITY, 4, NULL, NULL,
+        out) == 0);
+  // points inside and well outside the area, some sharing a spot
+  vector points[NUM_POINTS];
+  srand(2);
+  for (int i = 0; i < NUM_POINTS; i++) {
+    points[i] = (vector){ rand() % 1000 - 180, rand() % 700 - 170 };
+  }
+  points[7] = points[8] = points[9] = (vector){ 100, 100 };
+  point_grid_build(grid, points, NUM_POINTS);
+  assert(grid->count == NUM_POINTS);
+  vector centers[] = { { 100, 100 }, { 0, 0 }, { 320, 180 }, { -300, 50 },
+    { 900, 500 }, { 639.5, 359.5 } };
+  double radii[] = { 0, 10, 64, 150, 500, INFINITY };
+  int ks[] = { 1, 3, 10, 100 };
+  for (int c = 0; c < sizeof(centers) / sizeof(centers[0]); c++) {
+    for (int r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+      check_radius(grid, points, centers[c], radii[r]);
+      for (int k = 0; k < sizeof(ks) / sizeof(ks[0]); k++) {
+        check_nearest(grid, points, centers[c], radii[r], ks[k]);
+      }
+    }
+  }
+  // points at the same spot come out by id
+  assert(point_grid_nearest(grid, (vector){ 100, 100 }, 0, 3, NULL, NULL,
+        out) == 3);
+  assert(out[0] == 7 && out[1] == 8 && out[2] == 9);
+  // the filter skips points without ending the search
+  int calls = 0;
+  assert(point_grid_nearest(grid, (vector){ 100, 100 }, 0, 3, even_id,
+        &calls, out) == 1);
+  assert(out[0] == 8 && calls == 3);
+  // no distance or a negative radius finds nothing
+  assert(point_grid_nearest(grid, (vector){ 1, 1 }, -1, 3, NULL, NULL,
+        out) == 0);
+  assert(point_grid_radius(grid, (vector){ 1, 1 }, NAN, NULL, NULL, out,
+        MAX_FOUND) == 0);
+  // rebuilding replaces the points
+  point_grid_build(grid, points, 5);
+  assert(point_grid_radius(grid, (vector){ 0, 0 }, INFINITY, NULL, NULL, out,
+        MAX_FOUND) == 5);
+  point_grid_free(grid);
+}
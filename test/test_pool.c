@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "util/pool.h"
+#include "util/list.h"
+
+typedef struct simple_data {
+  double x, y;
+} simple_data;
+
+// test pool functionality
+int main(int argc, char *argv[]) {
+  pool *p = pool_new(sizeof(simple_data), 4);
+  assert(p != NULL);
+  assert(p->stats.slabs == 1); // first slab reserved up front
+  assert(p->stats.live == 0);
+  // allocate past the first slab
+  simple_data *objs[10];
+  for (int i = 0; i < 10; i++) {
+    objs[i] = pool_alloc(p);
+    assert(objs[i] != NULL);
+    assert(objs[i]->x == 0 && objs[i]->y == 0); // objects start zeroed
+    assert((uintptr_t)objs[i] % _Alignof(simple_data) == 0);
+    objs[i]->x = i;
+    objs[i]->y = -i;
+  }
+  assert(p->stats.live == 10);
+  assert(p->stats.peak == 10);
+  assert(p->stats.slabs == 3);
+  // objects don't overlap
+  for (int i = 0; i < 10; i++) {
+    assert(objs[i]->x == i && objs[i]->y == -i);
+  }
+  // released objects are reused before any new slab is allocated
+  pool_release(p, objs[3]);
+  pool_release(p, objs[7]);
+  assert(p->stats.live == 8);
+  simple_data *reused1 = pool_alloc(p);
+  simple_data *reused2 = pool_alloc(p);
+  assert((reused1 == objs[7] && reused2 == objs[3]) ||
+         (reused1 == objs[3] && reused2 == objs[7]));
+  assert(reused1->x == 0 && reused2->x == 0);
+  assert(p->stats.live == 10);
+  assert(p->stats.peak == 10);
+  assert(p->stats.slabs == 3);
+  pool_free(p);
+  // pooled lists draw their nodes from the pool and return them on removal
+  pool *nodes = pool_new(sizeof(list_node), 8);
+  list *l1 = list_new_pooled(nodes), *l2 = list_new_pooled(nodes);
+  for (int i = 0; i < 4; i++) {
+    list_push(l1, NULL);
+    list_push(l2, NULL);
+  }
+  assert(nodes->stats.live == 8 && nodes->stats.slabs == 1);
+  list_clear(l1, NULL);
+  assert(nodes->stats.live == 4);
+  for (int i = 0; i < 4; i++) { list_push(l2, NULL); }
+  assert(l2->length == 8 && nodes->stats.slabs == 1); // nodes were reused
+  list_free(l1, NULL);
+  list_free(l2, NULL);
+  assert(nodes->stats.live == 0);
+  pool_free(nodes);
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "al_game.h"
+#include "ecs.h"
+#include "util/job.h"
+
+#define NUM_ENTITIES 200
+#define NUM_UPDATES 50
+
+// true once tick_system has run as a job and so queued its changes
+static bool tick_queued;
+
+// speed every body up and move it
+static void move_system(ecs_world *world, double time) {
+  ecs_component *comp;
+  ECS_FOREACH(comp, world, ECS_COMPONENT_BODY) {
+    Body *body = &comp->body;
+    body->velocity.x += 1;
+    comp->owner_entity->position = vector_add(comp->owner_entity->position,
+        vector_scale(body->velocity, time));
+  }
+}
+
+// add to the health of an entity at a sync point
+static void heal(ecs_world *world, const void *args) {
+  ecs_entity *entity = ecs_entity_get(world, *(const ecs_handle*)args);
+  ecs_write_component(entity, ECS_COMPONENT_HEALTH)->health.hp += 1;
+}
+
+// count timers down, healing their owners each time one runs out
+static void tick_system(ecs_world *world, double time) {
+  tick_queued |= ecs_must_queue(world);
+  ecs_component *comp;
+  ECS_FOREACH(comp, world, ECS_COMPONENT_TIMER) {
+    Timer *timer = &comp->timer;
+    timer->time_left -= time;
+    if (timer->time_left <= 0) {
+      timer->time_left += 1;
+      ecs_call_synced(world, comp->owner_entity, heal,
+          &comp->owner_entity->handle, sizeof(ecs_handle));
+    }
+  }
+}
+
+// create an entity with a body and a timer each update
+static void spawn_system(ecs_world *world, double time) {
+  int count = ecs_tag_count(world, ENTITY_SHIP);
+  ecs_entity *entity =
+    ecs_entity_new(world, (vector){ count, count % 7 }, ENTITY_SHIP);
+  ecs_add_component(entity, ECS_COMPONENT_BODY)->body.velocity =
+    (vector){ count % 5, 1 };
+  ecs_add_component(entity, ECS_COMPONENT_TIMER)->timer.time_left = 0.5;
+  ecs_add_component(entity, ECS_COMPONENT_HEALTH);
+}
+
+// a world running only the systems above, over the same entities each time
+static ecs_world* world_new(bool serial) {
+  ecs_world *world = ecs_world_new();
+  array_clear(world->systems);
+  world->serial_systems = serial;
+  ecs_add_system(world, move_system, 0,
+      ECS_SIGNATURE(ECS_COMPONENT_BODY) | ECS_ACCESS_POSITION);
+  ecs_add_system(world, tick_system, 0,
+      ECS_SIGNATURE(ECS_COMPONENT_TIMER) |
+      ECS_SIGNATURE(ECS_COMPONENT_HEALTH));
+  // creates entities, so runs in a stage of its own
+  ecs_add_system(world, spawn_system, 0, ECS_ACCESS_STRUCTURE);
+  for (int i = 0; i < NUM_ENTITIES; i++) {
+    ecs_entity *entity =
+      ecs_entity_new(world, (vector){ i, i % 7 }, ENTITY_SHIP);
+    if (i % 3 != 0) {
+      ecs_add_component(entity, ECS_COMPONENT_BODY)->body.velocity =
+        (vector){ i % 5, 1 };
+    }
+    if (i % 2 == 0) {
+      ecs_add_component(entity, ECS_COMPONENT_TIMER)->timer.time_left =
+        i / 100.0;
+      ecs_add_component(entity, ECS_COMPONENT_HEALTH);
+    }
+  }
+  return world;
+}
+
+// test that systems sharing a stage give the same result as serial systems
+// run from the top directory, where the game's resources are found
+int main(int argc, char *argv[]) {
+  // a world's sprite layers need the game's fonts
+  assert(al_game_init() == 0);
+  job_system_init(4);
+  ecs_world *serial = world_new(true);
+  ecs_world *staged = world_new(false);
+  for (int i = 0; i < NUM_UPDATES; i++) {
+    ecs_update_systems(serial, 0.1);
+  }
+  assert(!tick_queued);
+  for (int i = 0; i < NUM_UPDATES; i++) {
+    ecs_update_systems(staged, 0.1);
+  }
+  // the systems do not conflict, so the timers ran beside the bodies as a
+  // job, and their changes were queued until the end of the stage
+  assert(tick_queued);
+  int count = ecs_tag_count(serial, ENTITY_SHIP);
+  assert(count == NUM_ENTITIES + NUM_UPDATES);
+  assert(ecs_tag_count(staged, ENTITY_SHIP) == count);
+  for (int i = 0; i < count; i++) {
+    ecs_entity *e1 = ecs_tag_get(serial, ENTITY_SHIP, i);
+    ecs_entity *e2 = ecs_tag_get(staged, ENTITY_SHIP, i);
+    assert(e1->position.x == e2->position.x);
+    assert(e1->position.y == e2->position.y);
+    for (int t = 0; t < NUM_COMPONENT_TYPES; t++) {
+      assert(!e1->components[t] == !e2->components[t]);
+    }
+    if (e1->components[ECS_COMPONENT_BODY]) {
+      assert(e1->components[ECS_COMPONENT_BODY]->body.velocity.x ==
+          e2->components[ECS_COMPONENT_BODY]->body.velocity.x);
+    }
+    if (e1->components[ECS_COMPONENT_TIMER]) {
+      assert(e1->components[ECS_COMPONENT_TIMER]->timer.time_left ==
+          e2->components[ECS_COMPONENT_TIMER]->timer.time_left);
+      double hp = e1->components[ECS_COMPONENT_HEALTH]->health.hp;
+      assert(hp > 0 || i >= NUM_ENTITIES); // late spawns may be waiting
+      assert(hp == e2->components[ECS_COMPONENT_HEALTH]->health.hp);
+    }
+  }
+  ecs_world_free(serial);
+  ecs_world_free(staged);
+  job_system_shutdown();
+  al_game_shutdown();
+}
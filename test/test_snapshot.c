@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "al_game.h"
+#include "ecs.h"
+#include "snapshot.h"
+
+#define CAPACITY 120
+#define KEYFRAME_INTERVAL 30
+#define NUM_FRAMES 300
+#define NUM_MOVERS 12
+#define CONTACT_FRAMES 150
+#define CONTACT_RESTORE_FRAME 40
+#define MAX_EVENTS 1000
+
+// kinds of collision handler call
+enum { ENTER, STAY, EXIT };
+
+// a collision handler call, logged by the handlers below
+typedef struct contact_event {
+  int frame, kind;
+  ecs_handle entity, other;
+} contact_event;
+
+static contact_event events[MAX_EVENTS];
+static int num_events, current_frame;
+
+// change the world in a way that differs every frame
+static void step(ecs_world *world, int frame) {
+  ecs_entity_new(world, (vector){ frame % 640, frame / 2 }, ENTITY_SHIP);
+  ecs_entity *first = ecs_tag_get(world, ENTITY_SHIP, 0);
+  first->position.x = frame;
+}
+
+static bool same_state(snapshot *a, snapshot *b) {
+  return snapshot_size(a) == snapshot_size(b) &&
+    memcmp(a->_bytes->data, b->_bytes->data, snapshot_size(a)) == 0;
+}
+
+// restore a frame from the history and check it against a direct snapshot
+static void check_restore(snapshot_history *history, ecs_world *world,
+    snapshot **taken, int frames_ago)
+{
+  int frame = history->_pushed - 1 - frames_ago;
+  snapshot *now = snapshot_new();
+  snapshot_history_restore(history, world, frames_ago);
+  snapshot_take(now, world);
+  assert(same_state(now, taken[frame]));
+  snapshot_free(now);
+}
+
+static void log_event(ecs_entity *ent, ecs_entity *other, int kind) {
+  assert(num_events < MAX_EVENTS);
+  events[num_events++] = (contact_event){
+    .frame = current_frame, .kind = kind,
+    .entity = ent->handle, .other = other->handle
+  };
+}
+
+static void log_enter(ecs_entity *ent, ecs_entity *other) {
+  log_event(ent, other, ENTER);
+}
+
+static void log_stay(ecs_entity *ent, ecs_entity *other) {
+  log_event(ent, other, STAY);
+}
+
+static void log_exit(ecs_entity *ent, ecs_entity *other) {
+  log_event(ent, other, EXIT);
+}
+
+// a collider logging every change in its contacts, with a body
+static ecs_entity* collider_new(ecs_world *world, vector position,
+    vector velocity, collision_category category)
+{
+  ecs_entity *entity = ecs_entity_new(world, position, ENTITY_SHIP);
+  Collider *collider =
+    &ecs_add_component(entity, ECS_COMPONENT_COLLIDER)->collider;
+  collider->rect = (rectangle){ .w = 16, .h = 16 };
+  collider->category = category;
+  collider->mask = COLLIDE_HAZARD;
+  collider->on_collision = log_enter;
+  collider->on_collision_stay = log_stay;
+  collider->on_collision_exit = log_exit;
+  Body *body = &ecs_add_component(entity, ECS_COMPONENT_BODY)->body;
+  make_constant_vel_body(body, velocity);
+  body->max_linear_velocity = 1000;
+  return entity;
+}
+
+// log the collisions of frames [first, last) into events, from the start
+static void step_contacts(ecs_world *world, int first, int last) {
+  num_events = 0;
+  for (current_frame = first; current_frame < last; current_frame++) {
+    ecs_update_systems(world, 1 / 60.0);
+  }
+}
+
+// test that contacts in progress carry across a restore: stepping on from
+// a restored frame handles the same enters, stays and exits as the first
+// run did
+static void test_contacts() {
+  ecs_world *world = ecs_world_new();
+  array_clear(world->systems);
+  ecs_add_system(world, body_system_fn, 0, 0);
+  ecs_add_system(world, bounds_system_fn, 0, 0);
+  ecs_add_system(world, collision_system_fn, 0, 0);
+  // a tall hazard, which movers at different speeds cross, and a collider
+  // resting against it that falls asleep while touching
+  ecs_entity *wall = collider_new(world, (vector){ 320, 240 },
+      (vector){ 0, 0 }, COLLIDE_HAZARD);
+  wall->components[ECS_COMPONENT_COLLIDER]->collider.rect =
+    (rectangle){ .w = 32, .h = 400 };
+  wall->components[ECS_COMPONENT_COLLIDER]->collider.stationary = true;
+  collider_new(world, (vector){ 300, 60 }, (vector){ 0, 0 }, COLLIDE_ENEMY);
+  for (int i = 0; i < NUM_MOVERS; i++) {
+    collider_new(world, (vector){ 200, 80 + 25 * i },
+        (vector){ 100 + 25 * i, 0 }, COLLIDE_ENEMY);
+  }
+  snapshot *snap = snapshot_new();
+  step_contacts(world, 0, CONTACT_RESTORE_FRAME);
+  snapshot_take(snap, world);
+  step_contacts(world, CONTACT_RESTORE_FRAME, CONTACT_FRAMES);
+  static contact_event first_run[MAX_EVENTS];
+  int first_count = num_events;
+  memcpy(first_run, events, num_events * sizeof(contact_event));
+  int kinds[3] = {0};
+  for (int i = 0; i < first_count; i++) { ++kinds[first_run[i].kind]; }
+  assert(kinds[ENTER] > 0 && kinds[STAY] > 0 && kinds[EXIT] > 0);
+  snapshot_restore(snap, world);
+  step_contacts(world, CONTACT_RESTORE_FRAME, CONTACT_FRAMES);
+  assert(num_events == first_count);
+  assert(memcmp(events, first_run, num_events * sizeof(contact_event)) == 0);
+  snapshot_free(snap);
+  ecs_world_free(world);
+}
+
+// test snapshot history functionality
+// run from the top directory, where the game's resources are found
+int main(int argc, char *argv[]) {
+  // a world's sprite layers need the game's fonts
+  assert(al_game_init() == 0);
+  ecs_world *world = ecs_world_new();
+  snapshot_history *history =
+    snapshot_history_new(CAPACITY, KEYFRAME_INTERVAL);
+  snapshot *taken[NUM_FRAMES];
+  assert(snapshot_history_length(history) == 0);
+  for (int f = 0; f < NUM_FRAMES; f++) {
+    step(world, f);
+    snapshot_history_push(history, world);
+    taken[f] = snapshot_new();
+    snapshot_take(taken[f], world);
+  }
+  // frames 180 to 299 are in the ring, all keyed from frame 180
+  assert(snapshot_history_length(history) == CAPACITY);
+  check_restore(history, world, taken, CAPACITY - 1);
+  assert(snapshot_history_length(history) == 1);
+  // pushing after a rewind replaces the discarded frames only
+  for (int f = 181; f < NUM_FRAMES; f++) {
+    step(world, f);
+    snapshot_history_push(history, world);
+    snapshot_take(taken[f], world);
+  }
+  // rewinding twice in a row never reaches frames the future replaced
+  check_restore(history, world, taken, 60);
+  assert(snapshot_history_length(history) == 60);
+  check_restore(history, world, taken, 59);
+  assert(snapshot_history_length(history) == 1);
+  check_restore(history, world, taken, 0);
+  // the ring fills again once enough frames are pushed
+  for (int f = 181; f < NUM_FRAMES; f++) {
+    step(world, f);
+    snapshot_history_push(history, world);
+    snapshot_take(taken[f], world);
+  }
+  check_restore(history, world, taken, 60);
+  check_restore(history, world, taken, 59);
+  for (int i = 0; i < NUM_FRAMES; i++) { snapshot_free(taken[i]); }
+  snapshot_history_free(history);
+  ecs_world_free(world);
+  test_contacts();
+  al_game_shutdown();
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "al_game.h"
+#include "ecs.h"
+#include "particle_effects.h"
+#include "prefab.h"
+#include "snapshot.h"
+#include "entity/enemies.h"
+#include "entity/player.h"
+#include "util/al_helper.h"
+#include "util/job.h"
+
+#define NUM_WORLDS 2
+#define NUM_MINES 6
+#define NUM_UPDATES 300
+
+// a world with a player, scenery and mines chasing the player, the same
+// for the same seed
+static ecs_world* world_new(int seed) {
+  rand_seed(seed);
+  ecs_world *world = ecs_world_new();
+  ecs_entity *player = make_player_ship(world);
+  weapon_system_set_weapons(player, &seeker_launcher, &swarmer_launcher);
+  scenery_pre_populate(world);
+  for (int i = 0; i < NUM_MINES; i++) {
+    spawn_mine(i % 2 ? EAST : NORTH, player);
+  }
+  return world;
+}
+
+// test that worlds stepped at once end up as they do stepped one by one.
+// they share only prefabs and other data found as the worlds are created
+// run from the top directory, where the game's resources are found
+int main(int argc, char *argv[]) {
+  // a world's sprite layers need the game's fonts
+  assert(al_game_init() == 0);
+  particle_init(al_get_backbuffer(display));
+  list_free(load_all_generator_data(), free);
+  enemies_preload();
+  job_system_init(4);
+  ecs_world *together[NUM_WORLDS], *alone[NUM_WORLDS];
+  for (int w = 0; w < NUM_WORLDS; w++) {
+    together[w] = world_new(w + 1);
+    alone[w] = world_new(w + 1);
+  }
+  for (int i = 0; i < NUM_UPDATES; i++) {
+    ecs_update_worlds(together, NUM_WORLDS, 1 / 60.0);
+    for (int w = 0; w < NUM_WORLDS; w++) {
+      ecs_update_systems(alone[w], 1 / 60.0);
+    }
+  }
+  snapshot *a = snapshot_new(), *b = snapshot_new();
+  for (int w = 0; w < NUM_WORLDS; w++) {
+    snapshot_take(a, together[w]);
+    snapshot_take(b, alone[w]);
+    assert(snapshot_size(a) == snapshot_size(b));
+    assert(memcmp(a->_bytes->data, b->_bytes->data, snapshot_size(a)) == 0);
+    ecs_world_free(together[w]);
+    ecs_world_free(alone[w]);
+  }
+  snapshot_free(a);
+  snapshot_free(b);
+  job_system_shutdown();
+  particle_shutdown();
+  prefab_shutdown();
+  al_game_shutdown();
+}